@@ -0,0 +1,68 @@
+/*
+  Measures the BulkLoader filling a Tree from sorted entries, and the shape of
+  the resulting tree, for a few fill factors.
+ */
+
+#include "tupl/pvt/BulkLoader.hpp"
+#include "tupl/pvt/Tree.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using std::vector;
+using tupl::pvt::BulkLoader;
+using tupl::pvt::Tree;
+
+namespace {
+
+vector<string> makeSortedKeys(const size_t count) {
+    vector<string> keys;
+    keys.reserve(count);
+    
+    for (size_t i = 0; i < count; ++i) {
+        char key[64];
+        std::snprintf(key, sizeof(key), "tenant-0042|events|%012zu", i * 3);
+        keys.push_back(key);
+    }
+    
+    return keys;
+}
+
+}
+
+int main() {
+    const string value(24, 'v');
+    
+    std::printf("%10s  %6s  %10s  %6s  %8s  %8s\n", "entries", "fill",
+                "ns/entry", "height", "leaves", "leaf fill");
+    
+    for (size_t count = 10000; count <= 1000000; count *= 10) {
+        const auto keys = makeSortedKeys(count);
+        
+        for (const double fillFactor : {1.0, 0.9, 0.7}) {
+            Tree tree;
+            
+            const auto start = std::chrono::steady_clock::now();
+            
+            BulkLoader loader(tree, fillFactor);
+            for (const auto& key : keys) { loader.add(key, value); }
+            loader.finish();
+            
+            const auto elapsed =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            
+            const auto stats = tree.stats();
+            
+            std::printf("%10zu  %6.2f  %10.1f  %6zu  %8zu  %8.3f\n", count,
+                        fillFactor, double(elapsed) / count, stats.height,
+                        stats.leafNodes, stats.leafFillFactor);
+        }
+    }
+    
+    return 0;
+}
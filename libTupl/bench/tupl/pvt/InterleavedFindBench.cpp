@@ -0,0 +1,141 @@
+/*
+  Compares point lookups issued one at a time through find against batches
+  found in one shared descent by findAll, and against batches whose lookups
+  are interleaved by findInterleaved, for trees up to well beyond the last
+  level cache.
+ */
+
+#include "tupl/pvt/BulkLoader.hpp"
+#include "tupl/pvt/Cursor.hpp"
+#include "tupl/pvt/Lookup.hpp"
+#include "tupl/pvt/Tree.hpp"
+#include "tupl/pvt/ops.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using std::vector;
+using tupl::pvt::BulkLoader;
+using tupl::pvt::Cursor;
+using tupl::pvt::Lookup;
+using tupl::pvt::Tree;
+using tupl::pvt::ops;
+
+namespace {
+
+std::uint64_t nextRandom(std::uint64_t& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+string makeKey(const size_t i) {
+    char key[64];
+    std::snprintf(key, sizeof(key), "tenant-0042|sessions|%012zu", i * 3);
+    return key;
+}
+
+const size_t LOOKUPS = 1000000;
+const size_t BATCH_SIZE = 256;
+
+template<typename Find>
+void time(const char* const name, const size_t count,
+          const vector<string>& keys, Find find)
+{
+    const auto start = std::chrono::steady_clock::now();
+    
+    const size_t found = find(keys);
+    
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    std::printf("%10zu  %-16s  %8.1f ns/lookup  (%zu found)\n", count, name,
+                double(elapsed) / keys.size(), found);
+}
+
+/*
+  Finds the keys in batches, in the order they're given
+ */
+template<typename FindBatch>
+size_t findBatches(const vector<string>& keys, FindBatch findBatch) {
+    size_t found = 0;
+    vector<Lookup> batch;
+    
+    for (size_t i = 0; i < keys.size(); i += BATCH_SIZE) {
+        batch.clear();
+        
+        for (size_t j = i; j < std::min(i + BATCH_SIZE, keys.size()); ++j) {
+            batch.emplace_back(keys[j]);
+        }
+        
+        findBatch(batch);
+        
+        for (const auto& lookup : batch) { found += lookup.hasValue; }
+    }
+    
+    return found;
+}
+
+}
+
+int main() {
+    const string value(16, 'v');
+    
+    for (size_t count = 100000; count <= 10000000; count *= 10) {
+        Tree tree;
+        
+        {
+            BulkLoader loader(tree);
+            
+            for (size_t i = 0; i < count; ++i) {
+                loader.add(makeKey(i), value);
+            }
+            
+            loader.finish();
+        }
+        
+        // Random keys, a few of which are missing, so that every lookup
+        // misses the cache once the tree is large enough
+        vector<string> keys;
+        keys.reserve(LOOKUPS);
+        
+        std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+        
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            keys.push_back(makeKey(nextRandom(seed) % (count + count / 100)));
+        }
+        
+        time("find", count, keys, [&](const vector<string>& keys) {
+            Cursor cursor;
+            size_t found = 0;
+            
+            for (const auto& key : keys) {
+                ops::find(tree, cursor, key);
+                found += ops::hasValue(cursor);
+            }
+            
+            return found;
+        });
+        
+        time("findAll", count, keys, [&](const vector<string>& keys) {
+            return findBatches(keys, [&](vector<Lookup>& batch) {
+                ops::findAll(tree, batch);
+            });
+        });
+        
+        time("findInterleaved", count, keys, [&](const vector<string>& keys) {
+            return findBatches(keys, [&](vector<Lookup>& batch) {
+                ops::findInterleaved(tree, batch);
+            });
+        });
+    }
+    
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*
+  Compares binary searches using the prefix tracking KeyComparator against
+  plain lexicographical comparisons, for keys which share long prefixes. The
+  search can also be narrowed first by the KeyHints of the keys.
+ */
+
+#include "tupl/pvt/KeyComparator.hpp"
+#include "tupl/pvt/KeyHints.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using std::vector;
+using tupl::Bytes;
+using tupl::byte;
+using tupl::pvt::KeyComparator;
+using tupl::pvt::KeyHints;
+
+namespace {
+
+std::uint64_t nextRandom(std::uint64_t& seed) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+vector<string> makeSortedKeys(const size_t count, const size_t prefixSize,
+                              std::uint64_t seed)
+{
+    const string prefix = string("tenant-0042|orders-by-customer-email|") +
+        string(prefixSize, '-');
+    
+    vector<string> keys;
+    
+    for (size_t i = 0; i < count; ++i) {
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), "%016llx",
+                      static_cast<unsigned long long>(nextRandom(seed)));
+        keys.push_back(prefix + suffix);
+    }
+    
+    std::sort(keys.begin(), keys.end());
+    
+    return keys;
+}
+
+/*
+  Packs the keys into one contiguous buffer, like the keys of a node page
+ */
+struct PackedKeys {
+    explicit PackedKeys(const vector<string>& keys) {
+        for (const auto& key : keys) { mBuffer += key; }
+        
+        size_t offset = 0;
+        
+        for (const auto& key : keys) {
+            mKeys.push_back(Bytes{mBuffer.data() + offset, key.size()});
+            offset += key.size();
+        }
+    }
+    
+    string mBuffer;
+    vector<Bytes> mKeys;
+};
+
+// The comparator previously used by slow::Node
+struct KeyLesser {
+    bool operator()(const Bytes l, const Bytes r) const {
+        return std::lexicographical_compare(l.data(), l.data() + l.size(),
+                                            r.data(), r.data() + r.size());
+    }
+};
+
+const size_t ROUNDS = 1000;
+
+template<typename Search>
+void time(const char* const name, const size_t prefixSize,
+          const vector<Bytes>& searches, Search search)
+{
+    const auto start = std::chrono::steady_clock::now();
+    
+    size_t checksum = 0;
+    
+    for (size_t round = 0; round < ROUNDS; ++round) {
+        for (const auto& key : searches) { checksum += search(key); }
+    }
+    
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    
+    std::printf("%8zu  %-24s  %8.1f ns/search  (%zu)\n", prefixSize, name,
+                double(elapsed) / (ROUNDS * searches.size()), checksum);
+}
+
+}
+
+int main() {
+    const size_t nodeKeys = 200;
+    
+    for (size_t prefixSize : {0, 16, 64, 256}) {
+        const PackedKeys packed(makeSortedKeys(nodeKeys, prefixSize, 1));
+        const auto& keys = packed.mKeys;
+        auto searchKeys = makeSortedKeys(1000, prefixSize, 2);
+        
+        // Searches in sorted order would favor the branch predictor
+        std::uint64_t seed = 3;
+        
+        for (size_t i = searchKeys.size(); i > 1; --i) {
+            std::swap(searchKeys[i - 1], searchKeys[nextRandom(seed) % i]);
+        }
+        
+        const PackedKeys packedSearches(searchKeys);
+        const auto& searches = packedSearches.mKeys;
+        
+        time("lexicographical", prefixSize, searches, [&](const Bytes key) {
+            return std::lower_bound(keys.begin(), keys.end(), key,
+                                    KeyLesser()) - keys.begin();
+        });
+        
+        time("KeyComparator", prefixSize, searches, [&](const Bytes key) {
+            KeyComparator comparator(key);
+            return comparator.lowerBound(keys.size(), [&](const size_t pos) {
+                return comparator.compare(keys[pos]);
+            }).first;
+        });
+        
+        // Nodes select the prefix shared by their first and last keys
+        const Bytes first = keys.front();
+        const Bytes last = keys.back();
+        
+        size_t hintPrefixSize = 0;
+        
+        while (hintPrefixSize < std::min(first.size(), last.size()) &&
+               first.data()[hintPrefixSize] == last.data()[hintPrefixSize])
+        {
+            ++hintPrefixSize;
+        }
+        
+        KeyHints hints;
+        hints.reset(Bytes{first.data(), hintPrefixSize});
+        
+        for (const auto& key : keys) { hints.append(hints.hint(key)); }
+        
+        time("KeyHints+KeyComparator", prefixSize, searches,
+             [&](const Bytes key)
+        {
+            const auto range = hints.range(hints.hint(key));
+            
+            KeyComparator comparator(key);
+            return comparator.lowerBound(
+                range.first, range.second, [&](const size_t pos)
+            {
+                return comparator.compare(keys[pos]);
+            }).first;
+        });
+    }
+    
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+  Compares the internal levels built from full split keys against the ones
+  built from the shortest separators, for sorted inserts of long keys.
+ */
+
+#include "tupl/pvt/Node.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::size_t;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using tupl::pvt::Buffer;
+using tupl::pvt::InsertResult;
+using tupl::pvt::InternalNode;
+using tupl::pvt::LeafNode;
+
+namespace {
+
+/*
+  Keys are composite, with a shared leading component and customer emails
+  which vary early, followed by an order number
+ */
+vector<string> makeSortedKeys(const size_t count) {
+    vector<string> keys;
+    keys.reserve(count);
+    
+    std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+    
+    for (size_t i = 0; i < count; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        
+        char key[128];
+        std::snprintf(key, sizeof(key),
+                      "tenant-%04u|orders-by-customer-email|"
+                      "customer-%08x@example.com|order-%010zu",
+                      static_cast<unsigned>(i % 4),
+                      static_cast<unsigned>(seed), i);
+        keys.push_back(key);
+    }
+    
+    std::sort(keys.begin(), keys.end());
+    
+    return keys;
+}
+
+struct Levels {
+    size_t height;
+    size_t nodes;
+    size_t bytes;
+};
+
+/*
+  Packs the separators of one level into full internal nodes, promoting the
+  separator between adjacent nodes to the next level up
+ */
+Levels buildInternalLevels(vector<Buffer> separators) {
+    LeafNode child;
+    Levels levels = Levels();
+    
+    do {
+        vector<Buffer> promoted;
+        unique_ptr<InternalNode> node(new InternalNode(child));
+        
+        for (auto& separator : separators) {
+            if (node->insert(separator, child) == InsertResult::INSERTED) {
+                continue;
+            }
+            
+            levels.bytes += node->bytes();
+            ++levels.nodes;
+            
+            promoted.push_back(std::move(separator));
+            node.reset(new InternalNode(child));
+        }
+        
+        levels.bytes += node->bytes();
+        ++levels.nodes;
+        ++levels.height;
+        
+        separators.swap(promoted);
+    } while (!separators.empty());
+    
+    return levels;
+}
+
+void run(const size_t count) {
+    vector<Buffer> fullKeys;
+    vector<Buffer> separators;
+    
+    const string value(16, 'v');
+    unique_ptr<LeafNode> leaf(new LeafNode);
+    
+    for (const string& key : makeSortedKeys(count)) {
+        if (leaf->insert(key, value) == InsertResult::INSERTED) { continue; }
+        
+        // Sorted inserts always put the new entry in a right sibling
+        unique_ptr<LeafNode> sibling(new LeafNode);
+        leaf->splitAndInsert(key, value, *sibling);
+        
+        fullKeys.push_back(sibling->key(0));
+        separators.push_back(leaf->split().key);
+        
+        leaf.swap(sibling);
+    }
+    
+    const Levels full = buildInternalLevels(fullKeys);
+    const Levels truncated = buildInternalLevels(separators);
+    
+    std::printf("%10zu  %-10s  %6zu  %8zu  %12zu\n",
+                count, "full", full.height + 1, full.nodes, full.bytes);
+    std::printf("%10zu  %-10s  %6zu  %8zu  %12zu\n",
+                count, "shortest", truncated.height + 1, truncated.nodes,
+                truncated.bytes);
+}
+
+}
+
+int main() {
+    std::printf("%10s  %-10s  %6s  %8s  %12s\n",
+                "keys", "separator", "height", "internal", "internal bytes");
+    
+    for (size_t count = 10000; count <= 1000000; count *= 10) {
+        run(count);
+    }
+    
+    return 0;
+}
@@ -20,6 +20,8 @@
 
 #include "types.hpp"
 
+#include <cstdint>
+
 namespace tupl {
 
 /**
@@ -53,6 +55,45 @@ public:
      */
     virtual Bytes value() const = 0;
     
+    /**
+     * Moves the Cursor to find the first available entry. Cursor key and value
+     * are set to null if no entries exist, and position will be undefined.
+     */
+    virtual void first() = 0;
+    
+    /**
+     * Moves the Cursor to find the last available entry. Cursor key and value
+     * are set to null if no entries exist, and position will be undefined.
+     */
+    virtual void last() = 0;
+    
+    /**
+     * Moves the Cursor by a relative amount of entries. Pass a positive amount
+     * for forward movement, and pass a negative amount for reverse
+     * movement. Cursor key and value are set to null if the relative position
+     * is outside the bounds of the view, and position will be undefined.
+     *
+     * @throws IllegalStateException if position is undefined at invocation time
+     */
+    virtual void skip(std::int64_t amount) = 0;
+    
+    /**
+     * Moves to the Cursor to the next available entry. Cursor key and value
+     * are set to null if no next entry exists, and position will be undefined.
+     *
+     * @throws IllegalStateException if position is undefined at invocation time
+     */
+    virtual void next() = 0;
+    
+    /**
+     * Moves to the Cursor to the previous available entry. Cursor key and
+     * value are set to null if no previous entry exists, and position will be
+     * undefined.
+     *
+     * @throws IllegalStateException if position is undefined at invocation time
+     */
+    virtual void previous() = 0;
+    
     /**
      * Moves the Cursor to find the given key.
      *
@@ -20,6 +20,11 @@
 
 #include "Cursor.hpp"
 
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
 namespace tupl {
 
 /**
@@ -42,6 +47,71 @@ public:
      * copyable, pointage is an implementation detail.
      */
     virtual Cursor* newCursor() = 0;
+    
+    /**
+     * Loads the values of several keys at once, which is cheaper than finding
+     * them one at a time, since the keys share the search of their common
+     * path through the view. Keys can be given in any order, and may repeat.
+     *
+     * @param keys keys to load
+     * @param consumer receives the index of each key along with its value,
+     * which is null if the key is missing, and is only valid during the call
+     */
+    virtual void load(const std::vector<Bytes>& keys,
+                      const std::function<void(std::size_t, Bytes)>& consumer)
+        = 0;
+    
+    /**
+     * Stores several entries at once, which is cheaper than storing them one
+     * at a time, since the entries which belong together in the view are
+     * stored together. Entries can be given in any order, and where a key
+     * repeats, the last entry given for it wins.
+     *
+     * @param entries keys paired with the values to store; a null value
+     * deletes the entry of its key
+     */
+    virtual void storeAll(const std::vector<std::pair<Bytes, Bytes>>& entries)
+        = 0;
+    
+    /**
+     * Stores a value only if no entry exists for the key.
+     *
+     * @param key non-null key
+     * @param value value to insert, null to do nothing
+     * @return false if an entry already exists, which is left alone
+     */
+    virtual bool insert(Bytes key, Bytes value) = 0;
+    
+    /**
+     * Stores a value only if an entry exists for the key.
+     *
+     * @param key non-null key
+     * @param value value to store, null to delete the entry
+     * @return false if no entry exists
+     */
+    virtual bool replace(Bytes key, Bytes value) = 0;
+    
+    /**
+     * Stores a value only if the entry of the key has the expected value.
+     *
+     * @param key non-null key
+     * @param oldValue expected value, null if no entry is expected
+     * @param newValue value to store, null to delete the entry
+     * @return false if the value of the entry differs, which is left alone
+     */
+    virtual bool update(Bytes key, Bytes oldValue, Bytes newValue) = 0;
+    
+    /**
+     * Stores a value unconditionally, passing the value which it replaced to
+     * the consumer.
+     *
+     * @param key non-null key
+     * @param value value to store, null to delete the entry
+     * @param consumer receives the old value, which is null if no entry
+     * existed, and is only valid during the call
+     */
+    virtual void exchange(Bytes key, Bytes value,
+                          const std::function<void(Bytes)>& consumer) = 0;
 };
 
 }
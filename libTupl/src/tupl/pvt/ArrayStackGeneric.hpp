@@ -27,7 +27,8 @@ public:
     ArrayStackGeneric();
     ~ArrayStackGeneric();
     
-    void emplaceBack(T&& val);
+    template<typename... Args>
+    void emplaceBack(Args&&... args);
     
     void pop();
     
@@ -65,7 +66,7 @@ public:
     
 private:
     T* mTop;
-    std::aligned_storage<sizeof(T), alignof(T)> mElems[N];
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type mElems[N];
 };
 
 // typedef ArrayStackGeneric<CursorFrame, 64u> CursorFrameStack;
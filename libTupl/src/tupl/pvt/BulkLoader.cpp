@@ -0,0 +1,129 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "BulkLoader.hpp"
+
+#include "Node.hpp"
+#include "Tree.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using std::size_t;
+
+namespace tupl { namespace pvt {
+
+BulkLoader::BulkLoader(Tree& tree, const double fillFactor) :
+    mTree(tree),
+    mFillFactor(fillFactor),
+    mLeaf(nullptr), mEntries(0), mFinished(false)
+{
+    if (!(fillFactor > 0 && fillFactor <= 1)) {
+        throw std::invalid_argument("fill factor must be in (0, 1]");
+    }
+    
+    // A new tree has a root with a single empty leaf, which both become the
+    // first nodes of their levels
+    InternalNode* const root = tree.root.load(std::memory_order_acquire);
+    
+    if (root->size() != 0 || !root->child(0)->isLeaf() ||
+        !static_cast<LeafNode*>(root->child(0))->empty())
+    {
+        throw std::logic_error("tree is not empty");
+    }
+    
+    mLeaf = static_cast<LeafNode*>(root->child(0));
+    mLevels.push_back(root);
+}
+
+void BulkLoader::add(const Bytes key, const Bytes value) {
+    if (mFinished) { throw std::logic_error("load is finished"); }
+    
+    if (mEntries && !(Bytes{mLastKey} < key)) {
+        throw std::invalid_argument("keys must be added in ascending order");
+    }
+    
+    const NodeKey nodeKey = mTree.nodeKey(key);
+    const LeafValue leafValue = mTree.leafValue(*mLeaf, key, value);
+    
+    if (mLeaf->bytes() >= mLeaf->capacity() * mFillFactor ||
+        mLeaf->insert(mLeaf->size(), nodeKey, leafValue) !=
+        InsertResult::INSERTED)
+    {
+        LeafNode* const leaf = mTree.allocateLeaf();
+        
+        // The keys following this one likely share the prefix that spans the
+        // previous leaf
+        const size_t prefixSize = std::min({
+            mFirstKey.size(), key.size(), leaf->maxKeyPrefixSize()});
+        
+        size_t common = 0;
+        
+        while (common < prefixSize && mFirstKey[common] == key.data()[common]) {
+            ++common;
+        }
+        
+        if (common) { leaf->keyPrefix(Bytes{key.data(), common}); }
+        
+        if (leaf->insert(0, nodeKey, leafValue) != InsertResult::INSERTED) {
+            throw std::logic_error("entry doesn't fit in an empty leaf");
+        }
+        
+        const Buffer separator = shortestSeparator(mLastKey, key);
+        appendChild(0, mTree.nodeKey(separator), *leaf);
+        
+        mLeaf = leaf;
+        mFirstKey.assign(key.data(), key.data() + key.size());
+    } else if (mLeaf->size() == 1) {
+        mFirstKey.assign(key.data(), key.data() + key.size());
+    }
+    
+    mLastKey.assign(key.data(), key.data() + key.size());
+    ++mEntries;
+}
+
+void BulkLoader::appendChild(const size_t level, const NodeKey& separator,
+                             Node& child)
+{
+    InternalNode* const node = mLevels[level];
+    
+    if (node->bytes() < node->capacity() * mFillFactor &&
+        node->insert(node->size(), separator, child,
+                     SiblingDirection::RIGHT) == InsertResult::INSERTED)
+    {
+        return;
+    }
+    
+    // The separator moves up, in front of a new node starting with child
+    InternalNode* const next = mTree.allocateInternal(child);
+    
+    if (level + 1 == mLevels.size()) {
+        mLevels.push_back(mTree.allocateInternal(*node));
+    }
+    
+    mLevels[level] = next;
+    
+    appendChild(level + 1, separator, *next);
+}
+
+void BulkLoader::finish() {
+    if (mFinished) { throw std::logic_error("load is finished"); }
+    
+    mFinished = true;
+    mTree.root.store(mLevels.back(), std::memory_order_release);
+}
+
+} }
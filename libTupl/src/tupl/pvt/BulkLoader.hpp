@@ -0,0 +1,92 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_BULKLOADER_HPP
+#define _TUPL_PVT_BULKLOADER_HPP
+
+#include "../types.hpp"
+#include "Buffer.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace tupl { namespace pvt {
+
+class InternalNode;
+class LeafNode;
+class Node;
+class NodeKey;
+class Tree;
+
+/**
+   Fills an empty Tree from entries added in ascending key order. Leaves are
+   filled one after the other, up to the fill factor, and the internal levels
+   are built from the bottom up as leaves are completed, so no node is ever
+   split or searched.
+   
+   The tree must not be accessed by anything else until the load is
+   finished.
+   
+   @author Vishal Parakh
+ */
+class BulkLoader final {
+public:
+    /**
+       The fill factor is the fraction of each node's capacity to fill, in
+       the range (0, 1]. Lower values leave room for later inserts.
+     */
+    explicit BulkLoader(Tree& tree, double fillFactor = 1.0);
+    
+    BulkLoader(const BulkLoader&) = delete;
+    BulkLoader& operator=(const BulkLoader&) = delete;
+    
+    /**
+       Adds an entry, whose key must be greater than the key of the previous
+       entry
+     */
+    void add(Bytes key, Bytes value);
+    
+    /**
+       Makes the top of the internal levels the root of the tree
+     */
+    void finish();
+    
+private:
+    /*
+      Appends a separator and the child following it to the internal node
+      being filled at level, starting a new node if it's full
+     */
+    void appendChild(std::size_t level, const NodeKey& separator,
+                     Node& child);
+    
+    Tree& mTree;
+    
+    const double mFillFactor;
+    
+    LeafNode* mLeaf;
+    
+    // The internal node being filled at each level, from the bottom up
+    std::vector<InternalNode*> mLevels;
+    
+    Buffer mFirstKey;
+    Buffer mLastKey;
+    std::size_t mEntries;
+    bool mFinished;
+};
+
+} }
+
+#endif
@@ -18,7 +18,15 @@
 #include "Cursor.hpp"
 #include "ArrayStackGeneric.ii"
 
+#include "Node.hpp"
+#include "ops.hpp"
 
 namespace tupl { namespace pvt {
 
+Cursor::Cursor() : hasValue(false), tree(nullptr) {}
+
+Cursor::~Cursor() {
+    ops::reset(*this);
+}
+
 } }
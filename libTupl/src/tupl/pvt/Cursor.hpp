@@ -31,6 +31,7 @@ class Tree;
 namespace tupl { namespace pvt {
 
 class ops;
+class Tree;
 
 /**
    @author Vishal Parakh
@@ -41,6 +42,8 @@ class Cursor final {
     //
     // Consider making Cursor an inner-class of Tree
 public:    
+    Cursor();
+    
     /**
       Not copyable.
       
@@ -55,9 +58,12 @@ public:
     ~Cursor();
     
 private:    
-    // Lower case because these two are part of the interface exposed to ops;
-    Buffer key;    
+    // Lower case because these are part of the interface exposed to ops;
+    Buffer key;
+    Buffer value;
+    bool   hasValue; // false if the key was not found
     ArrayStackGeneric<CursorFrame, 64> stackFrames;
+    Tree*  tree;     // Tree whose nodes the frames are bound to, if any
     
     friend class ops;
 };
@@ -27,24 +27,28 @@
 
 namespace tupl { namespace pvt {
 
-namespace slow { class Node; }
-
+class Node;
 class ops;
 
 /**
    @author Vishal Parakh
  */
 class CursorFrame final {
-    typedef slow::Node Node;
-
     Node* node() { return mNode.load(std::memory_order_acquire); }
     
+public:
+    CursorFrame() :
+        mNode(nullptr), position(0), notFoundKey(), parentFrame(nullptr) {}
+    
 private:
     std::atomic<Node*> mNode;
     
 private: //used by friends
     std::size_t position;
-    Bytes   notFoundKey; // TODO: Who owns me??
+    Bytes   notFoundKey; // Owned by the Cursor, null if the key was found
+    
+    // Frame bound to the parent of the node, null for the root frame
+    CursorFrame* parentFrame;
     
 public:
     // Used to keep track of all the Cursor's visiting a Node
@@ -52,7 +56,8 @@ public:
     // Use a safe-link during development. In the long-term,
     // this can be revised to use a normal link
     // 
-    // Guarded by the Latch guarding the node that this Frame is visiting
+    // Guarded by the Latch guarding the node that this Frame is visiting,
+    // along with the node's visitorFramesLatch when it's only latched shared
     // 
     // Do not use directly, for manipluation by boost::intrusive container
     typedef boost::intrusive::list_member_hook<
@@ -0,0 +1,144 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Epochs.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+namespace tupl { namespace pvt {
+
+namespace {
+
+/*
+  Guards which find objects left to delete only try to delete them once in
+  this many exits, since it scans all the slots
+ */
+const unsigned RECLAIM_INTERVAL = 64;
+
+/*
+  Slot where the guards of the current thread start looking for a free one.
+  Threads are dealt out over the slots in turn, so that they rarely compete
+  for the same one.
+ */
+std::size_t preferredSlot(const std::size_t slotCount) {
+    static std::atomic<std::size_t> nextSlot(0);
+    static thread_local const std::size_t slot =
+        nextSlot.fetch_add(1, std::memory_order_relaxed) % slotCount;
+    return slot;
+}
+
+}
+
+Epochs::Guard::Guard(Epochs& epochs) :
+    mEpochs(epochs), mSlot(epochs.claimSlot()) {}
+
+Epochs::Guard::~Guard() {
+    mSlot.store(INACTIVE, std::memory_order_release);
+    
+    static thread_local unsigned exits = 0;
+    
+    if (mEpochs.retired() > 0 && ++exits % RECLAIM_INTERVAL == 0) {
+        mEpochs.reclaim();
+    }
+}
+
+Epochs::Epochs(): mEpoch(0), mRetiredCount(0) {
+    for (auto& slot : mSlots) {
+        slot.epoch.store(INACTIVE, std::memory_order_relaxed);
+    }
+}
+
+Epochs::~Epochs() {
+    for (const auto& retired : mRetired) { retired.deleter(retired.object); }
+}
+
+std::atomic<std::uint64_t>& Epochs::claimSlot() {
+    const std::size_t start = preferredSlot(SLOT_COUNT);
+    
+    for (std::size_t i = start; ; i = (i + 1) % SLOT_COUNT) {
+        auto& slot = mSlots[i].epoch;
+        std::uint64_t expected = INACTIVE;
+        
+        if (slot.load(std::memory_order_relaxed) == INACTIVE &&
+            slot.compare_exchange_strong(
+                expected, mEpoch.load(std::memory_order_acquire)))
+        {
+            // The published epoch must be visible before anything guarded is
+            // read, otherwise reclaim could miss it
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            return slot;
+        }
+        
+        // Every slot is claimed by a guard of another thread
+        if ((i + 1) % SLOT_COUNT == start) { std::this_thread::yield(); }
+    }
+}
+
+void Epochs::retire(void* const object, const Deleter deleter) {
+    {
+        std::lock_guard<Latch> retiredLock(mRetiredLatch);
+        
+        // The epoch only advances while the latch is held
+        mRetired.push_back(Retired{mEpoch.load(std::memory_order_relaxed),
+                                   object, deleter});
+        mRetiredCount.store(mRetired.size(), std::memory_order_relaxed);
+    }
+    
+    reclaim();
+}
+
+void Epochs::reclaim() {
+    std::vector<Retired> deletable;
+    
+    {
+        // Another thread is already reclaiming
+        if (!mRetiredLatch.try_lock()) { return; }
+        
+        std::lock_guard<Latch> retiredLock(mRetiredLatch, std::adopt_lock);
+        
+        // Pairs with the fence of the guards claiming their slot
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        std::uint64_t epoch = mEpoch.load(std::memory_order_relaxed);
+        
+        const bool caughtUp = std::all_of(
+            std::begin(mSlots), std::end(mSlots), [&](const Slot& slot)
+        {
+            const std::uint64_t slotEpoch =
+                slot.epoch.load(std::memory_order_relaxed);
+            return slotEpoch == INACTIVE || slotEpoch == epoch;
+        });
+        
+        if (caughtUp) { mEpoch.store(++epoch, std::memory_order_release); }
+        
+        // Guards which could have seen an object published an epoch no later
+        // than its own, and they're all gone once the epoch is two past it
+        const auto firstDeletable = std::partition(
+            mRetired.begin(), mRetired.end(), [&](const Retired& retired) {
+                return retired.epoch + 2 > epoch;
+            });
+        
+        deletable.assign(firstDeletable, mRetired.end());
+        mRetired.erase(firstDeletable, mRetired.end());
+        mRetiredCount.store(mRetired.size(), std::memory_order_relaxed);
+    }
+    
+    for (const auto& retired : deletable) { retired.deleter(retired.object); }
+}
+
+} }
@@ -0,0 +1,135 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_EPOCHS_HPP
+#define _TUPL_PVT_EPOCHS_HPP
+
+#include "Latch.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tupl { namespace pvt {
+
+/**
+   Epoch based reclamation of objects which threads might still be reading
+   after they were taken out of a shared structure.
+   
+   Threads access the structure within a Guard, which publishes the global
+   epoch seen when it was entered in a slot of its own. The global epoch only
+   advances once every published epoch has caught up with it. Retired objects
+   are tagged with the global epoch, and deleted once it advanced twice past
+   that, when no guard which could have seen them is left.
+   
+   Guards claim any free slot, starting from one picked by the thread, so
+   threads don't need to register, and they can't leak slots when they exit.
+   
+   @author Vishal Parakh
+ */
+class Epochs final {
+public:
+    /**
+       Keeps the objects retired while it exists from being deleted. Guards
+       can be nested, each one claiming a slot of its own.
+     */
+    class Guard final {
+    public:
+        explicit Guard(Epochs& epochs);
+        
+        ~Guard();
+        
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    
+    private:
+        Epochs& mEpochs;
+        std::atomic<std::uint64_t>& mSlot;
+    };
+    
+    Epochs();
+    
+    /**
+       Deletes the objects which are still retired, which must no longer be
+       guarded
+     */
+    ~Epochs();
+    
+    Epochs(const Epochs&) = delete;
+    Epochs& operator=(const Epochs&) = delete;
+    
+    /**
+       Deletes object once no guard which could have seen it is left
+     */
+    template<typename T>
+    void retire(std::unique_ptr<T> object) {
+        retire(object.release(),
+               [](void* const retired) { delete static_cast<T*>(retired); });
+    }
+    
+    /**
+       Advances the global epoch if every guard has caught up with it, and
+       deletes the retired objects which can no longer be seen
+     */
+    void reclaim();
+    
+    /**
+       Number of objects which are retired but not deleted yet
+     */
+    std::size_t retired() const {
+        return mRetiredCount.load(std::memory_order_relaxed);
+    }
+
+private:
+    typedef void (*Deleter)(void*);
+    
+    struct Retired {
+        std::uint64_t epoch;
+        void* object;
+        Deleter deleter;
+    };
+    
+    // Each slot fills a cache line, so that guards don't write to the line
+    // of another slot
+    struct Slot {
+        std::atomic<std::uint64_t> epoch;
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+    
+    static const std::size_t SLOT_COUNT = 128;
+    
+    // Epoch of free slots, which the global epoch never reaches
+    static const std::uint64_t INACTIVE = ~std::uint64_t(0);
+    
+    void retire(void* object, Deleter deleter);
+    
+    std::atomic<std::uint64_t>& claimSlot();
+    
+    std::atomic<std::uint64_t> mEpoch;
+    
+    Slot mSlots[SLOT_COUNT];
+    
+    // Guards the retired objects
+    Latch mRetiredLatch;
+    std::vector<Retired> mRetired;
+    std::atomic<std::size_t> mRetiredCount;
+};
+
+} }
+
+#endif
@@ -0,0 +1 @@
+#include "KeyComparator.hpp"
@@ -0,0 +1,207 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_KEYCOMPARATOR_HPP
+#define _TUPL_PVT_KEYCOMPARATOR_HPP
+
+#include "../types.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace tupl { namespace pvt {
+
+/**
+   Compares node keys against a search key during a binary search. The
+   comparator remembers how many leading bytes the search key shares with the
+   closest lower key and the closest higher key seen so far. Every key between
+   those two, in sorted order, shares at least the smaller count, so those
+   bytes are skipped by later comparisons.
+   
+   A comparator must only be used for a single sorted sequence of keys.
+   
+   @author Vishal Parakh
+ */
+class KeyComparator final {
+public:
+    explicit KeyComparator(const Bytes key) :
+        mKey(key), mLoPrefixSize(0), mHiPrefixSize(0) {}
+    
+    Bytes key() const { return mKey; }
+    
+    /**
+       Returns a negative number, zero or a positive number if the node key is
+       lower than, equal to or higher than the search key.
+       
+       The node key can exclude its first `offset` bytes, which the caller
+       knows to be equal to those of the search key.
+     */
+    int compare(Bytes nodeKey, std::size_t offset = 0);
+    
+    /**
+       Records the result of a comparison made without this comparator, where
+       the node key shares commonSize leading bytes with the search key
+     */
+    void record(int result, std::size_t commonSize);
+    
+    /**
+       Binary search over size keys, where compareAt(pos) compares the key at
+       pos using this comparator. Returns a pair whose:
+       
+       .first => the position of the first key which is not less than
+       (i.e. greater or equal to) the search key.
+       
+       .second => true if an exact match was found
+     */
+    template<typename CompareAt>
+    std::pair<std::size_t, bool> lowerBound(std::size_t size,
+                                            CompareAt compareAt)
+    {
+        return lowerBound(0, size, compareAt);
+    }
+    
+    /**
+       Binary search over the keys at positions [begin, end), which must
+       contain the lower bound or be followed by it
+     */
+    template<typename CompareAt>
+    std::pair<std::size_t, bool> lowerBound(std::size_t begin, std::size_t end,
+                                            CompareAt compareAt);
+
+private:
+    /**
+       Returns the number of leading bytes which are equal
+     */
+    static std::size_t mismatch(const byte* l, const byte* r,
+                                std::size_t size);
+    
+    const Bytes mKey;
+    
+    std::size_t mLoPrefixSize;
+    std::size_t mHiPrefixSize;
+};
+
+inline
+int KeyComparator::compare(const Bytes nodeKey, const std::size_t offset) {
+    const std::size_t nodeSize = offset + nodeKey.size();
+    const std::size_t cmpSize = std::min(nodeSize, mKey.size());
+    const std::size_t known =
+        std::max(std::min(mLoPrefixSize, mHiPrefixSize), offset);
+    
+    assert(offset <= mKey.size() && known <= cmpSize);
+    
+    const byte* const l = nodeKey.data() + (known - offset);
+    const byte* const r = mKey.data() + known;
+    const std::size_t remaining = cmpSize - known;
+    const std::size_t i = mismatch(l, r, remaining);
+    
+    int result;
+    
+    if (i < remaining) {
+        result = l[i] < r[i] ? -1 : 1;
+    } else {
+        // Shorter keys are lower than the keys they are a prefix of
+        result = nodeSize < mKey.size() ? -1 :
+            (nodeSize > mKey.size() ? 1 : 0);
+    }
+    
+    record(result, known + i);
+    
+    return result;
+}
+
+inline
+std::size_t KeyComparator::mismatch(
+    const byte* const l, const byte* const r, const std::size_t size)
+{
+    std::size_t i = 0;
+    
+#if defined(__SSE2__)
+    for (; i + 16 <= size; i += 16) {
+        const __m128i lChunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(l + i));
+        const __m128i rChunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + i));
+        
+        const unsigned unequal =
+            _mm_movemask_epi8(_mm_cmpeq_epi8(lChunk, rChunk)) ^ 0xffff;
+        
+        if (unequal) { return i + __builtin_ctz(unequal); }
+    }
+#endif
+    
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // The lowest set bit of the difference is in the first unequal byte
+    for (; i + sizeof(std::uint64_t) <= size; i += sizeof(std::uint64_t)) {
+        std::uint64_t lWord, rWord;
+        std::memcpy(&lWord, l + i, sizeof(lWord));
+        std::memcpy(&rWord, r + i, sizeof(rWord));
+        
+        if (const std::uint64_t diff = lWord ^ rWord) {
+            return i + (__builtin_ctzll(diff) >> 3);
+        }
+    }
+#endif
+    
+    while (i < size && l[i] == r[i]) { ++i; }
+    
+    return i;
+}
+
+inline
+void KeyComparator::record(const int result, const std::size_t commonSize) {
+    if (result < 0) {
+        mLoPrefixSize = commonSize;
+    } else if (result > 0) {
+        mHiPrefixSize = commonSize;
+    }
+}
+
+template<typename CompareAt>
+std::pair<std::size_t, bool> KeyComparator::lowerBound(
+    const std::size_t begin, const std::size_t end, CompareAt compareAt)
+{
+    std::size_t lo = begin;
+    std::size_t hi = end;
+    
+    while (lo < hi) {
+        const std::size_t mid = (lo + hi) >> 1;
+        const int cmp = compareAt(mid);
+        
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else if (cmp > 0) {
+            hi = mid;
+        } else {
+            return std::make_pair(mid, true);
+        }
+    }
+    
+    return std::make_pair(lo, false);
+}
+
+} }
+
+#endif
@@ -0,0 +1,128 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "KeyHints.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using std::size_t;
+using std::uint32_t;
+
+namespace tupl { namespace pvt {
+
+namespace {
+
+/*
+  Counts the biased hints which are lower than and higher than the biased
+  hint, without branching on the comparisons
+ */
+std::pair<size_t, size_t> countLowerHigher(
+    const uint32_t* const hints, const size_t size, const uint32_t hint)
+{
+    const std::int32_t target = static_cast<std::int32_t>(hint);
+    
+    size_t lower = 0;
+    size_t higher = 0;
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i targets = _mm256_set1_epi32(target);
+    __m256i lowerSums = _mm256_setzero_si256();
+    __m256i higherSums = _mm256_setzero_si256();
+    
+    // Matching lanes are -1, so subtracting them counts
+    for (; i + 8 <= size; i += 8) {
+        const __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hints + i));
+        
+        lowerSums = _mm256_sub_epi32(
+            lowerSums, _mm256_cmpgt_epi32(targets, chunk));
+        higherSums = _mm256_sub_epi32(
+            higherSums, _mm256_cmpgt_epi32(chunk, targets));
+    }
+    
+    alignas(32) std::int32_t lowerLanes[8];
+    alignas(32) std::int32_t higherLanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lowerLanes), lowerSums);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(higherLanes), higherSums);
+    
+    for (size_t lane = 0; lane < 8; ++lane) {
+        lower += lowerLanes[lane];
+        higher += higherLanes[lane];
+    }
+#elif defined(__SSE2__)
+    const __m128i targets = _mm_set1_epi32(target);
+    __m128i lowerSums = _mm_setzero_si128();
+    __m128i higherSums = _mm_setzero_si128();
+    
+    // Matching lanes are -1, so subtracting them counts
+    for (; i + 4 <= size; i += 4) {
+        const __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(hints + i));
+        
+        lowerSums = _mm_sub_epi32(lowerSums, _mm_cmpgt_epi32(targets, chunk));
+        higherSums = _mm_sub_epi32(higherSums, _mm_cmpgt_epi32(chunk, targets));
+    }
+    
+    alignas(16) std::int32_t lowerLanes[4];
+    alignas(16) std::int32_t higherLanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lowerLanes), lowerSums);
+    _mm_store_si128(reinterpret_cast<__m128i*>(higherLanes), higherSums);
+    
+    for (size_t lane = 0; lane < 4; ++lane) {
+        lower += lowerLanes[lane];
+        higher += higherLanes[lane];
+    }
+#endif
+    
+    // Scalar fallback, and the remainder of the SIMD loops
+    for (; i < size; ++i) {
+        const std::int32_t value = static_cast<std::int32_t>(hints[i]);
+        lower += value < target;
+        higher += value > target;
+    }
+    
+    return std::make_pair(lower, higher);
+}
+
+}
+
+void KeyHints::reset(const Bytes prefix) {
+    mPrefix.clear();
+    
+    if (prefix.size()) {
+        mPrefix.assign(prefix.data(), prefix.data() + prefix.size());
+    }
+    
+    mHints.clear();
+}
+
+void KeyHints::insert(const size_t pos, const uint32_t hint) {
+    mHints.insert(mHints.begin() + pos, bias(hint));
+}
+
+std::pair<size_t, size_t> KeyHints::range(const uint32_t hint) const {
+    const auto counts = countLowerHigher(mHints.data(), mHints.size(),
+                                         bias(hint));
+    
+    return std::make_pair(counts.first, mHints.size() - counts.second);
+}
+
+} }
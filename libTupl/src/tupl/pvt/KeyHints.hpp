@@ -0,0 +1,131 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_KEYHINTS_HPP
+#define _TUPL_PVT_KEYHINTS_HPP
+
+#include "../types.hpp"
+#include "Buffer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace tupl { namespace pvt {
+
+/**
+   Fixed width hints for the keys of a node, one per search vector slot, which
+   narrow a search down before any full keys are compared.
+   
+   The hints are kept in memory next to the node page rather than in it. The
+   page format stays compatible with Tupl, and no page space is taken from
+   the entries. Hints are derived from the keys, so they are rebuilt instead
+   of being persisted. The cost is a second array to shift on every insert,
+   which is small next to the rest of a store, and a separate allocation
+   whose cache lines a search touches besides those of the page.
+   
+   A hint is made of the four bytes following a hint prefix, compared as a
+   big-endian unsigned integer and padded with zeros. Keys which don't start
+   with the hint prefix get the lowest or highest hint, depending on how they
+   order against it. Hints never decrease from one key to the next, so only
+   the keys having the same hint as the search key need to be compared.
+   
+   @author Vishal Parakh
+ */
+class KeyHints final {
+public:
+    /**
+       Discards all hints, and selects the prefix to skip when making them
+     */
+    void reset(Bytes prefix);
+    
+    Bytes prefix() const { return mPrefix; }
+    
+    std::size_t size() const { return mHints.size(); }
+    
+    /**
+       Makes the hint of a key
+     */
+    std::uint32_t hint(Bytes key) const;
+    
+    /**
+       Makes the hint of the bytes following the hint prefix
+     */
+    static std::uint32_t hintAfterPrefix(Bytes suffix);
+    
+    void insert(std::size_t pos, std::uint32_t hint);
+    
+    void append(std::uint32_t hint) { mHints.push_back(bias(hint)); }
+    
+    std::uint32_t at(std::size_t pos) const { return bias(mHints[pos]); }
+    
+    /**
+       Returns the range [first, second] of positions which can hold the
+       first key that isn't lower than a key having the given hint. Keys
+       before first are lower, and keys from second onwards are higher.
+     */
+    std::pair<std::size_t, std::size_t> range(std::uint32_t hint) const;
+
+private:
+    // Hints are stored with the sign bit flipped, allowing SIMD kernels to
+    // compare them as signed integers
+    static std::uint32_t bias(const std::uint32_t hint) {
+        return hint ^ 0x80000000u;
+    }
+    
+    Buffer mPrefix;
+    std::vector<std::uint32_t> mHints;
+};
+
+inline
+std::uint32_t KeyHints::hintAfterPrefix(const Bytes suffix) {
+    const byte* const data = suffix.data();
+    const std::size_t size = suffix.size();
+    
+    std::uint32_t hint = 0;
+    
+    for (std::size_t i = 0; i < 4; ++i) {
+        hint = (hint << 8) | (i < size ? data[i] : 0);
+    }
+    
+    return hint;
+}
+
+inline
+std::uint32_t KeyHints::hint(const Bytes key) const {
+    const std::size_t prefixSize = mPrefix.size();
+    
+    if (prefixSize == 0) { return hintAfterPrefix(key); }
+    
+    const std::size_t cmpSize = std::min(prefixSize, key.size());
+    const int cmp =
+        cmpSize ? std::memcmp(key.data(), mPrefix.data(), cmpSize) : 0;
+    
+    if (cmp == 0 && key.size() >= prefixSize) {
+        return hintAfterPrefix(Bytes{key.data() + prefixSize,
+                                     key.size() - prefixSize});
+    }
+    
+    // Keys which are a prefix of the hint prefix are lower than it
+    return cmp > 0 ? 0xffffffffu : 0;
+}
+
+} }
+
+#endif
@@ -16,3 +16,95 @@
  */
 
 #include "Latch.hpp"
+
+#include <climits>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace tupl { namespace pvt {
+
+namespace {
+
+// Spinning only helps if the holder can run at the same time
+const unsigned SPIN_LIMIT = std::thread::hardware_concurrency() > 1 ? 256 : 0;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+}
+
+void Latch::lockSlow() {
+    for (unsigned spins = 0; ; ++spins) {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        if ((state & ~WAITERS) == 0) {
+            if (mState.compare_exchange_weak(state, state | EXCLUSIVE,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+            {
+                return;
+            }
+        } else if (spins < SPIN_LIMIT) {
+            cpuRelax();
+        } else {
+            park(state);
+        }
+    }
+}
+
+void Latch::lockSharedSlow() {
+    for (unsigned spins = 0; ; ++spins) {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        if ((state & EXCLUSIVE) == 0) {
+            if (mState.compare_exchange_weak(state, state + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+            {
+                return;
+            }
+        } else if (spins < SPIN_LIMIT) {
+            cpuRelax();
+        } else {
+            park(state);
+        }
+    }
+}
+
+void Latch::park(std::uint32_t state) {
+    if ((state & WAITERS) == 0) {
+        if (!mState.compare_exchange_strong(state, state | WAITERS,
+                                            std::memory_order_relaxed))
+        {
+            return;
+        }
+        
+        state |= WAITERS;
+    }
+    
+#ifdef __linux__
+    // Doesn't sleep if the state no longer matches, so a release between
+    // setting the waiters bit and here isn't missed
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&mState),
+            FUTEX_WAIT_PRIVATE, state, nullptr, nullptr, 0);
+#else
+    std::this_thread::yield();
+#endif
+}
+
+void Latch::wakeAll() {
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&mState),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+} }
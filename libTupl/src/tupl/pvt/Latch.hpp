@@ -18,22 +18,175 @@
 #define _TUPL_PVT_LATCH_HPP
 
 #include <boost/thread/locks.hpp>
-#include <boost/thread/shared_mutex.hpp>
+
+#include <atomic>
+#include <cstdint>
 
 namespace tupl { namespace pvt {
 
 /**
-   TODO Requirements:
+   Non-reentrant read/write lock, using unfair acquisition. It doesn't track
+   thread ownership or check for illegal usage.
+   
+   The whole state is a single word: the exclusive bit, a bit indicating
+   that some thread might be parked, and the count of shared holders.
+   Uncontended acquires and releases are a single atomic operation. A
+   contended acquire spins for a short while and then parks the thread, on
+   a futex where one is available. Releasing wakes every parked thread,
+   which race again for the latch.
    
-   Non-reentrant read/write lock, using unfair acquisition. Implementation
-   need not track thread ownership or check for illegal usage.
+   A version, counting the exclusive releases, allows reading what the latch
+   guards optimistically. Readers record the version, read without latching,
+   and then validate that no exclusive holder came in between, retrying
+   otherwise. What they read must stay allocated, and must be read in a way
+   which tolerates seeing it half changed.
  */
-class Latch: public boost::shared_mutex {
+class Latch {
 public:
-    typedef boost::unique_lock<boost::shared_mutex> scoped_exclusive_lock;
-    typedef boost::shared_lock<boost::shared_mutex> scoped_shared_lock;
+    typedef boost::unique_lock<Latch> scoped_exclusive_lock;
+    typedef boost::shared_lock<Latch> scoped_shared_lock;
+    
+    Latch(): mState(0), mVersion(0) {}
+    
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+    
+    void lock() {
+        std::uint32_t state = 0;
+        
+        if (!mState.compare_exchange_weak(state, EXCLUSIVE,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed))
+        {
+            lockSlow();
+        }
+        
+        exclusiveAcquired();
+    }
+    
+    bool try_lock() {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        if ((state & ~WAITERS) != 0 ||
+            !mState.compare_exchange_strong(state, state | EXCLUSIVE,
+                                            std::memory_order_acquire,
+                                            std::memory_order_relaxed))
+        {
+            return false;
+        }
+        
+        exclusiveAcquired();
+        return true;
+    }
+    
+    void unlock() {
+        mVersion.store(mVersion.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+        
+        // Shared holders can't change the state while it's held
+        // exclusively, but parking threads can set the waiters bit
+        if (mState.exchange(0, std::memory_order_release) & WAITERS) {
+            wakeAll();
+        }
+    }
+    
+    void lock_shared() {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        if ((state & EXCLUSIVE) != 0 ||
+            !mState.compare_exchange_weak(state, state + 1,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed))
+        {
+            lockSharedSlow();
+        }
+    }
+    
+    bool try_lock_shared() {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        while ((state & EXCLUSIVE) == 0) {
+            if (mState.compare_exchange_weak(state, state + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+        
+        return false;
+    }
+    
+    void unlock_shared() {
+        std::uint32_t state = mState.load(std::memory_order_relaxed);
+        
+        // The last shared holder clears the waiters bit and wakes them
+        for (;;) {
+            const std::uint32_t next =
+                state - 1 == WAITERS ? 0 : state - 1;
+            
+            if (mState.compare_exchange_weak(state, next,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed))
+            {
+                if (state - 1 == WAITERS) { wakeAll(); }
+                return;
+            }
+        }
+    }
+
+    /**
+       Starts an optimistic read, unless the latch is held exclusively.
+       Returns false if it is, otherwise stores the version to validate.
+     */
+    bool tryOptimistic(std::uint32_t& version) const {
+        version = mVersion.load(std::memory_order_acquire);
+        return (mState.load(std::memory_order_acquire) & EXCLUSIVE) == 0;
+    }
+    
+    /**
+       Returns true if the latch wasn't acquired exclusively since the
+       optimistic read which got the version started
+     */
+    bool validate(const std::uint32_t version) const {
+        // Orders the optimistic reads before the checks
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        return (mState.load(std::memory_order_acquire) & EXCLUSIVE) == 0 &&
+            mVersion.load(std::memory_order_relaxed) == version;
+    }
+    
+private:
+    static const std::uint32_t EXCLUSIVE = 0x80000000u;
+    static const std::uint32_t WAITERS   = 0x40000000u;
+    
+    void lockSlow();
+    void lockSharedSlow();
+    
+    /*
+      Sets the waiters bit unless the state has changed from state, and
+      sleeps until the latch is released. Returns right away if the state
+      changed, in which case the caller retries.
+     */
+    void park(std::uint32_t state);
+    
+    void wakeAll();
+    
+    /*
+      Keeps the changes made by the exclusive holder from becoming visible
+      to optimistic readers before the latch is seen as held
+     */
+    static void exclusiveAcquired() {
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    
+    std::atomic<std::uint32_t> mState;
+    std::atomic<std::uint32_t> mVersion;
 };
 
+static_assert(sizeof(Latch) == 2 * sizeof(std::uint32_t),
+              "Latch must stay compact, since every node carries one");
+
 } }
 
 #endif
@@ -0,0 +1 @@
+#include "Lookup.hpp"
@@ -0,0 +1,43 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_LOOKUP_HPP
+#define _TUPL_PVT_LOOKUP_HPP
+
+#include "../types.hpp"
+#include "Buffer.hpp"
+
+namespace tupl { namespace pvt {
+
+/**
+   Key of a batch of lookups, along with the value found for it. Unlike a
+   Cursor, a lookup keeps no position once its value is found.
+   
+   @author Vishal Parakh
+ */
+struct Lookup final {
+    Lookup() : key(), value(), hasValue(false) {}
+    
+    explicit Lookup(const Bytes key) : key(key), value(), hasValue(false) {}
+    
+    Bytes  key;      // Owned by the caller
+    Buffer value;
+    bool   hasValue; // false if the key was not found
+};
+
+} }
+
+#endif
@@ -17,165 +17,2517 @@
 
 #include "Node.hpp"
 
+#include "KeyComparator.hpp"
+
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <stdexcept>
 
 using std::size_t;
 using std::pair;
 using std::make_pair;
 
-namespace tupl { namespace pvt { namespace disabled {
+namespace tupl { namespace pvt {
 
 namespace {
 
-template<typename V, typename T>
-class OffsetPointerGeneric {
+/*
+  Tree node header, see the node format at the bottom of Node.hpp
+ */
+const size_t TN_HEADER_SIZE = 12;
+
+const size_t TYPE_OFFSET             = 0;
+const size_t KEY_PREFIX_LEN_OFFSET   = 1;
+const size_t GARBAGE_OFFSET          = 2;
+const size_t LEFT_SEG_TAIL_OFFSET    = 4;
+const size_t RIGHT_SEG_TAIL_OFFSET   = 6;
+const size_t SEARCH_VEC_START_OFFSET = 8;
+const size_t SEARCH_VEC_END_OFFSET   = 10;
+
+Buffer copyOf(const Bytes bytes) {
+    return bytes.size() ? Buffer{bytes.data(), bytes.size()} : Buffer{};
+}
+
+size_t decodeUShortLE(const byte* const page, const size_t offset) {
+    return page[offset] | (page[offset + 1] << 8);
+}
+
+void encodeUShortLE(byte* const page, const size_t offset, const size_t value)
+{
+    assert(value <= 0xffff);
+    page[offset]     = static_cast<byte>(value);
+    page[offset + 1] = static_cast<byte>(value >> 8);
+}
+
+std::uint64_t decodeULongLE(const byte* const src) {
+    std::uint64_t value = 0;
+    
+    for (size_t i = 8; i-- > 0; ) { value = (value << 8) | src[i]; }
+    
+    return value;
+}
+
+void encodeULongLE(byte* const dst, std::uint64_t value) {
+    for (size_t i = 0; i < 8; ++i, value >>= 8) {
+        dst[i] = static_cast<byte>(value);
+    }
+}
+
+/*
+  Accessors for the header and search vector shared by all tree nodes
+ */
+class TreePage {
 public:
-    typedef T OffsetType;
-    typedef V ValueType;
+    TreePage(byte* const page, const size_t pageSize) :
+        mPage(page), mPageSize(pageSize) {}
+    
+    byte* data() const { return mPage; }
+    
+    size_t pageSize() const { return mPageSize; }
     
-    explicit OffsetPointerGeneric(T offset) : mOffset(offset) {}
+    size_t garbage() const { return decodeUShortLE(mPage, GARBAGE_OFFSET); }
     
-    const ValueType& withBase(const void* baseAddr) const {
-        const byte* const addr = static_cast<const byte*>(baseAddr) + mOffset;
-        return *static_cast<const ValueType*>(static_cast<const void*>(addr));
+    void garbage(const size_t bytes) {
+        encodeUShortLE(mPage, GARBAGE_OFFSET, bytes);
     }
     
-    OffsetType offset() const { return mOffset; }
+    size_t keyPrefixLength() const { return mPage[KEY_PREFIX_LEN_OFFSET]; }
     
-private:
-    static T encode(T native) { return native;  /* todo: !BigEndian */ }
-    static T decode(T encoded) { return encoded; /* todo: !BigEndian */ }
+    /*
+      Common leading bytes of the keys whose entries have the 'p' bit set,
+      stored at the start of the left segment
+     */
+    Bytes keyPrefix() const {
+        return Bytes{mPage + TN_HEADER_SIZE, keyPrefixLength()};
+    }
+    
+    /*
+      Stores the key prefix of an empty page, in front of the left segment
+     */
+    void keyPrefix(const Bytes prefix) {
+        assert(slots() == 0 && leftSegTail() == TN_HEADER_SIZE);
+        assert(prefix.size() <= 0xff);
+        
+        mPage[KEY_PREFIX_LEN_OFFSET] = static_cast<byte>(prefix.size());
+        
+        if (prefix.size()) {
+            std::memcpy(mPage + TN_HEADER_SIZE, prefix.data(), prefix.size());
+        }
+        
+        leftSegTail(TN_HEADER_SIZE + prefix.size());
+    }
     
-    T mOffset;
+    size_t leftSegTail() const {
+        return decodeUShortLE(mPage, LEFT_SEG_TAIL_OFFSET);
+    }
+    
+    void leftSegTail(const size_t loc) {
+        encodeUShortLE(mPage, LEFT_SEG_TAIL_OFFSET, loc);
+    }
+    
+    size_t rightSegTail() const {
+        return decodeUShortLE(mPage, RIGHT_SEG_TAIL_OFFSET);
+    }
+    
+    void rightSegTail(const size_t loc) {
+        encodeUShortLE(mPage, RIGHT_SEG_TAIL_OFFSET, loc);
+    }
+    
+    size_t searchVecStart() const {
+        return decodeUShortLE(mPage, SEARCH_VEC_START_OFFSET);
+    }
+    
+    void searchVecStart(const size_t loc) {
+        assert((loc & 1) == 0);
+        encodeUShortLE(mPage, SEARCH_VEC_START_OFFSET, loc);
+    }
+    
+    size_t searchVecEnd() const {
+        return decodeUShortLE(mPage, SEARCH_VEC_END_OFFSET);
+    }
+    
+    void searchVecEnd(const size_t loc) {
+        encodeUShortLE(mPage, SEARCH_VEC_END_OFFSET, loc);
+    }
+    
+    size_t slots() const {
+        return (searchVecEnd() + 2 - searchVecStart()) >> 1;
+    }
+    
+    size_t slot(const size_t pos) const {
+        return decodeUShortLE(mPage, searchVecStart() + (pos << 1));
+    }
+    
+    void slot(const size_t pos, const size_t loc) {
+        encodeUShortLE(mPage, searchVecStart() + (pos << 1), loc);
+    }
+    
+    /*
+      Free bytes surrounding the search vector, excluding garbage
+     */
+    size_t freeBytes() const {
+        return searchVecStart() - leftSegTail() +
+            rightSegTail() - searchVecEnd() - 1;
+    }
+    
+    void init(const Node::Type type) {
+        mPage[TYPE_OFFSET] = static_cast<byte>(type);
+        mPage[KEY_PREFIX_LEN_OFFSET] = 0;
+        
+        garbage(0);
+        leftSegTail(TN_HEADER_SIZE);
+        rightSegTail(mPageSize - 1);
+        
+        // Search vector location must be even.
+        const size_t start =
+            (TN_HEADER_SIZE + ((mPageSize - TN_HEADER_SIZE) >> 1)) & ~1;
+        
+        searchVecStart(start);
+        searchVecEnd(start - 2); // inclusive
+    }
+    
+private:
+    byte* const mPage;
+    const size_t mPageSize;
 };
 
-class EmbeddedValue {
+/*
+  Fills an empty page with entries appended in key order. All the entries
+  are allocated in the left segment, and the search vector is placed in the
+  middle of the remaining free space. Internal nodes extend the search vector
+  with the child identifiers, and leaf nodes can have a key prefix in front of
+  the entries, which must be included in entryBytes.
+ */
+class TreePageBuilder {
 public:
-    const Bytes value() const { return Bytes{nullptr, 0}; }
+    TreePageBuilder(TreePage page, const Node::Type type,
+                    const size_t count, const size_t entryBytes,
+                    const size_t extensionBytes = 0,
+                    const Bytes keyPrefix = Bytes{}) :
+        mPage(page), mPos(0), mTail(TN_HEADER_SIZE + keyPrefix.size())
+    {
+        const size_t blockLen = (count << 1) + extensionBytes;
+        
+        assert(TN_HEADER_SIZE + entryBytes + blockLen <= page.pageSize());
+        
+        const size_t free =
+            page.pageSize() - TN_HEADER_SIZE - entryBytes - blockLen;
+        
+        const size_t start = (TN_HEADER_SIZE + entryBytes + (free >> 1) + 1)
+            & ~1;
+        
+        mPage.init(type);
+        mPage.keyPrefix(keyPrefix);
+        mPage.searchVecStart(start);
+        mPage.searchVecEnd(start + (count << 1) - 2);
+    }
+    
+    byte* append(const size_t entryLen) {
+        const size_t loc = mTail;
+        
+        mPage.slot(mPos++, loc);
+        mTail += entryLen;
+        mPage.leftSegTail(mTail);
+        
+        return mPage.data() + loc;
+    }
+    
+private:
+    TreePage mPage;
+    size_t mPos;
+    size_t mTail;
 };
 
-typedef OffsetPointerGeneric<EmbeddedValue, uint16_t> KeyOffsetPtr;
+const size_t MAX_PAGE_SIZE = 65536;
 
-class SearchVector {
-public:
-    const KeyOffsetPtr* begin() const { return nullptr; }
-    const KeyOffsetPtr* end() const   { return nullptr; }
-private:
+/*
+  Returns a page owned by the calling thread, which holds a copy of a node
+  page while it's being compacted, or a page being built by a split or a
+  rebuild before it's copied over the node page. It's allocated once per
+  thread, so these don't allocate.
+ */
+byte* scratchPage() {
+    static thread_local std::unique_ptr<byte[]> page(new byte[MAX_PAGE_SIZE]);
+    return page.get();
+}
+
+/*
+  Cache lines are assumed to be 64 bytes, which is the common size
+ */
+const size_t CACHE_LINE_SIZE = 64;
+
+/*
+  Starts loading length bytes at address into the cache, without waiting for
+  them to arrive. Nothing is loaded by compilers without a prefetch builtin.
+ */
+void prefetch(const byte* const address, const size_t length) {
+#if defined(__GNUC__)
+    for (size_t offset = 0; offset < length; offset += CACHE_LINE_SIZE) {
+        __builtin_prefetch(address + offset);
+    }
+#else
+    (void) address;
+    (void) length;
+#endif
+}
+
+/*
+  Prefetches the search vector of a page, followed by idSize bytes per child
+  of an internal node. The page can be changing while it's read, so nothing
+  is prefetched if the header doesn't locate it within the page.
+ */
+void prefetchSearchVec(const TreePage& page, const size_t idSize) {
+    const size_t start = page.searchVecStart();
+    const size_t end = page.searchVecEnd() + 2; // exclusive
     
-};
+    if (start < TN_HEADER_SIZE || end < start || end > page.pageSize()) {
+        return;
+    }
+    
+    const size_t length = (end - start) + ((end - start) / 2 + 1) * idSize;
+    
+    prefetch(page.data() + start, std::min(length, page.pageSize() - start));
+}
 
-class BottomInternalNode {
-public:
-    SearchVector searchVec() const { return SearchVector(); }
-};
+/*---------------------------------------------------------------------------*/
+// Leaf entry encoding 
+/*---------------------------------------------------------------------------*/
 
-class KeyComparator {
-public:
-    class State {
-    public:
-        State(const BottomInternalNode* n) :
-            node(n), hiPrefixSize(0), loPrefixSize(0), mEqual(false) {}
+const size_t MAX_KEY_SIZE = 16383;
+const size_t MAX_KEY_PREFIX_SIZE = 255;
+const byte KEY_PREFIX_BIT = 0x40;
+const size_t MAX_SMALL_KEY_SIZE = 64;
+const size_t MAX_SMALL_VALUE_SIZE = 127;
+const size_t MAX_MEDIUM_VALUE_SIZE = 8192;
 
-        bool equal() const { return mEqual; }
-        
-    private:
-        Bytes extractBytes(const KeyOffsetPtr& offsetPtr) const {
-            return offsetPtr.withBase(node).value();
-        }
+size_t encodedKeyLength(const size_t keyLen) {
+    return keyLen > 0 && keyLen <= MAX_SMALL_KEY_SIZE ?
+        1 + keyLen : 2 + keyLen;
+}
 
-        // FIXME: Specialize Node comparator and remove from KeyComparator
-        const BottomInternalNode* const node;
-        
-        size_t hiPrefixSize;
-        size_t loPrefixSize;
+size_t encodedValueLength(const size_t valueLen) {
+    if (valueLen <= MAX_SMALL_VALUE_SIZE) { return 1 + valueLen; }
+    if (valueLen <= MAX_MEDIUM_VALUE_SIZE) { return 2 + valueLen; }
+    return 3 + valueLen;
+}
+
+/*
+  Fragmented values are encoded as their length followed by the identifier of
+  their first fragment, and the 'f' bit is set in the value header
+ */
+const byte FRAGMENTED_VALUE_BIT = 0x40;
+const size_t FRAGMENTED_VALUE_SIZE = 16;
+
+/*
+  Ghosts are entries whose value was deleted, and which are kept until they are
+  removed in bulk, so that deleting doesn't shift the search vector
+ */
+const byte GHOST_VALUE = 0xff;
+
+size_t encodedLeafValueLength(const LeafValue& value) {
+    if (value.isGhost()) { return 1; }
+    
+    return value.isFragmented() ? 2 + FRAGMENTED_VALUE_SIZE :
+        encodedValueLength(value.bytes().size());
+}
+
+/*
+  Indirect keys encode a length which inline keys never reach, followed by
+  their inline length, their full length and their first fragment
+ */
+const size_t INDIRECT_KEY_LENGTH = 16383;
+const size_t INDIRECT_KEY_HEADER_SIZE = 20;
+
+const size_t INDIRECT_KEY_INLINE_LEN_OFFSET = 2;
+const size_t INDIRECT_KEY_LEN_OFFSET        = 4;
+const size_t INDIRECT_KEY_FRAGMENTS_OFFSET  = 12;
+
+bool isIndirectKey(const byte* const entry) {
+    return entry[0] == (0x80 | (INDIRECT_KEY_LENGTH >> 8)) &&
+        entry[1] == static_cast<byte>(INDIRECT_KEY_LENGTH);
+}
+
+/*
+  Number of leading bytes kept in the entry of an indirect key
+ */
+size_t indirectInlineLength(const size_t capacity, const size_t keyLen) {
+    return std::min(keyLen, capacity / 16);
+}
+
+/*
+  Returns the key contents, which are only the leading bytes of an indirect
+  key
+ */
+Bytes decodeKey(const byte* const entry) {
+    const byte header = entry[0];
+    
+    if (header < 0x80) {
+        return Bytes{entry + 1, static_cast<size_t>((header & 0x3f) + 1)};
+    }
+    
+    if (isIndirectKey(entry)) {
+        return Bytes{entry + INDIRECT_KEY_HEADER_SIZE,
+                     decodeUShortLE(entry, INDIRECT_KEY_INLINE_LEN_OFFSET)};
+    }
+    
+    return Bytes{entry + 2,
+            static_cast<size_t>(((header & 0x3f) << 8) | entry[1])};
+}
+
+std::uint64_t indirectKeyLength(const byte* const entry) {
+    return decodeULongLE(entry + INDIRECT_KEY_LEN_OFFSET);
+}
+
+FragmentNode* indirectKeyFragments(const byte* const entry) {
+    const std::uint64_t id =
+        decodeULongLE(entry + INDIRECT_KEY_FRAGMENTS_OFFSET);
+    
+    return reinterpret_cast<FragmentNode*>(static_cast<std::uintptr_t>(id));
+}
+
+/*
+  Copies the whole key of an indirect key entry out of its fragments
+ */
+Buffer indirectKeyBytes(const byte* const entry) {
+    Buffer key;
+    key.reserve(indirectKeyLength(entry));
+    
+    for (const FragmentNode* node = indirectKeyFragments(entry); node;
+         node = node->next())
+    {
+        const Bytes part = node->data();
+        key.append(part.data(), part.data() + part.size());
+    }
+    
+    return key;
+}
+
+/*
+  Compares a key stored in fragments against the search key, skipping the
+  first `from` bytes which are known to be equal. Returns the result as for
+  KeyComparator::compare, and the number of leading bytes the keys share.
+ */
+pair<int, size_t> compareFragmented(
+    const FragmentNode* node, const std::uint64_t length, const Bytes key,
+    size_t from)
+{
+    for (size_t offset = 0; node && from < key.size(); node = node->next()) {
+        const Bytes part = node->data();
+        const size_t end = std::min(offset + part.size(), key.size());
         
-        bool   mEqual;
+        if (end > from) {
+            const byte* const keyData = key.data();
+            const auto mismatch = std::mismatch(
+                keyData + from, keyData + end, part.data() + (from - offset));
+            
+            if (mismatch.first != keyData + end) {
+                return make_pair(*mismatch.second < *mismatch.first ? -1 : 1,
+                                 static_cast<size_t>(mismatch.first - keyData));
+            }
+            
+            from = end;
+        }
         
-        friend class KeyComparator;
-    };
+        offset += part.size();
+    }
+    
+    const int result = length < key.size() ? -1 :
+        (length > key.size() ? 1 : 0);
+    return make_pair(result, static_cast<size_t>(
+                         std::min<std::uint64_t>(length, key.size())));
+}
+
+/*
+  Returns the encoded value and the location just past it. The value of a ghost
+  is null.
+ */
+pair<Bytes, const byte*> decodeValue(const byte* const entry) {
+    const byte header = entry[0];
+    
+    if (header == GHOST_VALUE) { return make_pair(Bytes{}, entry + 1); }
+    
+    if (header < 0x80) {
+        return make_pair(Bytes{entry + 1, header}, entry + 1 + header);
+    }
+    
+    size_t len;
+    const byte* data;
     
-    explicit KeyComparator(State& state) : mState(state) {}
-   
-    bool operator()(const Bytes& l, const KeyOffsetPtr& rPtr) {
-        return compareLower(l, mState.extractBytes(rPtr), mState);
+    if ((header & 0x20) == 0) {
+        len = (((header & 0x1f) << 8) | entry[1]) + 1;
+        data = entry + 2;
+    } else {
+        len = (((header & 0x0f) << 16) | (entry[1] << 8) | entry[2]) + 1;
+        data = entry + 3;
     }
     
-    bool operator()(const KeyOffsetPtr& lPtr, const Bytes& r) {
-        return compareLower(mState.extractBytes(lPtr), r, mState);
+    return make_pair(Bytes{data, len}, data + len);
+}
+
+bool isFragmentedValue(const byte* const valueEntry) {
+    const byte header = valueEntry[0];
+    return header >= 0x80 && header != GHOST_VALUE &&
+        (header & FRAGMENTED_VALUE_BIT) != 0;
+}
+
+LeafValue decodeLeafValue(const byte* const valueEntry) {
+    const Bytes value = decodeValue(valueEntry).first;
+    
+    if (!isFragmentedValue(valueEntry)) { return LeafValue(value); }
+    
+    const std::uint64_t first = decodeULongLE(value.data() + 8);
+    
+    return LeafValue(decodeULongLE(value.data()),
+                     *reinterpret_cast<FragmentNode*>(
+                         static_cast<std::uintptr_t>(first)));
+}
+
+const byte* valueStart(const byte* const entry) {
+    const Bytes key = decodeKey(entry);
+    return key.data() + key.size();
+}
+
+size_t leafEntryLength(const byte* const entry) {
+    return decodeValue(valueStart(entry)).second - entry;
+}
+
+bool hasKeyPrefix(const byte* const entry) {
+    return (entry[0] & KEY_PREFIX_BIT) != 0;
+}
+
+/*
+  Encodes the key header, setting the 'p' bit if the key contents which follow
+  exclude the node key prefix. Returns the location of the key contents.
+ */
+byte* encodeKeyHeader(byte* dst, const size_t len, const bool prefixed) {
+    const byte pBit = prefixed ? KEY_PREFIX_BIT : 0;
+    
+    if (len > 0 && len <= MAX_SMALL_KEY_SIZE) {
+        *dst++ = static_cast<byte>(pBit | (len - 1));
+    } else {
+        *dst++ = static_cast<byte>(0x80 | pBit | (len >> 8));
+        *dst++ = static_cast<byte>(len);
     }
+    
+    return dst;
+}
+
+byte* encodeKey(byte* dst, const Bytes key, const bool prefixed = false) {
+    const size_t len = key.size();
+    
+    dst = encodeKeyHeader(dst, len, prefixed);
+    
+    std::memmove(dst, key.data(), len);
+    return dst + len;
+}
 
-    bool operator()(const Bytes& l, const Bytes& r) {
-        State scratch(0);
-        return compareLower(l, r, scratch);
+byte* encodeIndirectKey(byte* const dst, const NodeKey& key,
+                        const size_t capacity)
+{
+    const Bytes bytes = key.bytes();
+    const size_t inlineLen = indirectInlineLength(capacity, bytes.size());
+    
+    encodeKeyHeader(dst, INDIRECT_KEY_LENGTH, false);
+    encodeUShortLE(dst, INDIRECT_KEY_INLINE_LEN_OFFSET, inlineLen);
+    encodeULongLE(dst + INDIRECT_KEY_LEN_OFFSET, bytes.size());
+    encodeULongLE(dst + INDIRECT_KEY_FRAGMENTS_OFFSET,
+                  reinterpret_cast<std::uintptr_t>(key.fragments()));
+    
+    std::memcpy(dst + INDIRECT_KEY_HEADER_SIZE, bytes.data(), inlineLen);
+    return dst + INDIRECT_KEY_HEADER_SIZE + inlineLen;
+}
+
+byte* encodeValue(byte* dst, const Bytes value) {
+    const size_t len = value.size();
+    
+    if (len <= MAX_SMALL_VALUE_SIZE) {
+        *dst++ = static_cast<byte>(len);
+    } else if (len <= MAX_MEDIUM_VALUE_SIZE) {
+        *dst++ = static_cast<byte>(0x80 | ((len - 1) >> 8));
+        *dst++ = static_cast<byte>(len - 1);
+    } else {
+        *dst++ = static_cast<byte>(0xa0 | ((len - 1) >> 16));
+        *dst++ = static_cast<byte>((len - 1) >> 8);
+        *dst++ = static_cast<byte>(len - 1);
     }
     
-    static bool compareLower(const Bytes& l, const Bytes& r, State& st) {
-        const byte* const lPtr = l.data();
-        const byte* const rPtr = r.data();
-        
-        const size_t cmpSize = std::min(l.size(), r.size());
-        const size_t prefixSize = std::min(st.loPrefixSize, st.hiPrefixSize);
+    std::memmove(dst, value.data(), len);
+    return dst + len;
+}
 
-        assert(prefixSize < cmpSize);
+byte* encodeLeafValue(byte* dst, const LeafValue& value) {
+    if (value.isGhost()) {
+        *dst++ = GHOST_VALUE;
+        return dst;
+    }
+    
+    if (!value.isFragmented()) { return encodeValue(dst, value.bytes()); }
+    
+    *dst++ = static_cast<byte>(0x80 | FRAGMENTED_VALUE_BIT |
+                               ((FRAGMENTED_VALUE_SIZE - 1) >> 8));
+    *dst++ = static_cast<byte>(FRAGMENTED_VALUE_SIZE - 1);
+    
+    encodeULongLE(dst, value.length());
+    encodeULongLE(dst + 8, reinterpret_cast<std::uintptr_t>(value.first()));
+    
+    return dst + FRAGMENTED_VALUE_SIZE;
+}
+
+/*
+  Compares as unsigned bytes, shorter keys sort before longer keys that they
+  are a prefix of.
+ */
+int compareKeys(const Bytes l, const Bytes r) {
+    const size_t cmpSize = std::min(l.size(), r.size());
+    const int result = cmpSize ? std::memcmp(l.data(), r.data(), cmpSize) : 0;
+    
+    if (result != 0) { return result; }
+    
+    return l.size() < r.size() ? -1 : (l.size() > r.size() ? 1 : 0);
+}
+
+bool startsWith(const Bytes key, const Bytes prefix) {
+    return prefix.size() == 0 || (key.size() >= prefix.size() &&
+        std::memcmp(key.data(), prefix.data(), prefix.size()) == 0);
+}
+
+/*
+  Key of a leaf entry, which is split in two when the entry excludes the node
+  key prefix
+ */
+struct EntryKey {
+    Bytes prefix;
+    Bytes suffix;
+    
+    size_t size() const { return prefix.size() + suffix.size(); }
+    
+    byte at(const size_t i) const {
+        return i < prefix.size() ?
+            prefix.data()[i] : suffix.data()[i - prefix.size()];
+    }
+    
+    bool startsWith(const Bytes other) const {
+        if (other.size() > size()) { return false; }
         
-        const auto mismatched = std::mismatch(
-            lPtr + prefixSize, lPtr + cmpSize, rPtr + prefixSize);
+        for (size_t i = 0; i < other.size(); ++i) {
+            if (at(i) != other.data()[i]) { return false; }
+        }
         
-        if (mismatched.first == (lPtr + cmpSize)) {
-            // No mismatch, is lower if size is lower
-            if (l.size() == r.size()) { st.mEqual = true; }
-            return l.size() < r.size(); // => "ab" < "abc"
-        } else if (*mismatched.first < *mismatched.second) {
-            st.loPrefixSize = mismatched.first - lPtr;
-            return true; // => "abb" < "abc"
+        return true;
+    }
+    
+    /*
+      Copies the key contents, skipping the first `from` bytes
+     */
+    byte* copyTo(byte* dst, size_t from) const {
+        if (from < prefix.size()) {
+            const size_t len = prefix.size() - from;
+            std::memcpy(dst, prefix.data() + from, len);
+            dst += len;
+            from = 0;
         } else {
-            st.hiPrefixSize = mismatched.first - lPtr;
-            return false; // => !("abc" < "abb")
-        }   
+            from -= prefix.size();
+        }
+        
+        const size_t len = suffix.size() - from;
+        
+        if (len) { std::memcpy(dst, suffix.data() + from, len); }
+        
+        return dst + len;
     }
     
-private:
-    State& mState;
+    Buffer toBuffer() const {
+        Buffer result(size(), 0);
+        
+        if (!result.empty()) { copyTo(&result[0], 0); }
+        
+        return result;
+    }
 };
 
-/**
-   Returns a pair whose:
-   
-   .first => a pointer first element in the range [begin, end) that is not less
-   than (i.e. greater or equal to) value.
-   
-   .second => true if an exact match was found
+EntryKey entryKey(const TreePage& page, const byte* const entry) {
+    return EntryKey{hasKeyPrefix(entry) ? page.keyPrefix() : Bytes{},
+                    decodeKey(entry)};
+}
+
+/*
+  Returns the key contents to store for a new entry, and true if they exclude
+  the node key prefix
  */
-pair<const KeyOffsetPtr*, bool> lowerBound(
-    const BottomInternalNode* node,
-    const KeyOffsetPtr* begin, const KeyOffsetPtr* end, const Bytes key)
-{
-    // TODO: These should be part of a standard verification utility
-    assert(node && begin && end && key.data() && key.size());
-    assert(begin < end);
-    assert(begin >= node->searchVec().begin());
-    assert(end   <= node->searchVec().end());
+pair<Bytes, bool> storedKey(const TreePage& page, const Bytes key) {
+    const Bytes prefix = page.keyPrefix();
     
-    KeyComparator::State comparatorState(node);
-    KeyComparator comparator(comparatorState);
+    if (prefix.size() == 0 || !startsWith(key, prefix)) {
+        return make_pair(key, false);
+    }
     
-    return make_pair(std::lower_bound(begin, end, key, comparator),
-                     comparatorState.equal());
+    return make_pair(Bytes{key.data() + prefix.size(),
+                           key.size() - prefix.size()}, true);
 }
 
-} } } // namespace tupl::pvt::(anonymous)
+size_t commonPrefixLength(const EntryKey& l, const EntryKey& r) {
+    const size_t maxLen = std::min(l.size(), r.size());
+    
+    size_t len = 0;
+    while (len < maxLen && l.at(len) == r.at(len)) { ++len; }
+    
+    return len;
+}
 
-namespace tupl { namespace pvt {
+/*
+  Compares the key of an entry which doesn't exclude the node key prefix.
+  The fragments of an indirect key are only read if its leading bytes are
+  all equal to those of the search key.
+ */
+int compareEntry(KeyComparator& comparator, const byte* const entry) {
+    const Bytes nodeKey = decodeKey(entry);
+    
+    if (!isIndirectKey(entry) || !startsWith(comparator.key(), nodeKey)) {
+        return comparator.compare(nodeKey);
+    }
+    
+    const auto result =
+        compareFragmented(indirectKeyFragments(entry),
+                          indirectKeyLength(entry), comparator.key(),
+                          nodeKey.size());
+    
+    comparator.record(result.first, result.second);
+    return result.first;
+}
+
+/*
+  Returns the hint of the key of an entry which doesn't exclude the node key
+  prefix. The leading bytes of an indirect key usually cover the hint.
+ */
+std::uint32_t entryHint(const KeyHints& hints, const byte* const entry) {
+    const Bytes key = decodeKey(entry);
+    
+    if (isIndirectKey(entry) && key.size() < hints.prefix().size() + 4) {
+        return hints.hint(indirectKeyBytes(entry));
+    }
+    
+    return hints.hint(key);
+}
+
+/*
+  Returns the length of the encoded key, for a key which is stored in full
+ */
+size_t encodedNodeKeyLength(const size_t capacity, const NodeKey& key) {
+    const size_t keyLen = key.bytes().size();
+    
+    if (key.isIndirect()) {
+        assert(!keyFitsInline(keyLen, capacity + TN_HEADER_SIZE));
+        return INDIRECT_KEY_HEADER_SIZE +
+            indirectInlineLength(capacity, keyLen);
+    }
+    
+    if (keyLen > MAX_KEY_SIZE) { throw std::invalid_argument("key too big"); }
+    
+    return encodedKeyLength(keyLen);
+}
+
+size_t keyEntryLength(const byte* const entry) {
+    return valueStart(entry) - entry;
+}
+
+size_t verifiedKeyEntrySize(const size_t capacity, const NodeKey& key) {
+    const size_t entryLen = encodedNodeKeyLength(capacity, key);
+    
+    if (entryLen > capacity / 4) { throw std::invalid_argument("key too big"); }
+    
+    return entryLen;
+}
+
+size_t verifiedLeafEntrySize(
+    const size_t capacity, const size_t keyEntryLen, const LeafValue& value)
+{
+    const size_t entryLen = keyEntryLen + encodedLeafValueLength(value);
+    
+    // ensures that a split always produces siblings which fit their entries
+    if (entryLen > capacity / 4) {
+        throw std::invalid_argument("entry too big");
+    }
+    
+    return entryLen;
+}
+
+/*---------------------------------------------------------------------------*/
+// Internal node child identifiers
+/*---------------------------------------------------------------------------*/
+
+/*
+  Identifiers are 6 bytes unless the node type has the wide ids bit set, in
+  which case they are 8 bytes. Narrow identifiers are used whenever all the
+  children of a node fit them.
+ */
+const size_t NARROW_CHILD_ID_SIZE = 6;
+const size_t WIDE_CHILD_ID_SIZE = 8;
+const byte WIDE_CHILD_IDS_BIT = 0x04;
+
+size_t childIdSize(const TreePage& page) {
+    return (page.data()[TYPE_OFFSET] & WIDE_CHILD_IDS_BIT) ?
+        WIDE_CHILD_ID_SIZE : NARROW_CHILD_ID_SIZE;
+}
+
+void childIdSize(TreePage page, const size_t idSize) {
+    byte& type = page.data()[TYPE_OFFSET];
+    
+    type = idSize == WIDE_CHILD_ID_SIZE ?
+        (type | WIDE_CHILD_IDS_BIT) : (type & ~WIDE_CHILD_IDS_BIT);
+}
+
+bool fitsNarrowChildId(const Node* const child) {
+    const std::uint64_t id = reinterpret_cast<std::uintptr_t>(child);
+    return (id >> (NARROW_CHILD_ID_SIZE * 8)) == 0;
+}
+
+size_t childIdsStart(const TreePage& page) {
+    return page.searchVecEnd() + 2;
+}
+
+Node* decodeChildId(const byte* const src, const size_t idSize) {
+    std::uint64_t id = 0;
+    
+    for (size_t i = idSize; i-- > 0; ) { id = (id << 8) | src[i]; }
+    
+    return reinterpret_cast<Node*>(static_cast<std::uintptr_t>(id));
+}
+
+void encodeChildId(byte* const dst, const Node* const child,
+                   const size_t idSize)
+{
+    std::uint64_t id = reinterpret_cast<std::uintptr_t>(child);
+    
+    assert(idSize == WIDE_CHILD_ID_SIZE || fitsNarrowChildId(child));
+    
+    for (size_t i = 0; i < idSize; ++i, id >>= 8) {
+        dst[i] = static_cast<byte>(id);
+    }
+}
+
+Node::Type internalType(const Node& child) {
+    return child.isLeaf() ? Node::Type::TN_BIN : Node::Type::TN_IN;
+}
+
+} // namespace tupl::pvt::(anonymous)
+
+Buffer shortestSeparator(const Bytes low, const Bytes high) {
+    assert(compareKeys(low, high) < 0);
+    
+    const size_t maxLen = std::min(low.size(), high.size());
+    
+    size_t len = 0;
+    while (len < maxLen && low.data()[len] == high.data()[len]) { ++len; }
+    
+    // high is longer than the common prefix, because it's greater than low
+    return Buffer{high.data(), len + 1};
+}
+
+bool keyFitsInline(const size_t keyLen, const size_t pageSize) {
+    // Leaves a fragmented value room in an entry with the longest key
+    return encodedKeyLength(keyLen) <= (pageSize - TN_HEADER_SIZE) / 8;
+}
+
+size_t maxKeyEntrySize(const size_t pageSize) {
+    const size_t capacity = pageSize - TN_HEADER_SIZE;
+    
+    return std::max(capacity / 8, INDIRECT_KEY_HEADER_SIZE +
+                    indirectInlineLength(capacity, capacity));
+}
+
+/*---------------------------------------------------------------------------*/
+// FragmentNode implementation
+/*---------------------------------------------------------------------------*/
+
+namespace {
+
+/*
+  Fragment node header, see the node format at the bottom of Node.hpp
+ */
+const size_t FRAGMENT_HEADER_SIZE = 12;
+
+const size_t FRAGMENT_LENGTH_OFFSET = 2;
+const size_t FRAGMENT_NEXT_OFFSET   = 4;
+
+}
+
+FragmentNode::FragmentNode(const size_t pageSize) :
+    Node(Type::FRAGMENT), mPageSize(pageSize), mPage(new byte[pageSize])
+{
+    assert(pageSize <= MAX_PAGE_SIZE && pageSize > FRAGMENT_HEADER_SIZE);
+    assign(Bytes{}, nullptr);
+}
+
+size_t FragmentNode::capacity() const {
+    return mPageSize - FRAGMENT_HEADER_SIZE;
+}
+
+Bytes FragmentNode::data() const {
+    return Bytes{mPage.get() + FRAGMENT_HEADER_SIZE,
+                 decodeUShortLE(mPage.get(), FRAGMENT_LENGTH_OFFSET)};
+}
+
+FragmentNode* FragmentNode::next() const {
+    const std::uint64_t id =
+        decodeULongLE(mPage.get() + FRAGMENT_NEXT_OFFSET);
+    
+    return reinterpret_cast<FragmentNode*>(static_cast<std::uintptr_t>(id));
+}
+
+void FragmentNode::assign(const Bytes data, FragmentNode* const next) {
+    assert(data.size() <= capacity());
+    
+    byte* const page = mPage.get();
+    
+    page[TYPE_OFFSET] = static_cast<byte>(Type::FRAGMENT);
+    page[TYPE_OFFSET + 1] = 0;
+    
+    encodeUShortLE(page, FRAGMENT_LENGTH_OFFSET, data.size());
+    encodeULongLE(page + FRAGMENT_NEXT_OFFSET,
+                  reinterpret_cast<std::uintptr_t>(next));
+    
+    if (data.size()) {
+        std::memcpy(page + FRAGMENT_HEADER_SIZE, data.data(), data.size());
+    }
+}
+
+void LeafValue::appendTo(Buffer& dst) const {
+    if (!isFragmented()) {
+        if (mBytes.size()) {
+            dst.append(mBytes.data(), mBytes.data() + mBytes.size());
+        }
+        
+        return;
+    }
+    
+    dst.reserve(dst.size() + mLength);
+    
+    for (const FragmentNode* node = mFirst; node; node = node->next()) {
+        const Bytes part = node->data();
+        dst.append(part.data(), part.data() + part.size());
+    }
+    
+    assert(dst.size() >= mLength);
+}
+
+/*---------------------------------------------------------------------------*/
+// LeafNode implementation
+/*---------------------------------------------------------------------------*/
+LeafNode::LeafNode(const size_t pageSize) :
+    Node(Type::TN_LEAF), mPageSize(pageSize), mPage(new byte[pageSize]),
+    mEdgeInserts(0), mGhosts(0)
+{
+    assert(pageSize <= MAX_PAGE_SIZE && (pageSize & 1) == 0);
+    clearEntries();
+}
+
+void LeafNode::clearEntries() {
+    TreePage(mPage.get(), mPageSize).init(Type::TN_LEAF);
+    mHints.reset(Bytes{});
+    mEdgeInserts = 0;
+    mGhosts = 0;
+}
+
+void LeafNode::rebuildHints() {
+    const TreePage page(mPage.get(), mPageSize);
+    mHints.reset(page.keyPrefix());
+    
+    for (size_t pos = 0; pos < page.slots(); ++pos) {
+        const byte* const entry = page.data() + page.slot(pos);
+        
+        mHints.append(hasKeyPrefix(entry) ?
+                      KeyHints::hintAfterPrefix(decodeKey(entry)) :
+                      entryHint(mHints, entry));
+    }
+}
+
+size_t LeafNode::size() const {
+    return TreePage(mPage.get(), mPageSize).slots();
+}
+
+size_t LeafNode::capacity() const {
+    return mPageSize - TN_HEADER_SIZE;
+}
+
+size_t LeafNode::availableBytes() const {
+    const TreePage page(mPage.get(), mPageSize);
+    return page.garbage() + page.freeBytes();
+}
+
+Buffer LeafNode::key(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    const byte* const entry = page.data() + page.slot(pos);
+    
+    return isIndirectKey(entry) ?
+        indirectKeyBytes(entry) : entryKey(page, entry).toBuffer();
+}
+
+Bytes LeafNode::keyPrefix() const {
+    return TreePage(mPage.get(), mPageSize).keyPrefix();
+}
+
+void LeafNode::keyPrefix(const Bytes prefix) {
+    if (!empty()) { throw std::logic_error("node is not empty"); }
+    
+    if (prefix.size() > maxKeyPrefixSize()) {
+        throw std::invalid_argument("key prefix too big");
+    }
+    
+    clearEntries();
+    TreePage(mPage.get(), mPageSize).keyPrefix(prefix);
+    mHints.reset(prefix);
+}
+
+size_t LeafNode::maxKeyPrefixSize() const {
+    return std::min(MAX_KEY_PREFIX_SIZE, capacity() / 16);
+}
+
+std::ptrdiff_t LeafNode::keyPrefixSavings() const {
+    const TreePage page(mPage.get(), mPageSize);
+    const size_t prefixLen = page.keyPrefixLength();
+    
+    std::ptrdiff_t saved = -static_cast<std::ptrdiff_t>(prefixLen);
+    
+    for (size_t pos = 0; pos < page.slots(); ++pos) {
+        const byte* const entry = page.data() + page.slot(pos);
+        
+        if (hasKeyPrefix(entry)) {
+            const size_t storedLen = decodeKey(entry).size();
+            
+            saved += encodedKeyLength(storedLen + prefixLen) -
+                encodedKeyLength(storedLen);
+        }
+    }
+    
+    return saved;
+}
+
+Bytes LeafNode::value(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    const byte* const valueEntry = valueStart(page.data() + page.slot(pos));
+    assert(!isFragmentedValue(valueEntry));
+    
+    return decodeValue(valueEntry).first;
+}
+
+LeafValue LeafNode::leafValue(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    return decodeLeafValue(valueStart(page.data() + page.slot(pos)));
+}
+
+bool LeafNode::fitsInline(const size_t keyLen, const size_t valueLen) const {
+    const size_t encodedKeyLen = keyFitsInline(keyLen, mPageSize) ?
+        encodedKeyLength(keyLen) :
+        INDIRECT_KEY_HEADER_SIZE + indirectInlineLength(capacity(), keyLen);
+    
+    return encodedKeyLen + encodedValueLength(valueLen) <= capacity() / 4;
+}
+
+void LeafNode::prefetchHeader() const {
+    prefetch(mPage.get(), TN_HEADER_SIZE);
+}
+
+void LeafNode::prefetchSearchVector() const {
+    prefetchSearchVec(TreePage(mPage.get(), mPageSize), 0);
+}
+
+pair<size_t, bool> LeafNode::lowerBound(const Bytes key) const {
+    const TreePage page(mPage.get(), mPageSize);
+    const size_t prefixLen = page.keyPrefixLength();
+    
+    // Entries with the 'p' bit set exclude the node key prefix. If the key
+    // doesn't start with it, then all of those entries order the same way
+    // against the key, and share the same leading bytes with it.
+    const bool keyHasPrefix = startsWith(key, page.keyPrefix());
+    
+    int prefixedOrder = 0;
+    size_t prefixedCommonSize = prefixLen;
+    
+    if (!keyHasPrefix) {
+        const Bytes prefix = page.keyPrefix();
+        
+        const size_t maxCommonSize = std::min(prefixLen, key.size());
+        
+        prefixedCommonSize = 0;
+        
+        while (prefixedCommonSize < maxCommonSize &&
+               prefix.data()[prefixedCommonSize] ==
+               key.data()[prefixedCommonSize])
+        {
+            ++prefixedCommonSize;
+        }
+        
+        prefixedOrder = compareKeys(prefix, key);
+    }
+    
+    // Only the entries having the same hint as the key need to be compared
+    const auto range = mHints.range(mHints.hint(key));
+    
+    KeyComparator comparator(key);
+    
+    return comparator.lowerBound(
+        range.first, range.second, [&](const size_t pos)
+    {
+        const byte* const entry = page.data() + page.slot(pos);
+        
+        if (!hasKeyPrefix(entry)) { return compareEntry(comparator, entry); }
+        
+        if (keyHasPrefix) {
+            return comparator.compare(decodeKey(entry), prefixLen);
+        }
+        
+        comparator.record(prefixedOrder, prefixedCommonSize);
+        return prefixedOrder;
+    });
+}
+
+LeafNode::Iterator LeafNode::find(const Bytes key) const {
+    const auto result = lowerBound(key);
+    return iteratorAt(result.second ? result.first : size());
+}
+
+InsertResult LeafNode::insert(const NodeKey& key, const LeafValue& value) {
+    const auto result = lowerBound(key.bytes());
+    
+    if (result.second) {
+        throw std::invalid_argument("duplicate key not allowed");
+    }
+    
+    return insert(result.first, key, value);
+}
+
+InsertResult LeafNode::insert(
+    const size_t pos, const NodeKey& key, const LeafValue& value)
+{
+    const size_t keyLen = encodedNodeKeyLength(capacity(), key);
+    verifiedLeafEntrySize(capacity(), keyLen, value);
+    
+    // Indirect keys never exclude the node key prefix
+    const auto stored = key.isIndirect() ? make_pair(key.bytes(), false) :
+        storedKey(TreePage(mPage.get(), mPageSize), key.bytes());
+    const size_t entryLen = encodedLeafValueLength(value) +
+        (key.isIndirect() ? keyLen : encodedKeyLength(stored.first.size()));
+    
+    size_t loc = allocEntry(pos, entryLen, true);
+    
+    if (loc == 0) {
+        // Reclaim the garbage before resorting to a split
+        if (availableBytes() < entryLen + 2) {
+            return InsertResult::FAILED_NO_SPACE;
+        }
+        
+        compact(size(), Bytes{});
+        loc = allocEntry(pos, entryLen, true);
+        assert(loc != 0);
+    }
+    
+    byte* const entry = mPage.get() + loc;
+    
+    encodeLeafValue(key.isIndirect() ?
+                    encodeIndirectKey(entry, key, capacity()) :
+                    encodeKey(entry, stored.first, stored.second), value);
+    
+    mHints.insert(pos, stored.second ?
+                  KeyHints::hintAfterPrefix(stored.first) :
+                  mHints.hint(stored.first));
+    
+    if (value.isGhost()) { ++mGhosts; }
+    
+    if (pos + 1 == size()) {
+        mEdgeInserts = std::max(mEdgeInserts, 0) + 1;
+    } else if (pos == 0) {
+        mEdgeInserts = std::min(mEdgeInserts, 0) - 1;
+    } else {
+        mEdgeInserts = 0;
+    }
+    
+    return InsertResult::INSERTED;
+}
+
+InsertResult LeafNode::update(const size_t pos, const LeafValue& value) {
+    TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    byte* const entry = page.data() + page.slot(pos);
+    const size_t keyLen = keyEntryLength(entry);
+    const size_t oldLen = leafEntryLength(entry);
+    
+    verifiedLeafEntrySize(capacity(), keyLen, value);
+    
+    const size_t newLen = keyLen + encodedLeafValueLength(value);
+    
+    // The entry stops being a ghost unless the new value is one too
+    const size_t ghosts = mGhosts - (entry[keyLen] == GHOST_VALUE) +
+        value.isGhost();
+    
+    if (newLen <= oldLen) {
+        // Shrinking leaves the tail of the old entry as garbage
+        encodeLeafValue(entry + keyLen, value);
+        page.garbage(page.garbage() + oldLen - newLen);
+        mGhosts = ghosts;
+        return InsertResult::INSERTED;
+    }
+    
+    const size_t loc = allocEntry(pos, newLen, false);
+    
+    if (loc == 0) {
+        // The old entry is garbage too, once the compaction replaces it
+        if (availableBytes() + oldLen < newLen) {
+            return InsertResult::FAILED_NO_SPACE;
+        }
+        
+        compact(pos, value);
+        mGhosts = ghosts;
+        return InsertResult::INSERTED;
+    }
+    
+    std::memcpy(page.data() + loc, entry, keyLen);
+    encodeLeafValue(page.data() + loc + keyLen, value);
+    
+    page.slot(pos, loc);
+    page.garbage(page.garbage() + oldLen);
+    mGhosts = ghosts;
+    
+    return InsertResult::INSERTED;
+}
+
+bool LeafNode::isGhost(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    return *valueStart(page.data() + page.slot(pos)) == GHOST_VALUE;
+}
+
+void LeafNode::countGhosts() {
+    mGhosts = 0;
+    
+    for (size_t pos = 0; pos < size(); ++pos) {
+        if (isGhost(pos)) { ++mGhosts; }
+    }
+}
+
+FragmentNode* LeafNode::keyFragments(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    const byte* const entry = page.data() + page.slot(pos);
+    return isIndirectKey(entry) ? indirectKeyFragments(entry) : nullptr;
+}
+
+void LeafNode::ghost(const size_t pos) {
+    TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    byte* const entry = page.data() + page.slot(pos);
+    const size_t oldLen = leafEntryLength(entry);
+    const size_t keyLen = keyEntryLength(entry);
+    
+    if (entry[keyLen] != GHOST_VALUE) { ++mGhosts; }
+    
+    // Every value takes at least the byte of the ghost header
+    entry[keyLen] = GHOST_VALUE;
+    page.garbage(page.garbage() + oldLen - keyLen - 1);
+}
+
+void LeafNode::removeGhosts(const std::vector<size_t>& positions) {
+    assert(std::all_of(positions.begin(), positions.end(),
+                       [this](const size_t pos) { return isGhost(pos); }));
+    
+    removeEntries(positions);
+}
+
+bool LeafNode::merge(LeafNode& right) {
+    const size_t size = this->size();
+    
+    for (size_t pos = 0; pos < right.size(); ++pos) {
+        if (copyEntry(size + pos, right, pos) == InsertResult::FAILED_NO_SPACE)
+        {
+            removeEntries(size, this->size());
+            return false;
+        }
+    }
+    
+    right.clearEntries();
+    mEdgeInserts = 0;
+    
+    return true;
+}
+
+std::ptrdiff_t LeafNode::rebalance(LeafNode& right) {
+    auto entryBytes = [](const LeafNode& node, const size_t pos) -> size_t {
+        const TreePage page(node.mPage.get(), node.mPageSize);
+        return leafEntryLength(page.data() + page.slot(pos)) + 2;
+    };
+    
+    // Entries are moved while the receiving node stays the smaller one, and
+    // the giving node keeps at least one entry
+    const bool fromRight = bytes() < right.bytes();
+    size_t moved = 0;
+    
+    if (fromRight) {
+        size_t rightBytes = right.bytes();
+        
+        while (moved + 1 < right.size()) {
+            const size_t len = entryBytes(right, moved);
+            
+            if (bytes() + len > rightBytes - len ||
+                copyEntry(size(), right, moved) != InsertResult::INSERTED)
+            {
+                break;
+            }
+            
+            rightBytes -= len;
+            ++moved;
+        }
+        
+        right.removeEntries(0, moved);
+    } else {
+        const size_t size = this->size();
+        size_t leftBytes = bytes();
+        
+        while (moved + 1 < size) {
+            const size_t len = entryBytes(*this, size - 1 - moved);
+            
+            if (right.bytes() + len > leftBytes - len ||
+                right.copyEntry(0, *this, size - 1 - moved) !=
+                InsertResult::INSERTED)
+            {
+                break;
+            }
+            
+            leftBytes -= len;
+            ++moved;
+        }
+        
+        removeEntries(size - moved, size);
+    }
+    
+    mEdgeInserts = 0;
+    right.mEdgeInserts = 0;
+    
+    return fromRight ? std::ptrdiff_t(moved) : -std::ptrdiff_t(moved);
+}
+
+InsertResult LeafNode::copyEntry(
+    const size_t pos, const LeafNode& source, const size_t sourcePos)
+{
+    const TreePage page(source.mPage.get(), source.mPageSize);
+    const byte* const entry = page.data() + page.slot(sourcePos);
+    
+    const Buffer key = source.key(sourcePos);
+    
+    return insert(pos, isIndirectKey(entry) ?
+                  NodeKey(key, *indirectKeyFragments(entry)) : NodeKey(key),
+                  source.leafValue(sourcePos));
+}
+
+void LeafNode::removeEntries(const std::vector<size_t>& positions) {
+    if (positions.empty()) { return; }
+    
+    byte* const scratch = scratchPage();
+    std::memcpy(scratch, mPage.get(), mPageSize);
+    
+    const TreePage source(scratch, mPageSize);
+    const size_t size = source.slots();
+    
+    // Marks the entries which are kept, in position order
+    std::vector<bool> kept(size, true);
+    
+    for (const size_t pos : positions) {
+        assert(pos < size && kept[pos]);
+        kept[pos] = false;
+    }
+    
+    size_t entryBytes = source.keyPrefixLength();
+    
+    for (size_t pos = 0; pos < size; ++pos) {
+        if (kept[pos]) {
+            entryBytes += leafEntryLength(scratch + source.slot(pos));
+        }
+    }
+    
+    TreePageBuilder builder(TreePage(mPage.get(), mPageSize), Type::TN_LEAF,
+                            size - positions.size(), entryBytes, 0,
+                            source.keyPrefix());
+    
+    for (size_t pos = 0; pos < size; ++pos) {
+        if (!kept[pos]) { continue; }
+        
+        const byte* const entry = scratch + source.slot(pos);
+        const size_t entryLen = leafEntryLength(entry);
+        
+        std::memcpy(builder.append(entryLen), entry, entryLen);
+    }
+    
+    rebuildHints();
+    countGhosts();
+}
+
+void LeafNode::removeEntries(const size_t begin, const size_t end) {
+    std::vector<size_t> positions;
+    
+    for (size_t pos = begin; pos < end; ++pos) { positions.push_back(pos); }
+    
+    removeEntries(positions);
+}
+
+/*
+  Reclaims all garbage by copying the page to the scratch page of this thread,
+  and rebuilding it from there with every entry in the left segment. The key
+  prefix and the order of the entries are unchanged, and so are the hints.
+  
+  If updatePos is the position of an entry, its value is replaced.
+ */
+void LeafNode::compact(const size_t updatePos, const LeafValue& value) {
+    byte* const scratch = scratchPage();
+    std::memcpy(scratch, mPage.get(), mPageSize);
+    
+    const TreePage source(scratch, mPageSize);
+    const size_t size = source.slots();
+    
+    auto keyLengthAt = [&](const size_t pos) -> size_t {
+        const byte* const entry = scratch + source.slot(pos);
+        return valueStart(entry) - entry;
+    };
+    
+    auto lengthAt = [&](const size_t pos) -> size_t {
+        return pos == updatePos ?
+            keyLengthAt(pos) + encodedLeafValueLength(value) :
+            leafEntryLength(scratch + source.slot(pos));
+    };
+    
+    size_t entryBytes = source.keyPrefixLength();
+    
+    for (size_t pos = 0; pos < size; ++pos) { entryBytes += lengthAt(pos); }
+    
+    TreePageBuilder builder(TreePage(mPage.get(), mPageSize), Type::TN_LEAF,
+                            size, entryBytes, 0, source.keyPrefix());
+    
+    for (size_t pos = 0; pos < size; ++pos) {
+        const byte* const entry = scratch + source.slot(pos);
+        byte* const dst = builder.append(lengthAt(pos));
+        
+        if (pos == updatePos) {
+            const size_t keyLen = keyLengthAt(pos);
+            
+            std::memcpy(dst, entry, keyLen);
+            encodeLeafValue(dst + keyLen, value);
+        } else {
+            std::memcpy(dst, entry, lengthAt(pos));
+        }
+    }
+}
+
+/*
+  Allocates entryLen bytes from either segment, growing the search vector by
+  one slot at pos if requested. The allocation is made from the side with the
+  most free space, and the search vector is shifted from the side requiring
+  the smaller shift. If the free space surrounding the search vector is
+  fragmented, the search vector is moved.
+  
+  Returns the location of the allocation, or 0 if there isn't enough free
+  space. New slots are set to point to the allocation.
+ */
+size_t LeafNode::allocEntry(
+    const size_t pos, const size_t entryLen, const bool slot)
+{
+    TreePage page(mPage.get(), mPageSize);
+    byte* const data = page.data();
+    
+    const size_t slotLen = slot ? 2 : 0;
+    const size_t leftTail = page.leftSegTail();
+    const size_t rightTail = page.rightSegTail();
+    
+    for (bool moved = false; ; moved = true) {
+        const size_t start = page.searchVecStart();
+        const size_t end = page.searchVecEnd();
+        const size_t n = (end + 2 - start) >> 1;
+        
+        const size_t leftGap = start - leftTail;
+        const size_t rightGap = rightTail - end - 1;
+        
+        const bool preferLeft = pos < n - pos;
+        
+        for (int choice = 0; choice < (slot ? 2 : 1); ++choice) {
+            const bool slotLeft = slot && (preferLeft == (choice == 0));
+            const bool slotRight = slot && !slotLeft;
+            
+            if ((slotLeft && leftGap < 2) || (slotRight && rightGap < 2)) {
+                continue;
+            }
+            
+            const size_t left = leftGap - (slotLeft ? 2 : 0);
+            const size_t right = rightGap - (slotRight ? 2 : 0);
+            
+            bool entryLeft;
+            
+            if (left >= entryLen && (left >= right || right < entryLen)) {
+                entryLeft = true;
+            } else if (right >= entryLen) {
+                entryLeft = false;
+            } else {
+                continue;
+            }
+            
+            if (slotLeft) {
+                std::memmove(data + start - 2, data + start, pos << 1);
+                page.searchVecStart(start - 2);
+            } else if (slotRight) {
+                const size_t at = start + (pos << 1);
+                std::memmove(data + at + 2, data + at, (n - pos) << 1);
+                page.searchVecEnd(end + 2);
+            }
+            
+            size_t loc;
+            
+            if (entryLeft) {
+                loc = leftTail;
+                page.leftSegTail(leftTail + entryLen);
+            } else {
+                loc = rightTail + 1 - entryLen;
+                page.rightSegTail(loc - 1);
+            }
+            
+            if (slot) { page.slot(pos, loc); }
+            
+            return loc;
+        }
+        
+        if (moved || leftGap + rightGap < entryLen + slotLen) { return 0; }
+        
+        // Move the search vector, placing the entry to its left and the
+        // slot to its right. Split the remaining free space evenly.
+        const size_t vecLen = end + 2 - start;
+        const size_t lo = leftTail + entryLen;
+        const size_t hi = rightTail + 1 - vecLen - slotLen;
+        
+        size_t newStart = lo + ((hi - lo) >> 1);
+        
+        if (newStart & 1) {
+            if (newStart + 1 <= hi) {
+                ++newStart;
+            } else if (newStart - 1 >= lo) {
+                --newStart;
+            } else {
+                return 0;
+            }
+        }
+        
+        std::memmove(data + newStart, data + start, vecLen);
+        page.searchVecStart(newStart);
+        page.searchVecEnd(newStart + vecLen - 2);
+    }
+}
+
+void LeafNode::splitAndInsert(const NodeKey& key, const LeafValue& value,
+                              LeafNode& sibling, const SplitPolicy policy)
+{
+    const auto result = lowerBound(key.bytes());
+    
+    if (result.second) {
+        throw std::invalid_argument("duplicate key not allowed");
+    }
+    
+    splitAndStore(result.first, false, key, value, sibling, policy);
+}
+
+void LeafNode::splitAndInsert(const size_t pos, const NodeKey& key,
+                              const LeafValue& value, LeafNode& sibling,
+                              const SplitPolicy policy)
+{
+    splitAndStore(pos, false, key, value, sibling, policy);
+}
+
+void LeafNode::splitAndUpdate(
+    const size_t pos, const LeafValue& value, LeafNode& sibling)
+{
+    // Copied because the page is rebuilt in place, over the entry
+    const Buffer key = this->key(pos);
+    
+    const TreePage page(mPage.get(), mPageSize);
+    const byte* const entry = page.data() + page.slot(pos);
+    
+    splitAndStore(pos, true, isIndirectKey(entry) ?
+                  NodeKey(key, *indirectKeyFragments(entry)) : NodeKey(key),
+                  value, sibling, SplitPolicy::EVEN);
+}
+
+/*
+  Splits this node, storing the new entry at pos. If replace is true, the new
+  entry replaces the existing entry at pos, otherwise it's inserted before it.
+  
+  The sibling receives the half that includes the new entry, and both nodes
+  are rebuilt without any garbage. The halves hold equal bytes, unless the
+  policy detects a run of inserts at one edge of the node, in which case the
+  new entry is split off by itself. The split key is the shortest separator
+  between the halves. Each half is given the key prefix which
+  encodes it in the fewest bytes: the prefix common to all of its keys, the
+  prefix of the original node, or none at all.
+ */
+void LeafNode::splitAndStore(const size_t pos, const bool replace,
+                             const NodeKey& key, const LeafValue& value,
+                             LeafNode& sibling, const SplitPolicy policy)
+{
+    assert(sibling.empty() && sibling.mPageSize == mPageSize);
+    
+    const TreePage page(mPage.get(), mPageSize);
+    const Bytes oldPrefix = page.keyPrefix();
+    
+    const size_t size = page.slots();
+    const size_t total = replace ? size : size + 1;
+    
+    if (total < 2) { throw std::domain_error("split is not possible"); }
+    
+    const size_t newKeyLen = key.isIndirect() ?
+        encodedNodeKeyLength(capacity(), key) :
+        encodedKeyLength(storedKey(page, key.bytes()).first.size());
+    
+    verifiedLeafEntrySize(capacity(), encodedNodeKeyLength(capacity(), key),
+                          value);
+    
+    const size_t newValueLen = encodedLeafValueLength(value);
+    const size_t newLen = newKeyLen + newValueLen;
+    
+    // Location of the entry at i, in the numbering that includes the new
+    // entry, or 0 for the new entry itself
+    auto locationAt = [&](const size_t i) -> size_t {
+        if (i == pos) { return 0; }
+        return page.slot(i < pos || replace ? i : i - 1);
+    };
+    
+    auto lengthAt = [&](const size_t i) -> size_t {
+        const size_t loc = locationAt(i);
+        return loc ? leafEntryLength(page.data() + loc) : newLen;
+    };
+    
+    // Only the leading bytes of an indirect key, except for the new entry
+    auto keyAt = [&](const size_t i) -> EntryKey {
+        const size_t loc = locationAt(i);
+        return loc ? entryKey(page, page.data() + loc)
+                   : EntryKey{Bytes{}, key.bytes()};
+    };
+    
+    auto isIndirectAt = [&](const size_t i) -> bool {
+        const size_t loc = locationAt(i);
+        return loc ? isIndirectKey(page.data() + loc) : key.isIndirect();
+    };
+    
+    auto fullKeyAt = [&](const size_t i) -> Buffer {
+        const size_t loc = locationAt(i);
+        return loc && isIndirectKey(page.data() + loc) ?
+            indirectKeyBytes(page.data() + loc) : keyAt(i).toBuffer();
+    };
+    
+    auto valueLengthAt = [&](const size_t i) -> size_t {
+        const size_t loc = locationAt(i);
+        
+        if (loc == 0) { return newValueLen; }
+        
+        const byte* const entry = page.data() + loc;
+        return leafEntryLength(entry) - (valueStart(entry) - entry);
+    };
+    
+    size_t totalBytes = 0;
+    
+    for (size_t i = 0; i < total; ++i) { totalBytes += lengthAt(i) + 2; }
+    
+    size_t splitPos = 0;
+    
+    for (size_t leftBytes = 0; leftBytes < totalBytes / 2; ++splitPos) {
+        leftBytes += lengthAt(splitPos) + 2;
+    }
+    
+    bool edgeSplit = false;
+    
+    if (policy == SplitPolicy::ADAPTIVE && !replace) {
+        // The previous insert was at the same edge
+        if (pos == size && mEdgeInserts > 0) {
+            splitPos = total - 1;
+            edgeSplit = true;
+        } else if (pos == 0 && mEdgeInserts < 0) {
+            splitPos = 1;
+            edgeSplit = true;
+        }
+    }
+    
+    splitPos = std::max<size_t>(1, std::min(splitPos, total - 1));
+    
+    // Bytes needed by the entries and the key prefix
+    auto bytesWithPrefix =
+        [&](const size_t begin, const size_t end, const Bytes prefix)
+    {
+        size_t bytes = prefix.size();
+        
+        for (size_t i = begin; i < end; ++i) {
+            if (isIndirectAt(i)) {
+                bytes += lengthAt(i);
+                continue;
+            }
+            
+            const EntryKey entryKey = keyAt(i);
+            const bool prefixed =
+                prefix.size() && entryKey.startsWith(prefix);
+            
+            bytes += valueLengthAt(i) + encodedKeyLength(
+                entryKey.size() - (prefixed ? prefix.size() : 0));
+        }
+        
+        return bytes;
+    };
+    
+    const size_t maxPrefixLen = maxKeyPrefixSize();
+    
+    // Rebuilds the entries [begin, end) into dst, and returns the key prefix
+    // chosen for them. A preferred prefix is used if all the keys have it.
+    auto build = [&](byte* const dst, const size_t begin, const size_t end,
+                     const Bytes preferred) -> Buffer
+    {
+        const EntryKey first = keyAt(begin);
+        
+        Buffer commonPrefix = first.toBuffer();
+        commonPrefix.resize(std::min(
+            commonPrefixLength(first, keyAt(end - 1)), maxPrefixLen));
+        
+        Bytes prefix;
+        size_t entryBytes = bytesWithPrefix(begin, end, prefix);
+        
+        if (preferred.size() && first.startsWith(preferred) &&
+            keyAt(end - 1).startsWith(preferred))
+        {
+            prefix = preferred;
+            entryBytes = bytesWithPrefix(begin, end, prefix);
+        } else {
+            for (const Bytes candidate : {Bytes{commonPrefix}, oldPrefix}) {
+                const size_t bytes = bytesWithPrefix(begin, end, candidate);
+                
+                if (bytes < entryBytes) {
+                    prefix = candidate;
+                    entryBytes = bytes;
+                }
+            }
+        }
+        
+        TreePageBuilder builder(TreePage(dst, mPageSize), Type::TN_LEAF,
+                                end - begin, entryBytes, 0, prefix);
+        
+        for (size_t i = begin; i < end; ++i) {
+            const size_t valueLen = valueLengthAt(i);
+            byte* entry;
+            
+            if (isIndirectAt(i)) {
+                // Indirect keys never exclude the key prefix
+                entry = builder.append(lengthAt(i));
+                
+                if (const size_t loc = locationAt(i)) {
+                    const size_t keyLen = keyEntryLength(page.data() + loc);
+                    std::memcpy(entry, page.data() + loc, keyLen);
+                    entry += keyLen;
+                } else {
+                    entry = encodeIndirectKey(entry, key, capacity());
+                }
+            } else {
+                const EntryKey entryKey = keyAt(i);
+                const bool prefixed =
+                    prefix.size() && entryKey.startsWith(prefix);
+                const size_t from = prefixed ? prefix.size() : 0;
+                const size_t keyLen = entryKey.size() - from;
+                
+                entry = builder.append(encodedKeyLength(keyLen) + valueLen);
+                entry = entryKey.copyTo(
+                    encodeKeyHeader(entry, keyLen, prefixed), from);
+            }
+            
+            if (const size_t loc = locationAt(i)) {
+                std::memcpy(entry, valueStart(page.data() + loc), valueLen);
+            } else {
+                encodeLeafValue(entry, value);
+            }
+        }
+        
+        return copyOf(prefix);
+    };
+    
+    Buffer splitKey = shortestSeparator(fullKeyAt(splitPos - 1),
+                                        fullKeyAt(splitPos));
+    
+    byte* const newPage = scratchPage();
+    SiblingDirection direction;
+    
+    // The entries staying in this node are built first. After an edge split,
+    // the new entry in the sibling gets their key prefix, which the inserts
+    // following it are likely to share.
+    if (pos < splitPos) {
+        direction = SiblingDirection::LEFT;
+        const Buffer prefix = build(newPage, splitPos, total, Bytes{});
+        build(sibling.mPage.get(), 0, splitPos,
+              edgeSplit ? Bytes{prefix} : Bytes{});
+    } else {
+        direction = SiblingDirection::RIGHT;
+        const Buffer prefix = build(newPage, 0, splitPos, Bytes{});
+        build(sibling.mPage.get(), splitPos, total,
+              edgeSplit ? Bytes{prefix} : Bytes{});
+    }
+    
+    // The page is copied over rather than swapped, since lookups read it
+    // optimistically
+    std::memcpy(mPage.get(), newPage, mPageSize);
+    
+    rebuildHints();
+    sibling.rebuildHints();
+    
+    countGhosts();
+    sibling.countGhosts();
+    
+    mEdgeInserts = 0;
+    
+    recordSplit(sibling, direction, std::move(splitKey));
+}
+
+/*---------------------------------------------------------------------------*/
+// InternalNode implementation
+/*---------------------------------------------------------------------------*/
+InternalNode::InternalNode(Node& leftestChild, const size_t pageSize) :
+    Node(internalType(leftestChild)),
+    mPageSize(pageSize), mPage(new byte[pageSize])
+{
+    assert(pageSize <= MAX_PAGE_SIZE && (pageSize & 1) == 0);
+    
+    TreePage page(mPage.get(), mPageSize);
+    page.init(type());
+    
+    const size_t idSize = fitsNarrowChildId(&leftestChild) ?
+        NARROW_CHILD_ID_SIZE : WIDE_CHILD_ID_SIZE;
+    
+    childIdSize(page, idSize);
+    encodeChildId(page.data() + childIdsStart(page), &leftestChild, idSize);
+}
+
+InternalNode::InternalNode(const size_t pageSize) :
+    Node(Type::TN_IN), mPageSize(pageSize), mPage(new byte[pageSize])
+{
+    assert(pageSize <= MAX_PAGE_SIZE && (pageSize & 1) == 0);
+    
+    TreePage page(mPage.get(), mPageSize);
+    page.init(type());
+    childIdSize(page, NARROW_CHILD_ID_SIZE);
+}
+
+size_t InternalNode::size() const {
+    return TreePage(mPage.get(), mPageSize).slots();
+}
+
+size_t InternalNode::capacity() const {
+    return mPageSize - TN_HEADER_SIZE;
+}
+
+size_t InternalNode::availableBytes() const {
+    const TreePage page(mPage.get(), mPageSize);
+    return page.garbage() + page.freeBytes() -
+        (page.slots() + 1) * childIdSize(page);
+}
+
+Buffer InternalNode::key(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    const byte* const entry = page.data() + page.slot(pos);
+    
+    if (isIndirectKey(entry)) { return indirectKeyBytes(entry); }
+    
+    return copyOf(decodeKey(entry));
+}
+
+Node* InternalNode::child(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos <= page.slots());
+    
+    const size_t idSize = childIdSize(page);
+    
+    return decodeChildId(
+        page.data() + childIdsStart(page) + pos * idSize, idSize);
+}
+
+pair<size_t, bool> InternalNode::lowerBound(const Bytes key) const {
+    const TreePage page(mPage.get(), mPageSize);
+    
+    // Only the keys having the same hint as the key need to be compared
+    const auto range = mHints.range(mHints.hint(key));
+    
+    KeyComparator comparator(key);
+    
+    return comparator.lowerBound(
+        range.first, range.second, [&](const size_t pos)
+    {
+        return compareEntry(comparator, page.data() + page.slot(pos));
+    });
+}
+
+size_t InternalNode::childPos(const Bytes key) const {
+    const auto result = lowerBound(key);
+    return result.second ? result.first + 1 : result.first;
+}
+
+void InternalNode::prefetchHeader() const {
+    prefetch(mPage.get(), TN_HEADER_SIZE);
+}
+
+void InternalNode::prefetchSearchVector() const {
+    const TreePage page(mPage.get(), mPageSize);
+    prefetchSearchVec(page, childIdSize(page));
+}
+
+/*
+  The page can be changing while it's read, so every location decoded from it
+  is checked against the page bounds before it's followed. The hints aren't
+  used, since they're not kept in the page.
+ */
+Node* InternalNode::optimisticChild(const Bytes key) const {
+    return optimisticChild(key, nullptr);
+}
+
+Node* InternalNode::optimisticChild(const Bytes key, Bytes& highKey) const {
+    return optimisticChild(key, &highKey);
+}
+
+Node* InternalNode::optimisticChild(const Bytes key,
+                                    Bytes* const highKey) const
+{
+    const TreePage page(mPage.get(), mPageSize);
+    const size_t start = page.searchVecStart();
+    const size_t end = page.searchVecEnd() + 2; // exclusive
+    
+    if (start < TN_HEADER_SIZE || end < start || end > mPageSize) {
+        return nullptr;
+    }
+    
+    const size_t size = (end - start) >> 1;
+    const size_t idSize = childIdSize(page);
+    
+    if (end + (size + 1) * idSize > mPageSize) { return nullptr; }
+    
+    // Decodes the key at pos, unless it lies outside of the page
+    const auto keyAt = [&](const size_t pos, Bytes& nodeKey) {
+        const size_t loc = page.slot(pos);
+        
+        if (loc < TN_HEADER_SIZE || loc + 2 > mPageSize) { return false; }
+        
+        const byte* const entry = page.data() + loc;
+        
+        // Comparing indirect keys could follow a released fragment
+        if (isIndirectKey(entry)) { return false; }
+        
+        nodeKey = decodeKey(entry);
+        
+        return nodeKey.data() + nodeKey.size() <= page.data() + mPageSize;
+    };
+    
+    // Finds the number of keys which are less than or equal to the key
+    size_t low = 0;
+    size_t high = size;
+    
+    while (low < high) {
+        const size_t mid = (low + high) >> 1;
+        Bytes nodeKey;
+        
+        if (!keyAt(mid, nodeKey)) { return nullptr; }
+        
+        if (compareKeys(nodeKey, key) <= 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    
+    if (highKey) {
+        *highKey = Bytes{};
+        
+        if (low < size && !keyAt(low, *highKey)) { return nullptr; }
+    }
+    
+    return decodeChildId(page.data() + end + low * idSize, idSize);
+}
+
+/*
+  Selects the prefix shared by the first and last keys as the hint prefix,
+  which every key in between also starts with
+ */
+void InternalNode::rebuildHints() {
+    const TreePage page(mPage.get(), mPageSize);
+    const size_t size = page.slots();
+    
+    if (size == 0) {
+        mHints.reset(Bytes{});
+        return;
+    }
+    
+    const Bytes first = decodeKey(page.data() + page.slot(0));
+    const Bytes last = decodeKey(page.data() + page.slot(size - 1));
+    
+    mHints.reset(Bytes{first.data(), commonPrefixLength(
+                EntryKey{Bytes{}, first}, EntryKey{Bytes{}, last})});
+    
+    for (size_t pos = 0; pos < size; ++pos) {
+        mHints.append(entryHint(mHints, page.data() + page.slot(pos)));
+    }
+}
+
+InsertResult InternalNode::insert(const NodeKey& key, Node& child) {
+    const auto result = lowerBound(key.bytes());
+    
+    if (result.second) {
+        throw std::invalid_argument("duplicate key not allowed");
+    }
+    
+    return insert(result.first, key, child, SiblingDirection::RIGHT);
+}
+
+InsertResult InternalNode::insert(const size_t keyPos, const NodeKey& key,
+                                  Node& child, const SiblingDirection side)
+{
+    const size_t entryLen = verifiedKeyEntrySize(capacity(), key);
+    const size_t childPos =
+        side == SiblingDirection::RIGHT ? keyPos + 1 : keyPos;
+    
+    if (!fitsNarrowChildId(&child) &&
+        childIdSize(TreePage(mPage.get(), mPageSize)) == NARROW_CHILD_ID_SIZE)
+    {
+        const size_t widening =
+            (size() + 1) * (WIDE_CHILD_ID_SIZE - NARROW_CHILD_ID_SIZE);
+        
+        if (availableBytes() < widening + entryLen + 2 + WIDE_CHILD_ID_SIZE) {
+            return InsertResult::FAILED_NO_SPACE;
+        }
+        
+        widenChildIds();
+    }
+    
+    const size_t loc = allocEntry(keyPos, childPos, entryLen);
+    
+    if (loc == 0) { return InsertResult::FAILED_NO_SPACE; }
+    
+    TreePage page(mPage.get(), mPageSize);
+    const size_t idSize = childIdSize(page);
+    
+    if (key.isIndirect()) {
+        encodeIndirectKey(page.data() + loc, key, capacity());
+    } else {
+        encodeKey(page.data() + loc, key.bytes());
+    }
+    
+    encodeChildId(page.data() + childIdsStart(page) + childPos * idSize,
+                  &child, idSize);
+    
+    mHints.insert(keyPos, mHints.hint(key.bytes()));
+    
+    return InsertResult::INSERTED;
+}
+
+/*
+  Switches to wide child identifiers, for a child which doesn't fit the
+  narrow ones. The node is rebuilt from a copy in the scratch page of this
+  thread, which also reclaims any garbage.
+ */
+void InternalNode::widenChildIds() {
+    byte* const scratch = scratchPage();
+    std::memcpy(scratch, mPage.get(), mPageSize);
+    
+    const TreePage source(scratch, mPageSize);
+    const size_t size = source.slots();
+    const size_t sourceIdSize = childIdSize(source);
+    
+    auto lengthAt = [&](const size_t pos) -> size_t {
+        return keyEntryLength(scratch + source.slot(pos));
+    };
+    
+    size_t entryBytes = 0;
+    
+    for (size_t pos = 0; pos < size; ++pos) { entryBytes += lengthAt(pos); }
+    
+    TreePage page(mPage.get(), mPageSize);
+    TreePageBuilder builder(page, type(), size, entryBytes,
+                            (size + 1) * WIDE_CHILD_ID_SIZE);
+    childIdSize(page, WIDE_CHILD_ID_SIZE);
+    
+    for (size_t pos = 0; pos < size; ++pos) {
+        const size_t len = lengthAt(pos);
+        std::memcpy(builder.append(len), scratch + source.slot(pos), len);
+    }
+    
+    const byte* const sourceIds = scratch + childIdsStart(source);
+    byte* const ids = page.data() + childIdsStart(page);
+    
+    for (size_t pos = 0; pos <= size; ++pos) {
+        encodeChildId(ids + pos * WIDE_CHILD_ID_SIZE,
+                      decodeChildId(sourceIds + pos * sourceIdSize,
+                                    sourceIdSize),
+                      WIDE_CHILD_ID_SIZE);
+    }
+}
+
+/*
+  Allocates entryLen bytes from either segment for a key at keyPos, and opens
+  a hole in the child identifiers at childPos. The search vector and the child
+  identifiers form a single block, which grows by one slot on the left if
+  possible, otherwise on the right. If neither fits, the block is moved to
+  the middle of the free space.
+  
+  Returns the location of the allocation, or 0 if there isn't enough free
+  space. The new slot is set to point to the allocation.
+ */
+size_t InternalNode::allocEntry(
+    const size_t keyPos, const size_t childPos, const size_t entryLen)
+{
+    TreePage page(mPage.get(), mPageSize);
+    byte* const data = page.data();
+    
+    const size_t start = page.searchVecStart();
+    const size_t n = page.slots();
+    const size_t leftTail = page.leftSegTail();
+    const size_t rightTail = page.rightSegTail();
+    
+    const size_t idSize = childIdSize(page);
+    const size_t vecLen = n << 1;
+    const size_t blockLen = vecLen + (n + 1) * idSize;
+    const size_t newBlockLen = blockLen + 2 + idSize;
+    
+    if (start - leftTail + rightTail + 1 - start - blockLen <
+        entryLen + 2 + idSize)
+    {
+        return 0;
+    }
+    
+    // Returns 1 if the entry fits to the left, 2 if to the right, else 0
+    auto placement = [&](const size_t newStart) -> int {
+        if ((newStart & 1) || newStart < leftTail ||
+            newStart + newBlockLen > rightTail + 1)
+        {
+            return 0;
+        }
+        
+        const size_t left = newStart - leftTail;
+        const size_t right = rightTail + 1 - newStart - newBlockLen;
+        
+        if (left >= entryLen && (left >= right || right < entryLen)) {
+            return 1;
+        }
+        
+        return right >= entryLen ? 2 : 0;
+    };
+    
+    size_t newStart = start - 2;
+    int side = start >= 2 ? placement(newStart) : 0;
+    
+    if (side == 0) { side = placement(newStart = start); }
+    
+    if (side == 0) {
+        // Entry to the left of the block, then to the right
+        for (int attempt = 0; attempt < 2 && side == 0; ++attempt) {
+            const size_t lo = leftTail + (attempt == 0 ? entryLen : 0);
+            const size_t end = rightTail + 1 - (attempt == 0 ? 0 : entryLen);
+            
+            if (lo + newBlockLen > end) { continue; }
+            
+            const size_t hi = end - newBlockLen;
+            newStart = (lo + ((hi - lo) >> 1)) & ~size_t(1);
+            
+            if (newStart < lo) { newStart += 2; }
+            
+            side = newStart <= hi ? placement(newStart) : 0;
+        }
+        
+        if (side == 0) { return 0; }
+    }
+    
+    // Move the four parts of the block: slots before and after keyPos, and
+    // child identifiers before and after childPos. The shifts never decrease
+    // from left to right, so parts moving left are moved first, from left to
+    // right, then parts moving right are moved from right to left.
+    struct Part { size_t from; size_t len; size_t to; };
+    
+    const size_t idsStart = start + vecLen;
+    const size_t newIdsStart = newStart + vecLen + 2;
+    
+    const Part parts[] = {
+        { start, keyPos << 1, newStart },
+        { start + (keyPos << 1), (n - keyPos) << 1,
+          newStart + (keyPos << 1) + 2 },
+        { idsStart, childPos * idSize, newIdsStart },
+        { idsStart + childPos * idSize, (n + 1 - childPos) * idSize,
+          newIdsStart + (childPos + 1) * idSize },
+    };
+    
+    for (const auto& part : parts) {
+        if (part.to <= part.from) {
+            std::memmove(data + part.to, data + part.from, part.len);
+        }
+    }
+    
+    for (size_t i = 4; i-- > 0; ) {
+        const auto& part = parts[i];
+        
+        if (part.to > part.from) {
+            std::memmove(data + part.to, data + part.from, part.len);
+        }
+    }
+    
+    page.searchVecStart(newStart);
+    page.searchVecEnd(newStart + vecLen);
+    
+    size_t loc;
+    
+    if (side == 1) {
+        loc = leftTail;
+        page.leftSegTail(leftTail + entryLen);
+    } else {
+        loc = rightTail + 1 - entryLen;
+        page.rightSegTail(loc - 1);
+    }
+    
+    page.slot(keyPos, loc);
+    
+    return loc;
+}
+
+/*
+  Splits this node while inserting key at keyPos and child on the given side
+  of it. The key in the middle is removed from both nodes, and becomes the
+  split key for the parent.
+ */
+void InternalNode::splitAndInsert(const size_t keyPos, const NodeKey& key,
+                                  Node& child, const SiblingDirection side,
+                                  InternalNode& sibling)
+{
+    assert(sibling.empty() && sibling.mPageSize == mPageSize);
+    
+    const TreePage page(mPage.get(), mPageSize);
+    
+    const size_t size = page.slots();
+    const size_t total = size + 1;
+    
+    if (total < 3) { throw std::domain_error("split is not possible"); }
+    
+    const size_t newLen = verifiedKeyEntrySize(capacity(), key);
+    const size_t childPos =
+        side == SiblingDirection::RIGHT ? keyPos + 1 : keyPos;
+    const size_t idSize = childIdSize(page);
+    
+    // Location of the key at i, in the numbering that includes the new key,
+    // or 0 for the new key itself
+    auto locationAt = [&](const size_t i) -> size_t {
+        if (i == keyPos) { return 0; }
+        return page.slot(i < keyPos ? i : i - 1);
+    };
+    
+    auto lengthAt = [&](const size_t i) -> size_t {
+        const size_t loc = locationAt(i);
+        return loc ? keyEntryLength(page.data() + loc) : newLen;
+    };
+    
+    auto childAt = [&](const size_t i) -> Node* {
+        if (i == childPos) { return &child; }
+        return this->child(i < childPos ? i : i - 1);
+    };
+    
+    size_t totalBytes = 0;
+    
+    for (size_t i = 0; i < total; ++i) {
+        totalBytes += lengthAt(i) + 2 + idSize;
+    }
+    
+    // The key at splitPos moves up to the parent
+    size_t splitPos = 0;
+    
+    for (size_t leftBytes = 0; leftBytes < totalBytes / 2; ++splitPos) {
+        leftBytes += lengthAt(splitPos) + 2 + idSize;
+    }
+    
+    splitPos = std::max<size_t>(1, std::min(splitPos, total - 2));
+    
+    auto build = [&](byte* const dst, const size_t begin, const size_t end) {
+        size_t entryBytes = 0;
+        
+        for (size_t i = begin; i < end; ++i) { entryBytes += lengthAt(i); }
+        
+        // Each half uses narrow identifiers if all of its children fit them
+        size_t dstIdSize = NARROW_CHILD_ID_SIZE;
+        
+        for (size_t i = begin; i <= end; ++i) {
+            if (!fitsNarrowChildId(childAt(i))) {
+                dstIdSize = WIDE_CHILD_ID_SIZE;
+            }
+        }
+        
+        TreePage dstPage(dst, mPageSize);
+        TreePageBuilder builder(dstPage, type(), end - begin, entryBytes,
+                                (end - begin + 1) * dstIdSize);
+        childIdSize(dstPage, dstIdSize);
+        
+        for (size_t i = begin; i < end; ++i) {
+            const size_t loc = locationAt(i);
+            const size_t len = lengthAt(i);
+            
+            if (loc) {
+                std::memcpy(builder.append(len), page.data() + loc, len);
+            } else if (key.isIndirect()) {
+                encodeIndirectKey(builder.append(len), key, capacity());
+            } else {
+                encodeKey(builder.append(len), key.bytes());
+            }
+        }
+        
+        byte* const ids = dst + childIdsStart(dstPage);
+        
+        for (size_t i = begin; i <= end; ++i) {
+            encodeChildId(ids + (i - begin) * dstIdSize, childAt(i),
+                          dstIdSize);
+        }
+    };
+    
+    // An indirect split key keeps its fragments, which the parent takes over
+    Buffer splitKey;
+    FragmentNode* splitKeyFragments;
+    
+    if (splitPos == keyPos) {
+        splitKey = copyOf(key.bytes());
+        splitKeyFragments = key.fragments();
+    } else {
+        const byte* const entry = page.data() + locationAt(splitPos);
+        const bool indirect = isIndirectKey(entry);
+        
+        splitKey = indirect ? indirectKeyBytes(entry) : copyOf(decodeKey(entry));
+        splitKeyFragments = indirect ? indirectKeyFragments(entry) : nullptr;
+    }
+    
+    byte* const newPage = scratchPage();
+    SiblingDirection direction;
+    
+    if (keyPos < splitPos || (keyPos == splitPos && childPos <= splitPos)) {
+        direction = SiblingDirection::LEFT;
+        build(sibling.mPage.get(), 0, splitPos);
+        build(newPage, splitPos + 1, total);
+    } else {
+        direction = SiblingDirection::RIGHT;
+        build(newPage, 0, splitPos);
+        build(sibling.mPage.get(), splitPos + 1, total);
+    }
+    
+    replacePage(newPage);
+    sibling.type(type());
+    
+    rebuildHints();
+    sibling.rebuildHints();
+    
+    recordSplit(sibling, direction, std::move(splitKey), splitKeyFragments);
+}
+
+/*
+  Key of a node being rebuilt, which is copied from the entry of an existing
+  node unless it's only given as a NodeKey
+ */
+struct InternalNode::KeySource {
+    const byte* entry;
+    const NodeKey* key;
+};
+
+FragmentNode* InternalNode::keyFragments(const size_t pos) const {
+    const TreePage page(mPage.get(), mPageSize);
+    assert(pos < page.slots());
+    
+    const byte* const entry = page.data() + page.slot(pos);
+    return isIndirectKey(entry) ? indirectKeyFragments(entry) : nullptr;
+}
+
+InsertResult InternalNode::replaceKey(const size_t pos, const NodeKey& key) {
+    std::vector<KeySource> keys;
+    std::vector<Node*> children;
+    appendContents(keys, children);
+    
+    keys[pos] = KeySource{nullptr, &key};
+    
+    return rebuild(keys, children) ?
+        InsertResult::INSERTED : InsertResult::FAILED_NO_SPACE;
+}
+
+void InternalNode::remove(const size_t pos) {
+    std::vector<KeySource> keys;
+    std::vector<Node*> children;
+    appendContents(keys, children);
+    
+    keys.erase(keys.begin() + pos);
+    children.erase(children.begin() + pos + 1);
+    
+    const bool rebuilt = rebuild(keys, children);
+    assert(rebuilt);
+    (void) rebuilt;
+}
+
+bool InternalNode::merge(const NodeKey& separator, const InternalNode& right)
+{
+    std::vector<KeySource> keys;
+    std::vector<Node*> children;
+    
+    appendContents(keys, children);
+    keys.push_back(KeySource{nullptr, &separator});
+    right.appendContents(keys, children);
+    
+    return rebuild(keys, children);
+}
+
+std::ptrdiff_t InternalNode::rebalance(
+    const NodeKey& separator, InternalNode& right, Buffer& newSeparator,
+    FragmentNode*& newSeparatorFragments)
+{
+    std::vector<KeySource> keys;
+    std::vector<Node*> children;
+    
+    appendContents(keys, children);
+    const size_t separatorPos = keys.size();
+    keys.push_back(KeySource{nullptr, &separator});
+    right.appendContents(keys, children);
+    
+    const size_t idSize = childIdSize(TreePage(mPage.get(), mPageSize));
+    
+    auto bytesAt = [&](const size_t i) -> size_t {
+        return (keys[i].entry ? keyEntryLength(keys[i].entry) :
+                verifiedKeyEntrySize(capacity(), *keys[i].key)) + 2 + idSize;
+    };
+    
+    size_t totalBytes = 0;
+    
+    for (size_t i = 0; i < keys.size(); ++i) { totalBytes += bytesAt(i); }
+    
+    // The key at splitPos becomes the new separator, as in a split
+    size_t splitPos = 0;
+    
+    for (size_t leftBytes = 0; leftBytes < totalBytes / 2; ++splitPos) {
+        leftBytes += bytesAt(splitPos);
+    }
+    
+    splitPos = std::min(splitPos, keys.size() - 1);
+    
+    if (splitPos == separatorPos) { return 0; }
+    
+    const byte* const entry = keys[splitPos].entry;
+    const bool indirect = isIndirectKey(entry);
+    
+    Buffer splitKey = indirect ?
+        indirectKeyBytes(entry) : copyOf(decodeKey(entry));
+    FragmentNode* const splitKeyFragments =
+        indirect ? indirectKeyFragments(entry) : nullptr;
+    
+    // Both halves are built before either node is changed
+    InternalNode left(mPageSize);
+    InternalNode newRight(mPageSize);
+    left.type(type());
+    newRight.type(type());
+    
+    if (!left.rebuild(
+            std::vector<KeySource>(keys.begin(), keys.begin() + splitPos),
+            std::vector<Node*>(children.begin(),
+                               children.begin() + splitPos + 1)) ||
+        !newRight.rebuild(
+            std::vector<KeySource>(keys.begin() + splitPos + 1, keys.end()),
+            std::vector<Node*>(children.begin() + splitPos + 1,
+                               children.end())))
+    {
+        return 0;
+    }
+    
+    replacePage(left.mPage.get());
+    right.replacePage(newRight.mPage.get());
+    
+    rebuildHints();
+    right.rebuildHints();
+    
+    newSeparator = std::move(splitKey);
+    newSeparatorFragments = splitKeyFragments;
+    
+    return std::ptrdiff_t(splitPos) - std::ptrdiff_t(separatorPos);
+}
+
+void InternalNode::appendContents(std::vector<KeySource>& keys,
+                                  std::vector<Node*>& children) const
+{
+    const TreePage page(mPage.get(), mPageSize);
+    
+    for (size_t pos = 0; pos < page.slots(); ++pos) {
+        keys.push_back(KeySource{page.data() + page.slot(pos), nullptr});
+    }
+    
+    for (size_t pos = 0; pos <= page.slots(); ++pos) {
+        children.push_back(child(pos));
+    }
+}
+
+bool InternalNode::rebuild(const std::vector<KeySource>& keys,
+                           const std::vector<Node*>& children)
+{
+    assert(children.size() == keys.size() + 1);
+    
+    auto lengthAt = [&](const size_t i) -> size_t {
+        return keys[i].entry ? keyEntryLength(keys[i].entry) :
+            verifiedKeyEntrySize(capacity(), *keys[i].key);
+    };
+    
+    size_t entryBytes = 0;
+    
+    for (size_t i = 0; i < keys.size(); ++i) { entryBytes += lengthAt(i); }
+    
+    size_t idSize = NARROW_CHILD_ID_SIZE;
+    
+    for (const Node* const child : children) {
+        if (!fitsNarrowChildId(child)) { idSize = WIDE_CHILD_ID_SIZE; }
+    }
+    
+    const size_t blockLen = (keys.size() << 1) + children.size() * idSize;
+    
+    if (entryBytes + blockLen > capacity()) { return false; }
+    
+    // Keys may be copied from the current page, which is replaced afterwards
+    byte* const newPage = scratchPage();
+    
+    TreePage page(newPage, mPageSize);
+    TreePageBuilder builder(page, type(), keys.size(), entryBytes,
+                            children.size() * idSize);
+    childIdSize(page, idSize);
+    
+    for (size_t i = 0; i < keys.size(); ++i) {
+        const size_t len = lengthAt(i);
+        
+        if (keys[i].entry) {
+            std::memcpy(builder.append(len), keys[i].entry, len);
+        } else if (keys[i].key->isIndirect()) {
+            encodeIndirectKey(builder.append(len), *keys[i].key, capacity());
+        } else {
+            encodeKey(builder.append(len), keys[i].key->bytes());
+        }
+    }
+    
+    byte* const ids = page.data() + childIdsStart(page);
+    
+    for (size_t i = 0; i < children.size(); ++i) {
+        encodeChildId(ids + i * idSize, children[i], idSize);
+    }
+    
+    replacePage(newPage);
+    rebuildHints();
+    
+    return true;
+}
+
+/*
+  Pages are copied over instead of being swapped, so that the page which
+  optimistic readers might still be reading is never freed
+ */
+void InternalNode::replacePage(const byte* const page) {
+    std::memcpy(mPage.get(), page, mPageSize);
+}
 
-// Node::Node():
-//     mMoreUsed(nullptr),
-//     mLessUsed(nullptr),
-//     mNextDirty(nullptr),
-//     mPrevDirty(nullptr),
-//     mLastCursorFrame(nullptr),
-//     mPage(nullptr)
-// {
-// }
-
-} } } // namespace tupl::pvt::disabled
+} } // namespace tupl::pvt
@@ -20,22 +20,74 @@
 #include "../types.hpp"
 #include "types.hpp"
 
-#include "ArrayStackGeneric.hpp"
+#include "Buffer.hpp"
 #include "CursorFrame.hpp"
+#include "KeyHints.hpp"
 #include "Latch.hpp"
+#include "ptrCast.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
 #include <vector>
 
-namespace tupl { namespace pvt { namespace disabled {
+#include <boost/intrusive/list.hpp>
+#include <boost/iterator/counting_iterator.hpp>
+#include <boost/iterator/transform_iterator.hpp>
 
-class PageAllocator;
-class Page {};
+namespace tupl { namespace pvt {
 
-class Node: public Latch {
-    class Header {};
-    class Split  {};
-    class Id {};
+enum class SiblingDirection : bool {
+    LEFT  = 0x0,
+    RIGHT = 0x1,    
+};
+
+enum class InsertResult {
+    FAILED_NO_SPACE,
+    INSERTED,
+};
+
+/**
+   Chooses where a full leaf is split when inserting into it
+ */
+enum class SplitPolicy : byte {
+    // Halves the bytes in use
+    EVEN,
     
+    // Splits evenly, unless the insert continues a run of appends after the
+    // highest key or prepends before the lowest key. The existing entries
+    // then stay together, and the new entry starts an empty sibling.
+    ADAPTIVE,
+};
+
+class FragmentNode;
+
+template<typename NodeT>
+struct Split final {
+    NodeT* sibling;
+    SiblingDirection direction;
+    Buffer key;
+    
+    // Fragments of the split key, when an internal node stored it
+    // indirectly. The parent takes them over along with the key.
+    FragmentNode* keyFragments;
+};
+
+/**
+   Returns the shortest key which is greater than low and not greater than
+   high. Leaf splits promote it instead of the first key of the right half,
+   keeping the keys of internal nodes short.
+ */
+Buffer shortestSeparator(Bytes low, Bytes high);
+
+/**
+   State common to all the nodes of a Tree, regardless of how their contents
+   are encoded.
+   
+   @author Vishal Parakh
+ */
+class Node: public Latch {
 public:
     /*
       Note: Changing these values affects how the Database class handles the
@@ -75,23 +127,31 @@ public:
         TN_LEAF  = 0x80, // 0b1000_000_0
     };
 
-    bool isLeaf() const { return false; }
+    static const std::size_t DEFAULT_PAGE_SIZE = 4096;
     
-    bool split() const { return false; }
+    Type type() const { return mType; }
     
-    Header header;
+    bool isLeaf() const { return static_cast<std::int8_t>(mType) < 0; }
     
-    // FIXME: Node.java has this volatile, but that makes being typed
-    //        complicated. Understand and verify usage
-    Id id;
+    void recordSplit(
+        Node& sibling, const SiblingDirection direction, Buffer&& splitKey,
+        FragmentNode* const keyFragments = nullptr)
+    {
+        assert(mSplit.sibling == nullptr);
+        mSplit.sibling = &sibling;
+        mSplit.direction = direction;
+        mSplit.key = splitKey;
+        mSplit.keyFragments = keyFragments;
+    }
     
-    // FIX DOC: Links within usage list, guarded by Database.mUsageLatch.
-    Node* moreUsed; // points to more recently used node
-    Node* lessUsed; // points to less recently used node
+    bool hasSibling() const { return mSplit.sibling != nullptr; }
     
-    // Links within dirty list, guarded by OrderedPageAllocator.
-    Node* nextDirty;
-    Node* prevDirty;
+    const Split<Node>& split() const { return mSplit; }
+    
+    /**
+       Forgets the split once the parent refers to the sibling
+     */
+    void clearSplit() { mSplit = Split<Node>(); }
     
     // CursorFrame's bound to this Node
     boost::intrusive::list<
@@ -101,22 +161,586 @@ public:
             CursorFrame,
             CursorFrame::ListMemberHook,
             &CursorFrame::visitors_>
-        > cursorFrames;
+        > visitorFrames;
+    
+    // Guards visitorFrames for frames being bound or unbound while the node
+    // is only latched shared. Holding the node latch exclusively is enough
+    // to move frames around.
+    Latch visitorFramesLatch;
+    
+    // FIX DOC: Links within usage list, guarded by Database.mUsageLatch.
+    Node* moreUsed; // points to more recently used node
+    Node* lessUsed; // points to less recently used node
+    
+    // Links within dirty list, guarded by PageAllocator.
+    Node* nextDirty;
+    Node* prevDirty;
+    
+    // Position within the Tree's nodes of the same type, so that the node is
+    // removed without searching for it. Guarded by Tree.mNodesLatch.
+    std::size_t treeSlot;
+    
+    // Not Copyable
+    Node(const Node& n) = delete;
+    Node& operator=(const Node& n) = delete;
+    
+protected:
+    explicit Node(Type type) :
+        moreUsed(nullptr), lessUsed(nullptr),
+        nextDirty(nullptr), prevDirty(nullptr), treeSlot(0),
+        mType(type), mSplit() {}
+    
+    void type(const Type type) { mType = type; }
+    
+private:
+    Type mType;
+    
+protected:
+    // Records a partially completed split
+    Split<Node> mSplit;
+};
+
+/**
+   Node holding one part of a fragmented value or of an indirect key. The
+   parts are chained in order, and the entry refers to the first one. Fragment
+   nodes are never modified while they are referenced, so they can be read
+   while the leaf is latched, without latching them too.
+   
+   @author Vishal Parakh
+ */
+class FragmentNode final: public Node {
+public:
+    explicit FragmentNode(std::size_t pageSize = DEFAULT_PAGE_SIZE);
+    
+    /**
+       Maximum number of value bytes held by a single node
+     */
+    std::size_t capacity() const;
+    
+    Bytes data() const;
+    
+    /**
+       Returns the node holding the following part, or null for the last part
+     */
+    FragmentNode* next() const;
+    
+    /**
+       Replaces the contents with at most capacity() bytes
+     */
+    void assign(Bytes data, FragmentNode* next);
+    
+private:
+    const std::size_t mPageSize;
     
     // Raw contents of node.
-    Page page;
+    std::unique_ptr<byte[]> mPage;
+};
+
+/**
+   Key of a node entry, which is either stored within the entry, or stored
+   indirectly in a chain of FragmentNodes holding all of it. Entries of
+   indirect keys still hold their leading bytes, which settle most
+   comparisons without reading the fragments.
+ */
+class NodeKey final {
+public:
+    NodeKey(const Bytes key) : mBytes(key), mFragments(nullptr) {}
+    
+    template<typename BytesContainer>
+    NodeKey(const BytesContainer& container) : NodeKey(Bytes(container)) {}
+    
+    NodeKey(const Bytes key, FragmentNode& fragments) :
+        mBytes(key), mFragments(&fragments) {}
+    
+    bool isIndirect() const { return mFragments != nullptr; }
+    
+    Bytes bytes() const { return mBytes; }
     
-    // TODO: Memory managment foo, THINK: overallocate Node, custom allocator??
-    std::vector<Node*> childNodes;
+    /**
+       First fragment of an indirect key
+     */
+    FragmentNode* fragments() const { return mFragments; }
+    
+private:
+    Bytes mBytes;
+    FragmentNode* mFragments;
+};
 
-    // Records a partially completed split
-    Split mSplit;
+/**
+   Returns true if a key of the given length is stored within the entries of
+   nodes having the given page size. Trees store longer keys indirectly.
+ */
+bool keyFitsInline(std::size_t keyLen,
+                   std::size_t pageSize = Node::DEFAULT_PAGE_SIZE);
 
-    // Not Copyable
-    Node(const Node& n) = delete;
-    Node& operator=(const Node& n) = delete;    
+/**
+   Returns the length of the longest entry that a key chosen by keyFitsInline
+   takes in an internal node, whether it's stored inline or indirectly
+ */
+std::size_t maxKeyEntrySize(std::size_t pageSize = Node::DEFAULT_PAGE_SIZE);
+
+/**
+   Value of a leaf entry, which is either stored within the entry, or
+   fragmented into a chain of FragmentNodes that the entry refers to. A null
+   value is the value of a ghost.
+ */
+class LeafValue final {
+public:
+    LeafValue(const Bytes value) :
+        mBytes(value), mLength(value.size()), mFirst(nullptr) {}
+    
+    template<typename BytesContainer>
+    LeafValue(const BytesContainer& container) :
+        LeafValue(Bytes(container)) {}
+    
+    LeafValue(const std::uint64_t length, FragmentNode& first) :
+        mBytes(), mLength(length), mFirst(&first) {}
+    
+    bool isFragmented() const { return mFirst != nullptr; }
+    
+    bool isGhost() const { return !isFragmented() && mBytes.data() == nullptr; }
     
-    friend class ::tupl::pvt::disabled::PageAllocator;
+    std::uint64_t length() const { return mLength; }
+    
+    /**
+       Contents of a value which isn't fragmented
+     */
+    Bytes bytes() const { assert(!isFragmented()); return mBytes; }
+    
+    /**
+       First fragment of a fragmented value
+     */
+    FragmentNode* first() const { return mFirst; }
+    
+    /**
+       Appends the contents to dst, reading fragments directly from their
+       pages.
+     */
+    void appendTo(Buffer& dst) const;
+    
+private:
+    Bytes mBytes;
+    std::uint64_t mLength;
+    FragmentNode* mFirst;
+};
+
+/**
+   Leaf node whose keys and values are encoded within a single page, using the
+   format described at the bottom of this file.
+   
+   @author Vishal Parakh
+ */
+class LeafNode final: public Node {
+    struct EntryAt {
+        typedef std::pair<Buffer, Bytes> result_type;
+        
+        result_type operator()(std::size_t pos) const {
+            return std::make_pair(node->key(pos), node->value(pos));
+        }
+        
+        const LeafNode* node;
+    };
+    
+public:
+    typedef boost::transform_iterator<
+        EntryAt, boost::counting_iterator<std::size_t>> Iterator;
+    
+    explicit LeafNode(std::size_t pageSize = DEFAULT_PAGE_SIZE);
+    
+    Iterator begin() const { return iteratorAt(0); }
+    Iterator end()   const { return iteratorAt(size()); }
+    
+    Iterator find(Bytes key) const;
+    
+    /**
+       Returns a pair whose:
+       
+       .first => the position of the first entry whose key is not less than
+       (i.e. greater or equal to) key.
+       
+       .second => true if an exact match was found
+     */
+    std::pair<std::size_t, bool> lowerBound(Bytes key) const;
+    
+    /**
+       Starts loading the header of the page into the cache, without waiting
+       for it. The leaf doesn't need to be latched.
+     */
+    void prefetchHeader() const;
+    
+    /**
+       Starts loading the search vector into the cache. The header is read to
+       locate it, so it should be prefetched first. The leaf doesn't need to
+       be latched, since a header being changed only makes the prefetch miss.
+     */
+    void prefetchSearchVector() const;
+    
+    /**
+       Returns a copy of the key, because it might be stored without the node
+       key prefix
+     */
+    Buffer key(std::size_t pos) const;
+    
+    /**
+       Returns the value of an entry which isn't fragmented
+     */
+    Bytes value(std::size_t pos) const;
+    
+    /**
+       Returns the value of any entry, fragmented or not
+     */
+    LeafValue leafValue(std::size_t pos) const;
+    
+    /**
+       Returns true if a value of the given length is stored with a key of the
+       given length in its entry, the key being indirect if it doesn't fit
+       inline. Longer values must be fragmented first, to keep the leaves
+       from filling up with a few large entries.
+     */
+    bool fitsInline(std::size_t keyLen, std::size_t valueLen) const;
+    
+    /**
+       Leading bytes shared by the keys which are stored without them. The
+       prefix is chosen when the node is split.
+     */
+    Bytes keyPrefix() const;
+    
+    /**
+       Selects the key prefix of an empty node, for the keys inserted into it
+       later. Keys which don't start with the prefix are stored in full.
+     */
+    void keyPrefix(Bytes prefix);
+    
+    std::size_t maxKeyPrefixSize() const;
+    
+    /**
+       Bytes saved by storing keys without the key prefix, net of the space
+       used by the prefix itself
+     */
+    std::ptrdiff_t keyPrefixSavings() const;
+    
+    std::size_t size() const;
+    
+    bool empty() const { return size() == 0; }
+    
+    /**
+       Bytes in use by entries and the search vector, excluding garbage
+     */
+    std::size_t bytes() const { return capacity() - availableBytes(); }
+    
+    std::size_t capacity() const;
+    
+    std::size_t availableBytes() const;
+    
+    InsertResult insert(const NodeKey& key, const LeafValue& value);
+    
+    /**
+       Inserts at a position obtained from lowerBound, which must not have
+       found an exact match.
+     */
+    InsertResult insert(std::size_t pos, const NodeKey& key,
+                        const LeafValue& value);
+    
+    /**
+       Replaces the value of the existing entry at pos
+     */
+    InsertResult update(std::size_t pos, const LeafValue& value);
+    
+    /**
+       Returns true if the entry at pos is a ghost, whose value was deleted.
+       Its value is null.
+     */
+    bool isGhost(std::size_t pos) const;
+    
+    /**
+       Returns the number of ghost entries, which size() includes
+     */
+    std::size_t ghosts() const { return mGhosts; }
+    
+    /**
+       Returns the first fragment of the key at pos if it's stored
+       indirectly, otherwise null
+     */
+    FragmentNode* keyFragments(std::size_t pos) const;
+    
+    /**
+       Deletes the value of the entry at pos, which is left in place as a
+       ghost. The old value becomes garbage, and no other entry is moved.
+     */
+    void ghost(std::size_t pos);
+    
+    /**
+       Physically removes the ghosts at the given ascending positions,
+       compacting the node. The entries which follow each of them shift to
+       lower positions.
+     */
+    void removeGhosts(const std::vector<std::size_t>& positions);
+    
+    /**
+       Moves all the entries of right, the sibling holding the keys which
+       follow those of this node, to the end of this node, leaving right
+       empty. Returns false, leaving both nodes unchanged, if they don't fit.
+     */
+    bool merge(LeafNode& right);
+    
+    /**
+       Moves the entries nearest to right, the sibling holding the keys which
+       follow those of this node, out of the fuller of the two nodes until
+       both hold about the same number of bytes. Returns the number of
+       entries moved from right to this node, which is negative if they moved
+       the other way.
+     */
+    std::ptrdiff_t rebalance(LeafNode& right);
+    
+    void splitAndInsert(const NodeKey& key, const LeafValue& value,
+                        LeafNode& sibling,
+                        SplitPolicy policy = SplitPolicy::EVEN);
+    
+    void splitAndInsert(std::size_t pos, const NodeKey& key,
+                        const LeafValue& value, LeafNode& sibling,
+                        SplitPolicy policy = SplitPolicy::EVEN);
+    
+    void splitAndUpdate(std::size_t pos, const LeafValue& value,
+                        LeafNode& sibling);
+    
+    const Split<LeafNode>& split() const {
+        return *ptrCast<Split<LeafNode>>(&mSplit);
+    }
+    
+private:
+    Iterator iteratorAt(std::size_t pos) const {
+        return Iterator(boost::counting_iterator<std::size_t>(pos),
+                        EntryAt{this});
+    }
+    
+    void clearEntries();
+    
+    void compact(std::size_t updatePos, const LeafValue& value);
+    
+    /*
+      Inserts a copy of the entry at sourcePos of source, which keeps the
+      fragments of its key and value
+     */
+    InsertResult copyEntry(std::size_t pos, const LeafNode& source,
+                           std::size_t sourcePos);
+    
+    /*
+      Removes the entries at the given ascending positions, compacting the
+      node
+     */
+    void removeEntries(const std::vector<std::size_t>& positions);
+    
+    void removeEntries(std::size_t begin, std::size_t end);
+    
+    void countGhosts();
+    
+    std::size_t allocEntry(std::size_t pos, std::size_t entryLen, bool slot);
+    
+    void splitAndStore(std::size_t pos, bool replace, const NodeKey& key,
+                       const LeafValue& value, LeafNode& sibling,
+                       SplitPolicy policy);
+    
+    void rebuildHints();
+    
+    const std::size_t mPageSize;
+    
+    // Raw contents of node, which stays allocated for as long as the node
+    // does, since it can be read optimistically
+    std::unique_ptr<byte[]> mPage;
+    
+    // Hints of the keys, which skip the node key prefix
+    KeyHints mHints;
+    
+    // Number of consecutive inserts after the highest key if positive, or
+    // before the lowest key if negative
+    int mEdgeInserts;
+    
+    // Number of entries which are ghosts
+    std::size_t mGhosts;
+};
+
+/**
+   Internal node whose keys are encoded within a single page, using the format
+   described at the bottom of this file. Child node identifiers are packed
+   immediately after the search vector, and are 6 bytes long unless a child
+   requires 8. The width is recorded in the type stored in the page.
+   
+   Every key refers to a child whose keys are greater than or equal to it,
+   and the extra child holds the keys lower than the first key.
+   
+   @author Vishal Parakh
+ */
+class InternalNode final: public Node {
+public:
+    explicit InternalNode(Node& leftestChild,
+                          std::size_t pageSize = DEFAULT_PAGE_SIZE);
+    
+    /**
+       Constructs a node without any children, which is only suitable as the
+       sibling of a split.
+     */
+    explicit InternalNode(std::size_t pageSize = DEFAULT_PAGE_SIZE);
+    
+    /**
+       Number of keys, which is one less than the number of children
+     */
+    std::size_t size() const;
+    
+    bool empty() const { return size() == 0; }
+    
+    /**
+       Returns a copy of the key, because it might be stored indirectly
+     */
+    Buffer key(std::size_t pos) const;
+    
+    Node* child(std::size_t pos) const;
+    
+    /**
+       Returns a pair whose:
+       
+       .first => the position of the first key that is not less than (i.e.
+       greater or equal to) key.
+       
+       .second => true if an exact match was found
+     */
+    std::pair<std::size_t, bool> lowerBound(Bytes key) const;
+    
+    /**
+       Returns the position of the child whose range of keys includes key
+     */
+    std::size_t childPos(Bytes key) const;
+    
+    /**
+       Returns the child whose range of keys includes key, without the node
+       being latched. The result is only valid if the node's version is
+       validated afterwards. Returns null if the page was seen in an
+       inconsistent state, or if finding the child requires reading a key
+       which is stored indirectly.
+     */
+    Node* optimisticChild(Bytes key) const;
+    
+    /**
+       Like optimisticChild, and also sets highKey to the key which follows
+       the child, which all the keys of the child are less than. highKey is
+       left null for the last child. It refers to the page, so it's only
+       valid until the version is validated, like the child.
+     */
+    Node* optimisticChild(Bytes key, Bytes& highKey) const;
+    
+    /**
+       Starts loading the header of the page into the cache, without waiting
+       for it. Interleaved lookups prefetch ahead of searching the node.
+     */
+    void prefetchHeader() const;
+    
+    /**
+       Starts loading the search vector and the child identifiers into the
+       cache. The header is read to locate them, so it should be prefetched
+       first.
+     */
+    void prefetchSearchVector() const;
+    
+    std::size_t bytes() const { return capacity() - availableBytes(); }
+    
+    std::size_t capacity() const;
+    
+    std::size_t availableBytes() const;
+    
+    /**
+       Inserts key, and the child holding the keys greater than or equal to
+       it.
+     */
+    InsertResult insert(const NodeKey& key, Node& child);
+    
+    /**
+       Inserts key at keyPos, and child on the given side of it. For a child
+       which split, keyPos is the position of the child that split, key is the
+       split key and side is the direction of the new sibling.
+     */
+    InsertResult insert(std::size_t keyPos, const NodeKey& key, Node& child,
+                        SiblingDirection side);
+    
+    void splitAndInsert(std::size_t keyPos, const NodeKey& key, Node& child,
+                        SiblingDirection side, InternalNode& sibling);
+    
+    /**
+       Returns the first fragment of the key at pos if it's stored
+       indirectly, otherwise null
+     */
+    FragmentNode* keyFragments(std::size_t pos) const;
+    
+    /**
+       Replaces the key at pos, which must keep its order relative to the
+       other keys
+     */
+    InsertResult replaceKey(std::size_t pos, const NodeKey& key);
+    
+    /**
+       Removes the key at pos and the child which follows it
+     */
+    void remove(std::size_t pos);
+    
+    /**
+       Moves separator, the key between this node and right in their parent,
+       and all the keys and children of right to the end of this node.
+       Returns false, leaving both nodes unchanged, if they don't fit. Right
+       is left unchanged, to be discarded along with the separator.
+     */
+    bool merge(const NodeKey& separator, const InternalNode& right);
+    
+    /**
+       Moves the children nearest to right out of the fuller of the two
+       nodes until both hold about the same number of bytes. Keys pass
+       through separator, which is replaced by the key stored into
+       newSeparator and newSeparatorFragments. Returns the number of children
+       moved from right to this node, which is negative if they moved the
+       other way, or 0 if nothing changed.
+     */
+    std::ptrdiff_t rebalance(const NodeKey& separator, InternalNode& right,
+                             Buffer& newSeparator,
+                             FragmentNode*& newSeparatorFragments);
+    
+    const Split<InternalNode>& split() const {
+        return *ptrCast<Split<InternalNode>>(&mSplit);
+    }
+    
+private:
+    struct KeySource;
+    
+    Node* optimisticChild(Bytes key, Bytes* highKey) const;
+    
+    std::size_t allocEntry(std::size_t keyPos, std::size_t childPos,
+                           std::size_t entryLen);
+    
+    /*
+      Appends sources of all the keys and the children of this node
+     */
+    void appendContents(std::vector<KeySource>& keys,
+                        std::vector<Node*>& children) const;
+    
+    /*
+      Replaces the contents of this node with the given keys and the
+      children surrounding them. Returns false, leaving the node unchanged,
+      if they don't fit.
+     */
+    bool rebuild(const std::vector<KeySource>& keys,
+                 const std::vector<Node*>& children);
+    
+    void widenChildIds();
+    
+    void rebuildHints();
+    
+    void replacePage(const byte* page);
+    
+    const std::size_t mPageSize;
+    
+    // Raw contents of node, which stays allocated for as long as the node
+    // does, since it can be read optimistically
+    std::unique_ptr<byte[]> mPage;
+    
+    // Hints of the keys, which skip the prefix shared by the first and last
+    // keys when the hints were last rebuilt
+    KeyHints mHints;
 };
 
 /*
@@ -135,7 +759,7 @@ public:
 
   +----------------------------------------+
   | byte:   node type                      |  header
-  | byte:   reserved (must be 0)           |
+  | byte:   key prefix length              |
   | ushort: garbage in segments            |
   | ushort: pointer to left segment tail   |
   | ushort: pointer to right segment tail  |
@@ -200,20 +824,46 @@ public:
   0b0pxx_xxxx: key is 1..64 bytes 0b1pxx_xxxx: key is 0..16383 bytes
 
   When the 'p' bit is zero, the entry is a normal key. Otherwise, it indicates
-  that the key starts with the node key prefix.
+  that the key starts with the node key prefix, and only the remaining bytes
+  are encoded. The length in the header excludes the prefix.
+  
+  The node key prefix is stored at the start of the left segment, and its
+  length (0..255) is the second header byte. The segment tail begins after
+  it. Keys which don't start with the prefix are stored in full, and internal
+  nodes have no prefix.
 
   For keys 1..64 bytes in length, the length is defined as ((header & 0x3f) +
   1). For keys 0..16383 bytes in length, a second header byte is used. The
   second byte is unsigned, and the length is defined as (((header & 0x3f) << 8)
   | header2). The key contents immediately follow the header byte(s).
 
+  Keys too long to be stored inline are stored indirectly, in a chain of
+  fragment nodes. Their two byte header has the 'p' bit clear and encodes the
+  length 16383, which inline keys never reach, and it is followed by:
+
+  +----------------------------------------+
+  | ushort: length of inline key bytes     |
+  | ulong:  key length                     |
+  | ulong:  identifier of first fragment   |
+  | bytes:  leading bytes of the key       |
+  +----------------------------------------+
+
+  The fragments hold the whole key, but they are only read when the leading
+  bytes are not enough to order a key against the search key.
+
   The value follows the key, and its header encodes the entry length:
 
   0b0xxx_xxxx: value is 0..127 bytes 0b1f0x_xxxx: value/entry is 1..8192 bytes
   0b1f10_xxxx: value/entry is 1..1048576 bytes 0b1111_1111: ghost value (null)
 
   When the 'f' bit is zero, the entry is a normal value. Otherwise, it is a
-  fragmented value, defined by Database.fragment.
+  fragmented value, stored out of line in a chain of fragment nodes. The
+  entry of a fragmented value always uses the two byte header, and holds:
+
+  +----------------------------------------+
+  | ulong:  value length                   |
+  | ulong:  identifier of first fragment   |
+  +----------------------------------------+
 
   For entries 1..8192 bytes in length, a second header byte is used. The length
   is then defined as ((((h0 & 0x1f) << 8) | h1) + 1). For larger entries, the
@@ -223,14 +873,33 @@ public:
   The "values" for internal nodes are actually identifiers for child nodes. The
   number of child nodes is always one more than the number of keys. For this
   reason, the key-value format used by leaf nodes cannot be applied to internal
-  nodes. Also, the identifiers are always a fixed length, ulong type.
+  nodes. Also, the identifiers are a fixed length: six bytes, or a ulong when
+  the node sub type selects 8 byte pointers. Nodes use six bytes whenever all
+  of their children fit, and switch to eight bytes when one doesn't.
 
   Child node identifiers are encoded immediately following the search
   vector. Free space management must account for this, treating it as an
   extension to the search vector.
 
+  Fragment nodes hold consecutive parts of a fragmented value or of an
+  indirect key, each one referring to the node holding the next part:
+
+  +----------------------------------------+
+  | byte:   node type                      |  header
+  | byte:   reserved (must be 0)           |
+  | ushort: length of value part           |
+  | ulong:  identifier of next fragment    |
+  +----------------------------------------+
+  | value part                             |
+  -                                        -
+  |                                        |
+  +----------------------------------------+
+
+  The identifier of the next fragment is zero in the last node of a chain.
+
 */
 
-} } } // namespace tupl::pvt::disabled
 
-#endif 
+} } // namespace tupl::pvt
+
+#endif
@@ -0,0 +1,250 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+ 
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "Tree.hpp"
+
+#include "make_unique.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+namespace tupl { namespace pvt {
+
+namespace {
+
+/*
+  Gives the ownership of node to the nodes of the tree
+ */
+template<typename NodeT>
+NodeT* addNode(std::vector<std::unique_ptr<NodeT>>& nodes,
+               std::unique_ptr<NodeT> node)
+{
+    const auto raw = node.get();
+    
+    raw->treeSlot = nodes.size();
+    nodes.emplace_back(std::move(node));
+    
+    return raw;
+}
+
+/*
+  Takes the ownership of node away from the nodes of the tree. The last node
+  moves into its slot.
+ */
+template<typename NodeT>
+std::unique_ptr<NodeT> takeNode(std::vector<std::unique_ptr<NodeT>>& nodes,
+                                NodeT* const node)
+{
+    const std::size_t slot = node->treeSlot;
+    
+    assert(slot < nodes.size() && nodes[slot].get() == node);
+    
+    std::unique_ptr<NodeT> taken = std::move(nodes[slot]);
+    
+    if (slot + 1 != nodes.size()) {
+        nodes[slot] = std::move(nodes.back());
+        nodes[slot]->treeSlot = slot;
+    }
+    
+    nodes.pop_back();
+    
+    return taken;
+}
+}
+
+Tree::Tree(const std::size_t pageSize, const SplitPolicy splitPolicy) :
+    mPageSize(pageSize), mSplitPolicy(splitPolicy)
+{
+    const auto leaf =
+        addNode(mLeafNodes, std::make_unique<LeafNode>(mPageSize));
+    const auto internal = addNode(
+        mInternalNodes, std::make_unique<InternalNode>(*leaf, mPageSize));
+    
+    root.store(internal, std::memory_order_release);
+}
+
+Tree::Stats Tree::stats() {
+    Stats stats = Stats();
+    stats.splitPolicy = mSplitPolicy;
+    
+    // Nodes are latched only after mNodesLatch is released, since writers
+    // allocate and retire nodes while holding node latches. The guard keeps
+    // the nodes retired meanwhile from being deleted.
+    Epochs::Guard guard(mEpochs);
+    
+    std::vector<LeafNode*> leaves;
+    std::vector<InternalNode*> internals;
+    
+    {
+        Latch::scoped_shared_lock sharedLock(mNodesLatch);
+        
+        leaves.reserve(mLeafNodes.size());
+        for (const auto& leaf : mLeafNodes) { leaves.push_back(leaf.get()); }
+        
+        internals.reserve(mInternalNodes.size());
+        for (const auto& internal : mInternalNodes) {
+            internals.push_back(internal.get());
+        }
+        
+        stats.fragmentNodes =
+            mFragmentNodes.size() - mFreeFragmentNodes.size();
+    }
+    
+    std::size_t leafCapacity = 0;
+    
+    for (const auto leaf : leaves) {
+        Latch::scoped_shared_lock leafLock(*leaf);
+        
+        const std::size_t ghosts = leaf->ghosts();
+        
+        ++stats.leafNodes;
+        stats.entries += leaf->size() - ghosts;
+        stats.ghostEntries += ghosts;
+        stats.leafBytes += leaf->bytes();
+        stats.keyPrefixSavings += leaf->keyPrefixSavings();
+        leafCapacity += leaf->capacity();
+    }
+    
+    stats.leafFillFactor = double(stats.leafBytes) / leafCapacity;
+    
+    for (const auto internal : internals) {
+        Latch::scoped_shared_lock internalLock(*internal);
+        
+        ++stats.internalNodes;
+        stats.internalBytes += internal->bytes();
+    }
+    
+    // All leaves are at the same depth
+    for (const Node* node = root.load(std::memory_order_acquire); ; ) {
+        ++stats.height;
+        
+        if (node->isLeaf()) { break; }
+        
+        Latch::scoped_shared_lock nodeLock(*const_cast<Node*>(node));
+        node = static_cast<const InternalNode*>(node)->child(0);
+    }
+    
+    return stats;
+}
+
+LeafNode* Tree::allocateLeaf() {
+    auto newLeaf = std::make_unique<LeafNode>(mPageSize);
+    
+    std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+    return addNode(mLeafNodes, std::move(newLeaf));
+}
+
+InternalNode* Tree::allocateInternal(Node& leftestChild) {
+    auto newInternal = std::make_unique<InternalNode>(leftestChild, mPageSize);
+    
+    std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+    return addNode(mInternalNodes, std::move(newInternal));
+}
+
+InternalNode* Tree::allocateInternal() {
+    auto newInternal = std::make_unique<InternalNode>(mPageSize);
+    
+    std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+    return addNode(mInternalNodes, std::move(newInternal));
+}
+
+FragmentNode* Tree::allocateFragment() {
+    std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+    
+    if (!mFreeFragmentNodes.empty()) {
+        const auto fragment = mFreeFragmentNodes.back();
+        mFreeFragmentNodes.pop_back();
+        return fragment;
+    }
+    
+    mFragmentNodes.emplace_back(std::make_unique<FragmentNode>(mPageSize));
+    
+    return mFragmentNodes.back().get();
+}
+
+FragmentNode* Tree::fragment(const Bytes data) {
+    assert(data.size() > 0);
+    
+    // The parts are written from last to first, so that each one can refer
+    // to the part following it
+    FragmentNode* node = allocateFragment();
+    const std::size_t capacity = node->capacity();
+    
+    std::size_t offset = (data.size() - 1) / capacity * capacity;
+    FragmentNode* next = nullptr;
+    
+    for (;;) {
+        node->assign(Bytes{data.data() + offset,
+                           std::min(capacity, data.size() - offset)}, next);
+        
+        if (offset == 0) { break; }
+        
+        offset -= capacity;
+        next = node;
+        node = allocateFragment();
+    }
+    
+    return node;
+}
+
+NodeKey Tree::nodeKey(const Bytes key) {
+    return keyFitsInline(key.size(), mPageSize) ?
+        NodeKey(key) : NodeKey(key, *fragment(key));
+}
+
+LeafValue Tree::leafValue(const LeafNode& leaf, const Bytes key,
+                          const Bytes value)
+{
+    return leaf.fitsInline(key.size(), value.size()) ?
+        LeafValue(value) : LeafValue(value.size(), *fragment(value));
+}
+
+void Tree::releaseFragments(FragmentNode* const first) {
+    std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+    
+    for (FragmentNode* node = first; node; ) {
+        FragmentNode* const next = node->next();
+        
+        node->assign(Bytes{}, nullptr);
+        mFreeFragmentNodes.push_back(node);
+        
+        node = next;
+    }
+}
+
+void Tree::retire(LeafNode* const leaf) {
+    std::unique_ptr<LeafNode> retired;
+    
+    {
+        std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+        retired = takeNode(mLeafNodes, leaf);
+    }
+    
+    mEpochs.retire(std::move(retired));
+}
+
+void Tree::retire(InternalNode* const internal) {
+    std::unique_ptr<InternalNode> retired;
+    
+    {
+        std::lock_guard<Latch> exclusiveLock(mNodesLatch);
+        retired = takeNode(mInternalNodes, internal);
+    }
+    
+    mEpochs.retire(std::move(retired));
+}
+
+} }
@@ -19,9 +19,13 @@
 #define _TUPL_PVT_TREE_HPP
 
 #include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
 
-// TODO: clean this up and make the Node a proper duck-type
-#include "slow/Node.hpp"
+#include "Epochs.hpp"
+#include "Latch.hpp"
+#include "Node.hpp"
 
 namespace tupl { namespace pvt {
 
@@ -31,6 +35,50 @@ namespace tupl { namespace pvt {
   @author Vishal Parakh
  */
 class Tree final {
+public:
+    /**
+       Snapshot of the space used by the nodes of a Tree
+     */
+    struct Stats {
+        // Number of levels, including the root and the leaves
+        std::size_t height;
+        
+        std::size_t leafNodes;
+        std::size_t internalNodes;
+        std::size_t entries;
+        
+        // Deleted entries which are not removed yet, excluded from entries
+        std::size_t ghostEntries;
+        
+        // Bytes in use by entries, search vectors and child identifiers
+        std::size_t leafBytes;
+        std::size_t internalBytes;
+        
+        // Net bytes saved by storing leaf keys without the node key prefix
+        std::ptrdiff_t keyPrefixSavings;
+        
+        // Nodes holding parts of fragmented values, excluding released ones
+        std::size_t fragmentNodes;
+        
+        SplitPolicy splitPolicy;
+        
+        // Fraction of the leaf capacity in use
+        double leafFillFactor;
+    };
+    
+    explicit Tree(std::size_t pageSize = Node::DEFAULT_PAGE_SIZE,
+                  SplitPolicy splitPolicy = SplitPolicy::ADAPTIVE);
+    
+    Tree(const Tree&) = delete;
+    Tree& operator=(const Tree&) = delete;
+    
+    /**
+       Counts are exact when no writers run. Otherwise, nodes are visited one
+       at a time and the totals only approximate the tree.
+     */
+    Stats stats();
+    
+private:
     /*
       Represents a B+Tree. Based on and compatible with the original Tupl Java
       implementation.
@@ -38,9 +86,10 @@ class Tree final {
       The present implementation treat splits differently than the Java
       implemenation. Specifically:
       
-      1. The root is never split, if the root overflows it the height of the
-         tree is immediately increased without releasing the root node
-         exclusive latch.
+      1. The root never keeps a pending split, if the root overflows the
+         height of the tree is immediately increased without releasing the
+         root node exclusive latch. A new root becomes the parent of the old
+         root and its sibling.
          
       2. Split nodes are repaired on first contact, never followed.
       
@@ -51,8 +100,73 @@ class Tree final {
       split or saving a reference to it for future cleanup.
     */
     
-    std::atomic<slow::InternalNode*> root;
+    std::atomic<InternalNode*> root;
+    
+    LeafNode* allocateLeaf();
+    
+    InternalNode* allocateInternal(Node& leftestChild);
+    
+    /**
+       Allocates an internal node without any children, to become the
+       sibling of a split
+     */
+    InternalNode* allocateInternal();
+    
+    FragmentNode* allocateFragment();
+    
+    /**
+       Copies data into a new chain of fragment nodes, and returns the first
+       one
+     */
+    FragmentNode* fragment(Bytes data);
+    
+    /**
+       Returns the key to store in nodes, which is copied into a new chain of
+       fragment nodes if it doesn't fit inline
+     */
+    NodeKey nodeKey(Bytes key);
+    
+    /**
+       Returns the value to store with key in an entry of leaf. Values which
+       don't fit inline are copied into a new chain of fragment nodes.
+     */
+    LeafValue leafValue(const LeafNode& leaf, Bytes key, Bytes value);
+    
+    /**
+       Releases a chain of fragment nodes which is no longer referenced, for
+       reuse by later keys and values. A null chain is ignored.
+     */
+    void releaseFragments(FragmentNode* first);
+    
+    /**
+       Removes a node which a merge or a root collapse took out of the tree.
+       The node is only deleted once no epoch guard which could have seen it
+       is left, because a thread might still be reading it optimistically,
+       or be about to latch it through a frame which it read before the frame
+       was moved. Callers hold no node latch, since this takes mNodesLatch.
+     */
+    void retire(LeafNode* leaf);
+    void retire(InternalNode* internal);
+    
+    const std::size_t mPageSize;
+    const SplitPolicy mSplitPolicy;
+    
+    // Owns all the nodes of the tree, guarded by mNodesLatch
+    Latch mNodesLatch;
+    std::vector<std::unique_ptr<LeafNode>>           mLeafNodes;
+    std::vector<std::unique_ptr<InternalNode>> mInternalNodes;
+    std::vector<std::unique_ptr<FragmentNode>> mFragmentNodes;
+    
+    // Released fragment nodes, guarded by mNodesLatch
+    std::vector<FragmentNode*> mFreeFragmentNodes;
+    
+    // Nodes removed from the tree are deleted once the threads which could
+    // still access them are gone. Operations which access nodes without
+    // holding a latch on their parent hold a guard.
+    Epochs mEpochs;
+    
     friend class ops;
+    friend class BulkLoader;
 };
 
 } }
@@ -0,0 +1 @@
+#include "Write.hpp"
@@ -0,0 +1,42 @@
+/*
+  Copyright (C) 2014      Vishal Parakh
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+  http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#ifndef _TUPL_PVT_WRITE_HPP
+#define _TUPL_PVT_WRITE_HPP
+
+#include "../types.hpp"
+
+namespace tupl { namespace pvt {
+
+/**
+   Entry of a batch of writes, which stores value with key, or deletes the
+   entry of key if value is null. Unlike a Cursor, a write keeps no position
+   once it's applied.
+   
+   @author Vishal Parakh
+ */
+struct Write final {
+    Write() : key(), value() {}
+    
+    Write(const Bytes key, const Bytes value) : key(key), value(value) {}
+    
+    Bytes key;   // Owned by the caller
+    Bytes value; // Owned by the caller, null to delete
+};
+
+} }
+
+#endif
@@ -2,15 +2,19 @@
 
 #include "Cursor.hpp"
 #include "CursorFrame.hpp"
+#include "Epochs.hpp"
 #include "Latch.hpp"
+#include "Lookup.hpp"
+#include "Node.hpp"
 #include "Tree.hpp"
-
-#include "slow/Node.hpp"
+#include "Write.hpp"
 
 #include <algorithm>
 #include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
-using namespace tupl::pvt::slow;
 using std::size_t;
 
 #include "ArrayStackGeneric.ii"
@@ -20,253 +24,2523 @@ namespace tupl { namespace pvt {
 namespace {
 
 /*
-  Returns a iterator to the child node where key should be 
- */ 
-Node* findChildNode(InternalNode& node, Bytes key) {
-    return node.lowerBound(key)->second;
+  Returns the position of the child node where key should be
+ */
+size_t findChildNode(const InternalNode& node, const Bytes key) {
+    return node.childPos(key);
+}
+
+bool isSplit(const Node* const node) {
+    return node->hasSibling();
+}
+
+bool isFound(const Bytes notFoundKey) {
+    return notFoundKey.data() == nullptr;
+}
+
+bool isDelete(const Bytes value) {
+    return value.data() == nullptr;
+}
+
+/*
+  Nodes filled to less than a quarter of their capacity are merged with a
+  sibling, or take entries from it
+ */
+template<typename NodeT>
+bool isUnderflow(const NodeT& node) {
+    return node.bytes() < node.capacity() / 4;
+}
+
+bool isUnderflow(const Node& node) {
+    return node.isLeaf() ?
+        isUnderflow(static_cast<const LeafNode&>(node)) :
+        isUnderflow(static_cast<const InternalNode&>(node));
 }
 
-struct FindValueResult {
-    Bytes value() {
-        assert(false);
-        return {};
+/*
+  Returns true if the value of an entry has the same bytes as expected
+ */
+bool equals(const LeafValue& value, const Bytes expected) {
+    if (value.isGhost() || value.length() != expected.size()) { return false; }
+
+    if (!value.isFragmented()) {
+        const Bytes bytes = value.bytes();
+        return std::equal(bytes.data(), bytes.data() + bytes.size(),
+                          expected.data());
     }
 
-    bool found() { return false; }
-};
+    Buffer assembled;
+    value.appendTo(assembled);
 
-FindValueResult findValue(Tree& t, LeafNode& node, Bytes key) {
-    throw std::logic_error("unimplemented");
+    return std::equal(assembled.begin(), assembled.end(), expected.data());
 }
 
-bool isLeaf(const Node* const node) {
-    return node->type() == NodeType::LEAF;
+size_t nodeBytes(const Node& node) {
+    return node.isLeaf() ?
+        static_cast<const LeafNode&>(node).bytes() :
+        static_cast<const InternalNode&>(node).bytes();
 }
 
-bool isSplit(const Node* const node) {
-    return false;
+/*
+  Optimistic lookups which keep conflicting with writers fall back to
+  latching, which can't be starved
+ */
+const size_t MAX_OPTIMISTIC_ATTEMPTS = 4;
+
+/*
+  Lookups of findInterleaved in flight at once. Enough of them overlap their
+  cache misses to keep the memory system busy, without evicting the nodes
+  which were prefetched before they're read.
+ */
+const size_t INTERLEAVED_LOOKUPS = 8;
+
+/*
+  Starts loading the object at address into the cache, without waiting for
+  it to arrive
+ */
+void prefetch(const void* const address) {
+#if defined(__GNUC__)
+    __builtin_prefetch(address);
+#else
+    (void) address;
+#endif
+}
+
+bool equalKeys(const Bytes l, const Bytes r) {
+    return l.size() == r.size() && std::equal(l.data(), l.data() + l.size(),
+                                              r.data());
+}
+
+/*
+  Returns the position of child in node, or one past the last child if it's
+  not a child of node
+ */
+size_t positionOf(const InternalNode& node, const Node* const child) {
+    for (size_t pos = 0; pos <= node.size(); ++pos) {
+        if (node.child(pos) == child) { return pos; }
+    }
+
+    return node.size() + 1;
+}
+
+/*
+  Returns true if key falls within the keys of node, which makes it part of
+  the range of keys of node. The bounds of the range aren't known, so keys
+  beyond the first or the last key are left to a node higher up.
+ */
+template<typename NodeT>
+bool isWithinKeys(const NodeT& node, const Bytes key) {
+    const auto result = node.lowerBound(key);
+    return result.second || (result.first > 0 && result.first < node.size());
+}
+
+bool isWithinKeys(const Node& node, const Bytes key) {
+    return node.isLeaf() ?
+        isWithinKeys(static_cast<const LeafNode&>(node), key) :
+        isWithinKeys(static_cast<const InternalNode&>(node), key);
+}
+
+}
+
+/**
+  Latches the root node. The root can be replaced by a root collapse until the
+  latch is acquired, which is why the root is checked again.
+*/
+template<typename Lock>
+Lock ops::latchRoot(Tree& tree) {
+    for (;;) {
+        InternalNode* const root = tree.root.load(std::memory_order_acquire);
+        Lock rootLock(*root);
+
+        if (tree.root.load(std::memory_order_acquire) == root) {
+            return rootLock;
+        }
+    }
+}
+
+/**
+  Latches the node that the frame is bound to. The frame can be moved to
+  another node until the latch is acquired, which is why the binding is
+  checked again. Returns a lock which doesn't hold any latch if the frame was
+  bound to a root which collapsed.
+*/
+template<typename Lock>
+Lock ops::latchFrameNode(CursorFrame& frame) {
+    for (;;) {
+        Node* const node = frame.node();
+
+        if (!node) { return Lock(); }
+
+        Lock nodeLock(*node);
+
+        if (frame.node() == node) { return nodeLock; }
+    }
+}
+
+/**
+  The node only needs to be latched shared, since binding frames is also
+  guarded by the node's visitorFramesLatch.
+
+  pre-conditions:  node is latched
+  post-conditions: node is latched
+*/
+void ops::bindFrame(Cursor& visitor, Node& node,
+                    const size_t position, const Bytes notFoundKey)
+{
+    CursorFrame* const parentFrame = visitor.stackFrames.empty() ?
+        nullptr : &visitor.stackFrames.top();
+
+    visitor.stackFrames.emplaceBack();
+
+    auto& frame = visitor.stackFrames.top();
+    frame.parentFrame = parentFrame;
+    frame.mNode.store(&node, std::memory_order_release);
+    frame.position = position;
+    frame.notFoundKey = notFoundKey;
+
+    std::lock_guard<Latch> framesLock(node.visitorFramesLatch);
+    node.visitorFrames.push_back(frame);
+}
+
+void ops::unbindFrame(CursorFrame& frame) {
+    // Frames are only moved to other nodes under exclusive latches
+    const auto nodeLock = latchFrameNode<Latch::scoped_shared_lock>(frame);
+
+    // Frames of a root which collapsed were unbound along with it
+    if (!nodeLock.owns_lock()) { return; }
+
+    const auto node = frame.node();
+
+    std::lock_guard<Latch> framesLock(node->visitorFramesLatch);
+    node->visitorFrames.erase(node->visitorFrames.s_iterator_to(frame));
 }
 
-template<typename T>
-typename std::make_unsigned<T>::type makeUnsigned(const T& src) {
-    return src;
+void ops::unbindFrames(Cursor& visitor) {
+    if (!visitor.tree) { return; }
+
+    // A frame can be moved away from its node, which is then retired, until
+    // the node is latched
+    const Epochs::Guard guard(visitor.tree->mEpochs);
+
+    unwindFrames(visitor);
+    visitor.tree = nullptr;
 }
 
+/**
+  pre-conditions:  an epoch guard is held
+*/
+void ops::unwindFrames(Cursor& visitor) {
+    auto& stackFrames = visitor.stackFrames;
+
+    while (!stackFrames.empty()) {
+        unbindFrame(stackFrames.top());
+        stackFrames.pop();
+    }
 }
 
-Latch::scoped_exclusive_lock ops::unwindAndLockRoot(Tree& tree, Cursor& visitor)
+/**
+  Unbinds the frames of the cursor from the bottom up, until one is bound to
+  a node whose keys key falls within, where a search for key can resume. That
+  frame is unbound too, and its node is returned latched by the lock, which
+  doesn't hold any latch if no frame qualified.
+
+  Nodes with a pending split are skipped, since the search would have to
+  repair it first.
+
+  pre-conditions:  an epoch guard is held
+  post-conditions: node is latched by the returned lock, if it holds a latch
+*/
+Latch::scoped_shared_lock ops::unwindToCover(Cursor& visitor, const Bytes key,
+                                             Node*& node)
 {
     auto& stackFrames = visitor.stackFrames;
-    
-    const size_t numFrames = stackFrames.size();
-    
-    for (size_t i = 1; i < numFrames; ++i) {
+
+    while (!stackFrames.empty()) {
         auto& frame = stackFrames.top();
-        // FIXME: abstract this better
-        const auto node = frame.node();
-        auto toEraseIt = node->visitorFrames.s_iterator_to(frame); // s => static
+        auto nodeLock = latchFrameNode<Latch::scoped_shared_lock>(frame);
+
+        if (!nodeLock.owns_lock()) {
+            stackFrames.pop();
+            continue;
+        }
+
+        node = frame.node();
+
         {
-            Latch::scoped_exclusive_lock nodeLock(*node);
-            node->visitorFrames.erase(toEraseIt);
+            std::lock_guard<Latch> framesLock(node->visitorFramesLatch);
+            node->visitorFrames.erase(node->visitorFrames.s_iterator_to(frame));
         }
+
         stackFrames.pop();
+
+        if (!isSplit(node) && isWithinKeys(*node, key)) { return nodeLock; }
     }
-    
-    auto& frame = stackFrames.top();
-    const auto stackRoot = frame.node();
-    auto toEraseIt = stackRoot->visitorFrames.s_iterator_to(frame);
-    
-    Latch::scoped_exclusive_lock rootLock(*stackRoot);
-    stackRoot->visitorFrames.erase(toEraseIt);
-    stackFrames.pop();
-    
-    //FIXME: Deal with changing height by making this a "circular" stack
-    const auto root = tree.root.load(std::memory_order_acquire);
-    
-    if (stackRoot != root) {
-        rootLock = std::move(Latch::scoped_exclusive_lock(*root));
-    }
-    
-    return rootLock;
-}
-
-void ops::bubbleSplitUpOneLevel(Tree& t, Node& splitNodeParent, Node& splitNode)
+
+    return Latch::scoped_shared_lock();
+}
+
+/**
+  Moves a frame to position in another node.
+
+  pre-conditions:  Both nodes are latched
+  post-conditions: Both nodes are latched
+*/
+void ops::rebindFrame(CursorFrame& frame, Node& node, const size_t position)
 {
-    throw std::logic_error("unimplemented");
+    Node* const source = frame.node();
+
+    frame.position = position;
+    frame.mNode.store(&node, std::memory_order_release);
+
+    node.visitorFrames.splice(node.visitorFrames.end(), source->visitorFrames,
+                              source->visitorFrames.s_iterator_to(frame));
 }
 
-void ops::find(Tree& tree, Cursor& visitor, Bytes key) {
-    // TODO: pre-conditions and post-conditions on these guys in
-    //       the face of failure would be nice to have
-    visitor.key = Buffer{key.data(), key.size()};
-    // visitor.value = Bytes{};
-    
-    // Restore the cursor to the root
-    Latch::scoped_exclusive_lock parentLock;
-    
-    if (visitor.stackFrames.empty()) {
-        parentLock = std::move(Latch::scoped_exclusive_lock(
-                                   *tree.root.load(std::memory_order_acquire)));
-    } else {
-        parentLock = unwindAndLockRoot(tree, visitor);
-    }        
-    
-    Node* node = tree.root;
-    assert(node);
-    
-    while (!isLeaf(node)) {
-        const auto in = static_cast<InternalNode*>(node);        
-        auto const childNode = findChildNode(*in, key);
-        
+/**
+  Positions the parent frame of a frame which moved to the child of parent at
+  childPos. Parent frames bound to another node are left alone.
+
+  pre-conditions:  parent is latched
+  post-conditions: parent is latched
+*/
+void ops::rebindParentFrame(CursorFrame& frame, InternalNode& parent,
+                            const size_t childPos)
+{
+    CursorFrame* const parentFrame = frame.parentFrame;
+
+    if (parentFrame && parentFrame->node() == &parent) {
+        parentFrame->position = childPos;
+    }
+}
+
+/**
+  Adjusts the positions of the frames bound to node after the child at
+  childPos was removed, along with the key before it. Frames of the removed
+  child now refer to the child before it, which it was merged into.
+
+  pre-conditions:  node is latched
+  post-conditions: node is latched
+*/
+void ops::removeChildFrames(InternalNode& node, const size_t childPos) {
+    for (auto& frame : node.visitorFrames) {
+        if (frame.position >= childPos) { --frame.position; }
+    }
+}
+
+/**
+  Unbinds all the frames of the cursor and latches the root. The bottom frame
+  isn't bound to the root anymore once the height of the tree changed, since
+  the root collapsed or a new root was added above it, so the frames are
+  bound again from the root down.
+*/
+template<typename Lock>
+Lock ops::unwindAndLockRoot(Tree& tree, Cursor& visitor) {
+    unwindFrames(visitor);
+    return latchRoot<Lock>(tree);
+}
+
+void ops::reset(Cursor& visitor) {
+    unbindFrames(visitor);
+
+    visitor.key.clear();
+    visitor.value.clear();
+    visitor.hasValue = false;
+}
+
+bool ops::hasValue(const Cursor& visitor) {
+    return visitor.hasValue;
+}
+
+Bytes ops::key(const Cursor& visitor) {
+    return Bytes{visitor.key.data(), visitor.key.size()};
+}
+
+/**
+  Returns the value of the entry which the cursor is positioned at, which is
+  null if the key was not found. It's only valid until the cursor moves.
+*/
+Bytes ops::value(const Cursor& visitor) {
+    return visitor.hasValue ?
+        Bytes{visitor.value.data(), visitor.value.size()} : Bytes{};
+}
+
+/**
+  Inserts the sibling of a node with a pending split into its parent, and
+  forgets the split. A parent which is full splits in turn, and a root which
+  splits gets a new root above it right away, growing the tree by a level.
+  Returns true if the parent split, after which the keys it covered are
+  shared with its sibling.
+
+  Frames bound to the parent keep referring to the same children, moving to
+  the sibling of the parent along with them. Frames which the split moved to
+  the sibling of the node get their parent frame positioned at the sibling.
+
+  pre-conditions:  parent and node are latched exclusively, and parent has no
+                   pending split
+  post-conditions: parent and node are latched exclusively
+*/
+bool ops::bubbleSplitUpOneLevel(Tree& t, InternalNode& parent, Node& node)
+{
+    const auto& split = node.split();
+    Node& sibling = *split.sibling;
+
+    // Cursors whose frames were moved to the sibling can latch it before the
+    // parent refers to it
+    Latch::scoped_exclusive_lock siblingLock(sibling);
+
+    const size_t nodePos = findChildNode(parent, split.key);
+    assert(parent.child(nodePos) == &node);
+
+    // The parent takes over the fragments of a key which an internal node
+    // stored indirectly
+    const NodeKey key = split.keyFragments ?
+        NodeKey(split.key, *split.keyFragments) : t.nodeKey(split.key);
+
+    std::vector<std::pair<CursorFrame*, const Node*>> parentFrames;
+
+    for (auto& frame : parent.visitorFrames) {
+        parentFrames.emplace_back(&frame, parent.child(frame.position));
+    }
+
+    InternalNode* parentSibling = nullptr;
+    Latch::scoped_exclusive_lock parentSiblingLock;
+
+    if (parent.insert(nodePos, key, sibling, split.direction) ==
+        InsertResult::FAILED_NO_SPACE)
+    {
+        parentSibling = t.allocateInternal();
+        parentSiblingLock = Latch::scoped_exclusive_lock(*parentSibling);
+        parent.splitAndInsert(nodePos, key, sibling, split.direction,
+                              *parentSibling);
+    }
+
+    node.clearSplit();
+
+    // Positions a frame at child, in whichever half of the parent holds it
+    auto positionAt = [&](CursorFrame& frame, const Node* const child) {
+        InternalNode* half = &parent;
+        size_t pos = positionOf(parent, child);
+
+        if (pos > parent.size()) {
+            half = parentSibling;
+            pos = positionOf(*parentSibling, child);
+        }
+
+        if (frame.node() == half) {
+            frame.position = pos;
+        } else {
+            rebindFrame(frame, *half, pos);
+        }
+    };
+
+    for (const auto& parentFrame : parentFrames) {
+        positionAt(*parentFrame.first, parentFrame.second);
+    }
+
+    for (auto& frame : sibling.visitorFrames) {
+        CursorFrame* const parentFrame = frame.parentFrame;
+
+        if (parentFrame && (parentFrame->node() == &parent ||
+                            parentFrame->node() == parentSibling))
         {
-            Latch::scoped_exclusive_lock childLock{*childNode};
-            
-            if (isSplit(childNode)) {
-                bubbleSplitUpOneLevel(tree, *childNode, *node);
-                // TODO: pick one of the children without re-searching
-                continue; // Parent lock is still held
-            }
-            
-            // Destructor releases Parent's Latch
-            std::swap(parentLock, childLock); 
+            positionAt(*parentFrame, &sibling);
         }
-        
-        CursorFrame frame;// TODO: bind with {*in, childIt};        
-        node = childNode;
     }
-    
-    assert(isLeaf(node));
-    assert(parentLock.owns_lock()); // leaf is safely locked
-    
-    const auto leaf = static_cast<LeafNode*>(node);
-    const auto findResult = findValue(tree, *leaf, key);
-    
-    CursorFrame frame;// TODO: bind with {leaf, findResult};
-}
 
-void ops::store(Tree& t, Cursor& visitor, Bytes value) {
-    // TODO: pre-check size
-    if (visitor.stackFrames.empty()) {
-        throw std::runtime_error("unpositioned");
+    if (!parentSibling) { return false; }
+
+    parentSiblingLock.unlock();
+
+    if (&parent == t.root.load(std::memory_order_acquire)) {
+        // Threads which latch the new root wait for the old one, which stays
+        // latched until the split is repaired
+        InternalNode* const newRoot = t.allocateInternal(parent);
+        Latch::scoped_exclusive_lock newRootLock(*newRoot);
+
+        bubbleSplitUpOneLevel(t, *newRoot, parent);
+        t.root.store(newRoot, std::memory_order_release);
     }
-    
-    LeafNode* const leafNode = static_cast<LeafNode*>(
-        visitor.stackFrames.top().node());
-    
-    Latch::scoped_exclusive_lock exclusiveLeafLock(*leafNode);
 
-    const auto key = Bytes{visitor.key.data(), visitor.key.size()};
-    
-    // TODO: Used saved cursor position
-    const auto insertResult = leafNode->insert(leafNode->end(), key, value);
-    
-    if (insertResult == InsertResult::FAILED_NO_SPACE) {
-        assert(insertResult == InsertResult::INSERTED);
-        splitLeaf(*leafNode, leafNode->end(), key, value);
-    
-        // TODO: Start bubbling split upwards
+    return true;
+}
+
+/**
+  Repairs the pending splits along the path to key, latching exclusively from
+  the root down. A parent which split while repairing its child is repaired
+  from its own parent, which is why the descent starts over then.
+
+  pre-conditions:  no node is latched
+  post-conditions: no node is latched
+*/
+void ops::repairSplits(Tree& t, const Bytes key) {
+    for (bool restart = true; restart; ) {
+        restart = false;
+
+        auto parentLock = latchRoot(t);
+        Node* node = t.root.load(std::memory_order_acquire);
+
+        while (!node->isLeaf() && !restart) {
+            const auto in = static_cast<InternalNode*>(node);
+            Node* const child = in->child(findChildNode(*in, key));
+            Latch::scoped_exclusive_lock childLock(*child);
+
+            if (isSplit(child)) {
+                // The child where key belongs is found again, unless the
+                // parent split
+                restart = bubbleSplitUpOneLevel(t, *in, *child);
+            } else {
+                std::swap(parentLock, childLock);
+                node = child;
+            }
+        }
     }
 }
 
 /**
-  pre-conditions:  Source is latched
-  post-conditions: Source is latched
+  Latches the leaf that the frame is bound to, once it has no pending split.
+  A leaf can only split again after its parent refers to its last sibling.
 */
-LeafNode* ops::splitLeaf(
-    LeafNode& source, LeafNode::Iterator insertIt, Bytes key, Bytes value)
+Latch::scoped_exclusive_lock ops::latchUnsplitLeaf(Tree& t, CursorFrame& frame,
+                                                   const Bytes key)
 {
+    for (;;) {
+        auto leafLock = latchFrameNode(frame);
+
+        if (!isSplit(frame.node())) { return leafLock; }
 
-    throw std::logic_error("unimplemented");
-    
-    // // TODO: Allocate a new Node
-    // auto& sibling = *static_cast<LeafNode*>(nullptr);
-    // const auto sourceSize = source.size() + 1;
-    
-    // assert(sourceSize >= 4);
-    
-    // const auto medianPos = sourceSize / 2;
-    
-    // const auto insertPos =
-    //     makeUnsigned(std::distance(source.begin(), insertIt));
-    
-    // const auto srcBegin   = source.begin();
-    // const auto srcEnd     = source.end();
-    // const auto siblingEnd = sibling.end();
-    
-    // if (insertPos > medianPos) { // cleave the "right" side
-    //     source.recordSplit(sibling, SiblingDirection::RIGHT);
-        
-    //     LeafNode::moveEntries(
-    //         source, srcBegin + medianPos, srcBegin + insertPos,
-    //         sibling, siblingEnd);
-        
-    //     sibling.insert(siblingEnd, key, value);
-        
-    //     LeafNode::moveEntries(source, srcBegin + insertPos, srcEnd,
-    //                           sibling, siblingEnd);
-        
-    // } else { // cleave the "left" side
-    //     source.recordSplit(sibling, SiblingDirection::LEFT);
-        
-    //     LeafNode::moveEntries(source, srcBegin, srcBegin + insertPos,
-    //                           sibling, siblingEnd);
-        
-    //     sibling.insert(siblingEnd, key, value);
-        
-    //     LeafNode::moveEntries(
-    //         source, srcBegin + insertPos, srcBegin + medianPos,
-    //         sibling, siblingEnd);
-    // }
-    
-    // moveFrames(source, sibling, insertPos, medianPos);
-    // return &sibling;
+        leafLock.unlock();
+        repairSplits(t, key);
+    }
 }
 
 /**
-  pre-conditions:  Both source and sibling are latched
-  post-conditions: Both source and sibling are latched
+  Positions the cursor at key. A cursor which is already positioned nearby
+  resumes from the lowest node it's bound to whose keys include key, which
+  is often the same leaf when finding keys in order. Otherwise lookups
+  descend optimistically, without latching the internal nodes, and only bind
+  a frame to the leaf. Failing that, they latch shared, coupling the latches
+  from the root down, so that readers don't exclude each other. Pending
+  splits found along the way are repaired first, which needs exclusive
+  latches, and then the descent is repeated. Stores latch the leaf
+  exclusively themselves.
 */
-void ops::moveFrames(Node& source, Node& sibling,
-                     const size_t insertPos, const size_t splitPos)
-{
-    const auto srcEndIt = source.visitorFrames.end();
-    const auto dstEndIt = source.visitorFrames.end();
-    
-    for (auto srcIt = source.visitorFrames.begin(); srcIt != srcEndIt;) {
-        auto thisIt = srcIt;
-        ++srcIt;
-        
-        const auto originalPos = thisIt->position;
-        
-        if (originalPos >= splitPos) {
-            if (originalPos < insertPos) {
-                thisIt->position = originalPos - splitPos;
-            } else if (originalPos > insertPos)  {
-                thisIt->position = originalPos - splitPos + 1;                
-            } else { // originalPos == insertPos
-                assert(false); // TODO: compare and decide which way to go
-            }
+void ops::find(Tree& tree, Cursor& visitor, Bytes key) {
+    // TODO: pre-conditions and post-conditions on these guys in
+    //       the face of failure would be nice to have
+    if (visitor.tree != &tree) { unbindFrames(visitor); }
 
-            if (insertPos > splitPos) {
-                sibling.visitorFrames.splice(
-                    dstEndIt, source.visitorFrames, thisIt);
-            }
-        } else {
-            if (originalPos < insertPos) {
-                // nothing to do
-            } else if (originalPos > insertPos)  {
-                thisIt->position = originalPos + 1;                
-            } else { // originalPos == insertPos
-                assert(false); // TODO: compare and decide which way to go
+    // Nodes are read before they're latched, or without latching them
+    const Epochs::Guard guard(tree.mEpochs);
+
+    // Frames of missing keys refer to the key of the cursor, which inserts
+    // of other threads compare until the frames are unbound
+    Node* node = nullptr;
+    auto nodeLock = unwindToCover(visitor, key, node);
+
+    visitor.key = Buffer{key.data(), key.size()};
+    visitor.value.clear();
+    visitor.hasValue = false;
+    visitor.tree = &tree;
+
+    if (nodeLock.owns_lock()) {
+        if (descend(visitor, key, *node, std::move(nodeLock))) { return; }
+
+        unwindFrames(visitor);
+    }
+
+    if (findOptimistic(tree, visitor, key)) { return; }
+
+    bindPath(tree, visitor, key);
+}
+
+/**
+  Descends to the leaf where key belongs without latching the internal nodes
+  or writing to them. The version of each internal node is recorded before
+  its child is found, and validated once the child was read, restarting from
+  the root if it changed. Only the leaf is latched, to bind the frame to it.
+  Returns false, without binding any frame, if the descent needs latches
+  after all.
+
+  Internal nodes which are removed from the tree are retired, and only
+  deleted once the epoch guard held by the caller is gone, so they can still
+  be read after being removed. Their version tells that they changed.
+
+  pre-conditions:  no frames are bound, no node is latched, and an epoch
+                   guard is held
+  post-conditions: no node is latched
+*/
+bool ops::findOptimistic(Tree& tree, Cursor& visitor, const Bytes key) {
+    for (size_t attempt = 0; attempt < MAX_OPTIMISTIC_ATTEMPTS; ++attempt) {
+        // A root collapse holds the root latched, changing its version
+        InternalNode* in = tree.root.load(std::memory_order_acquire);
+        std::uint32_t version;
+
+        if (!in->tryOptimistic(version) ||
+            tree.root.load(std::memory_order_acquire) != in)
+        {
+            continue;
+        }
+
+        for (;;) {
+            Node* const child = in->optimisticChild(key);
+
+            if (!in->validate(version)) { break; }
+
+            // Indirect keys are compared while latched
+            if (!child) { return false; }
+
+            if (child->isLeaf()) {
+                const auto leaf = static_cast<LeafNode*>(child);
+                Latch::scoped_shared_lock leafLock(*leaf);
+
+                // Still the leaf for key, unless it has a pending split
+                if (!in->validate(version)) { break; }
+                if (isSplit(leaf)) { return false; }
+
+                findInLeaf(visitor, *leaf, key);
+                return true;
             }
-            
-            if (insertPos <= splitPos) {
-                sibling.visitorFrames.splice(
-                    dstEndIt, source.visitorFrames, thisIt);
+
+            const auto childIn = static_cast<InternalNode*>(child);
+            std::uint32_t childVersion;
+
+            if (!childIn->tryOptimistic(childVersion)) { break; }
+
+            const bool split = isSplit(childIn);
+
+            if (!childIn->validate(childVersion) || !in->validate(version)) {
+                break;
             }
+
+            // Pending splits are repaired while latched
+            if (split) { return false; }
+
+            in = childIn;
+            version = childVersion;
+        }
+    }
+
+    return false;
+}
+
+/**
+  Descends from node to the leaf where key belongs, coupling shared latches
+  and binding a frame to every node on the way. Returns false if a pending
+  split was found, leaving the frames bound so far for the caller to unwind.
+
+  pre-conditions:  node is latched by parentLock, and the frames of the
+                   cursor are bound down to the parent of node
+  post-conditions: no node is latched
+*/
+bool ops::descend(Cursor& visitor, const Bytes key, Node& start,
+                  Latch::scoped_shared_lock parentLock)
+{
+    Node* node = &start;
+
+    while (!node->isLeaf()) {
+        const auto in = static_cast<InternalNode*>(node);
+        const auto childPos = findChildNode(*in, key);
+        auto const childNode = in->child(childPos);
+
+        {
+            Latch::scoped_shared_lock childLock{*childNode};
+
+            if (isSplit(childNode)) { return false; }
+
+            bindFrame(visitor, *in, childPos, Bytes{});
+
+            // Destructor releases Parent's Latch
+            std::swap(parentLock, childLock);
         }
+
+        node = childNode;
     }
+
+    assert(node->isLeaf());
+    assert(parentLock.owns_lock()); // leaf is safely locked
+
+    findInLeaf(visitor, *static_cast<LeafNode*>(node), key);
+
+    return true;
 }
 
-} }
+/**
+  Binds the last frame of the cursor to the position of key in the leaf, and
+  copies its value if it's present.
+
+  pre-conditions:  leaf is latched
+  post-conditions: leaf is latched
+*/
+void ops::findInLeaf(Cursor& visitor, LeafNode& leafRef, const Bytes key) {
+    const auto leaf = &leafRef;
+    const auto findResult = leaf->lowerBound(key);
+
+    if (findResult.second && leaf->isGhost(findResult.first)) {
+        // Bound as found, so that storing replaces the ghost instead of
+        // inserting the key again
+        bindFrame(visitor, *leaf, findResult.first, Bytes{});
+    } else if (findResult.second) {
+        // Fragmented values are copied from their fragments while the leaf
+        // is latched, which keeps them from being released
+        leaf->leafValue(findResult.first).appendTo(visitor.value);
+        visitor.hasValue = true;
+
+        bindFrame(visitor, *leaf, findResult.first, Bytes{});
+    } else {
+        bindFrame(visitor, *leaf, findResult.first,
+                  Bytes{visitor.key.data(), visitor.key.size()});
+    }
+}
+
+/**
+  Binds a frame to every node on the path to key, coupling shared latches
+  from the root down, and positions the cursor at key. Pending splits found
+  along the way are repaired first, and then the descent is repeated.
 
+  pre-conditions:  an epoch guard is held, no node is latched, and the value
+                   of the cursor is cleared
+  post-conditions: no node is latched
+*/
+void ops::bindPath(Tree& t, Cursor& visitor, const Bytes key) {
+    for (;;) {
+        auto rootLock =
+            unwindAndLockRoot<Latch::scoped_shared_lock>(t, visitor);
+        InternalNode* const root = t.root.load(std::memory_order_acquire);
+
+        if (descend(visitor, key, *root, std::move(rootLock))) { return; }
+
+        repairSplits(t, key);
+    }
+}
+
+void ops::first(Tree& t, Cursor& visitor) {
+    toEdge(t, visitor, true);
+}
+
+void ops::last(Tree& t, Cursor& visitor) {
+    toEdge(t, visitor, false);
+}
+
+void ops::next(Tree& t, Cursor& visitor) {
+    move(t, visitor, true);
+}
+
+void ops::previous(Tree& t, Cursor& visitor) {
+    move(t, visitor, false);
+}
+
+/**
+  Moves the cursor by amount entries, forward if it's positive. The cursor is
+  reset once no entry is left in the direction of the move.
+*/
+void ops::skip(Tree& t, Cursor& visitor, const std::ptrdiff_t amount) {
+    if (visitor.stackFrames.empty()) {
+        throw std::runtime_error("unpositioned");
+    }
+
+    const bool forward = amount > 0;
+
+    for (std::ptrdiff_t i = 0; i != amount && !visitor.stackFrames.empty();
+         forward ? ++i : --i)
+    {
+        move(t, visitor, forward);
+    }
+}
+
+/**
+  Positions the cursor at the first or the last entry, descending along the
+  first or the last child of every node. Leaves without entries are passed
+  over, and the cursor is reset if the tree has no entries at all.
+*/
+void ops::toEdge(Tree& t, Cursor& visitor, const bool forward) {
+    if (visitor.tree != &t) { unbindFrames(visitor); }
+
+    // Nodes are read before they're latched
+    const Epochs::Guard guard(t.mEpochs);
+
+    visitor.tree = &t;
+
+    for (;;) {
+        // Frames of missing keys refer to the key of the cursor
+        unwindFrames(visitor);
+
+        visitor.key.clear();
+        visitor.value.clear();
+        visitor.hasValue = false;
+
+        auto rootLock = latchRoot<Latch::scoped_shared_lock>(t);
+        InternalNode* const root = t.root.load(std::memory_order_acquire);
+        Buffer repairKey;
+
+        switch (descendToEdge(visitor, *root, std::move(rootLock), forward,
+                              repairKey))
+        {
+        case Move::MOVED:
+            return;
+        case Move::CONTINUE:
+            advance(t, visitor, forward);
+            return;
+        case Move::END:
+            reset(visitor);
+            return;
+        case Move::BLOCKED:
+            repairSplits(t, Bytes{repairKey.data(), repairKey.size()});
+            break;
+        }
+    }
+}
+
+/**
+  Moves the cursor to the next or the previous entry, skipping ghosts. Most
+  moves stay within the leaf, which is only latched shared. Otherwise the
+  frames of the cursor lead to the nearest leaf which has an entry.
+*/
+void ops::move(Tree& t, Cursor& visitor, const bool forward) {
+    if (visitor.stackFrames.empty()) {
+        throw std::runtime_error("unpositioned");
+    }
+
+    // The leaf is read from the frame before it's latched
+    const Epochs::Guard guard(t.mEpochs);
+
+    {
+        auto& frame = visitor.stackFrames.top();
+        const auto leafLock = latchFrameNode<Latch::scoped_shared_lock>(frame);
+
+        if (seekInLeaf(visitor, frame, *static_cast<LeafNode*>(frame.node()),
+                       nextPosition(frame, forward), forward))
+        {
+            return;
+        }
+    }
+
+    advance(t, visitor, forward);
+}
+
+/**
+  Moves the cursor from a leaf without entries left in the direction of the
+  move to the nearest entry of the leaves beyond it, resetting the cursor if
+  there's none. Whenever the frames can't be followed, the cursor is found
+  again by its key, which binds a frame to every node, and the move resumes
+  from there.
+
+  pre-conditions:  an epoch guard is held, and no node is latched
+  post-conditions: no node is latched
+*/
+void ops::advance(Tree& t, Cursor& visitor, const bool forward) {
+    for (;;) {
+        Buffer repairKey;
+
+        switch (climb(t, visitor, forward, repairKey)) {
+        case Move::MOVED:
+            return;
+        case Move::CONTINUE:
+            break;
+        case Move::END:
+            reset(visitor);
+            return;
+        case Move::BLOCKED:
+            if (!repairKey.empty()) {
+                repairSplits(t, Bytes{repairKey.data(), repairKey.size()});
+            }
+
+            rebind(t, visitor);
+            break;
+        }
+    }
+}
+
+/**
+  Binds the frames of the cursor again by its key. A cursor which isn't at an
+  entry is positioned before its key, since the key is missing or a bound of
+  the keys of a leaf, even if an entry with that key is found now.
+
+  pre-conditions:  an epoch guard is held, and no node is latched
+  post-conditions: no node is latched
+*/
+void ops::rebind(Tree& t, Cursor& visitor) {
+    const bool atEntry = visitor.hasValue;
+    const auto key = Bytes{visitor.key.data(), visitor.key.size()};
+
+    visitor.value.clear();
+    visitor.hasValue = false;
+
+    bindPath(t, visitor, key);
+
+    if (!atEntry) {
+        auto& frame = visitor.stackFrames.top();
+        const auto leafLock = latchFrameNode<Latch::scoped_shared_lock>(frame);
+
+        frame.notFoundKey = key;
+        visitor.value.clear();
+        visitor.hasValue = false;
+    }
+}
+
+/**
+  Climbs the frames of the cursor from its leaf until a node has another
+  child in the direction of the move, and descends from there to the nearest
+  leaf. Each frame is checked while the node of its parent frame is latched,
+  since its node can't gain entries or children from a sibling then.
+
+  Returns BLOCKED if the frames can't be followed, because only the leaf is
+  bound, a node was removed or a new root was added. A node with a pending
+  split blocks as well, and its split key is stored into repairKey.
+
+  pre-conditions:  an epoch guard is held, and no node is latched
+  post-conditions: no node is latched
+*/
+ops::Move ops::climb(Tree& t, Cursor& visitor, const bool forward,
+                     Buffer& repairKey)
+{
+    CursorFrame* const leafFrame = &visitor.stackFrames.top();
+    CursorFrame* frame = leafFrame;
+
+    for (;;) {
+        CursorFrame* const parentFrame = frame->parentFrame;
+
+        if (!parentFrame) {
+            // Lookups which descended optimistically only bind the leaf
+            if (frame == leafFrame) { return Move::BLOCKED; }
+
+            auto rootLock = latchFrameNode<Latch::scoped_shared_lock>(*frame);
+
+            if (!rootLock.owns_lock() ||
+                frame->node() != t.root.load(std::memory_order_acquire))
+            {
+                return Move::BLOCKED;
+            }
+
+            // Repairs could have added children since the root was checked
+            const auto root = static_cast<InternalNode*>(frame->node());
+
+            if ((forward && frame->position < root->size()) ||
+                (!forward && frame->position > 0))
+            {
+                return turn(visitor, *frame, *root, std::move(rootLock),
+                            forward, repairKey);
+            }
+
+            return Move::END;
+        }
+
+        auto parentLock =
+            latchFrameNode<Latch::scoped_shared_lock>(*parentFrame);
+
+        if (!parentLock.owns_lock()) { return Move::BLOCKED; }
+
+        const auto parent = static_cast<InternalNode*>(parentFrame->node());
+
+        if (isSplit(parent)) {
+            repairKey = parent->split().key;
+            return Move::BLOCKED;
+        }
+
+        {
+            auto nodeLock = latchFrameNode<Latch::scoped_shared_lock>(*frame);
+            Node* const node = frame->node();
+
+            if (!nodeLock.owns_lock() ||
+                parent->child(parentFrame->position) != node)
+            {
+                return Move::BLOCKED;
+            }
+
+            if (isSplit(node)) {
+                repairKey = node->split().key;
+                return Move::BLOCKED;
+            }
+
+            if (frame == leafFrame) {
+                // Entries moved in since the leaf was last latched
+                if (seekInLeaf(visitor, *frame, *static_cast<LeafNode*>(node),
+                               nextPosition(*frame, forward), forward))
+                {
+                    return Move::MOVED;
+                }
+            } else {
+                const auto in = static_cast<InternalNode*>(node);
+
+                if ((forward && frame->position < in->size()) ||
+                    (!forward && frame->position > 0))
+                {
+                    parentLock.unlock();
+                    return turn(visitor, *frame, *in, std::move(nodeLock),
+                                forward, repairKey);
+                }
+            }
+        }
+
+        if ((forward && parentFrame->position < parent->size()) ||
+            (!forward && parentFrame->position > 0))
+        {
+            return turn(visitor, *parentFrame, *parent, std::move(parentLock),
+                        forward, repairKey);
+        }
+
+        frame = parentFrame;
+    }
+}
+
+/**
+  Moves the frame of node to the next or the previous child, and descends
+  from there to the nearest leaf. The frames bound below node are unbound
+  first. The separator next to the child bounds the keys of the leaf, and
+  becomes the key of the cursor until an entry is found.
+
+  pre-conditions:  node is latched by nodeLock, and is the node of frame,
+                   which has a child in the direction of the move
+  post-conditions: no node is latched
+*/
+ops::Move ops::turn(Cursor& visitor, CursorFrame& frame, InternalNode& node,
+                    Latch::scoped_shared_lock nodeLock, const bool forward,
+                    Buffer& repairKey)
+{
+    auto& stackFrames = visitor.stackFrames;
+
+    while (&stackFrames.top() != &frame) {
+        unbindFrame(stackFrames.top());
+        stackFrames.pop();
+    }
+
+    // Keys are only reassigned once no frame refers to them anymore, and the
+    // cursor isn't at an entry until the leaf has one
+    visitor.value.clear();
+    visitor.hasValue = false;
+
+    if (forward) {
+        ++frame.position;
+        visitor.key = node.key(frame.position - 1);
+    } else {
+        --frame.position;
+        visitor.key = node.key(frame.position);
+    }
+
+    Node* const child = node.child(frame.position);
+    Latch::scoped_shared_lock childLock(*child);
+
+    nodeLock.unlock();
+
+    return descendToEdge(visitor, *child, std::move(childLock), forward,
+                         repairKey);
+}
+
+/**
+  Descends from node to its first or its last leaf, coupling shared latches
+  and binding a frame to the first or the last child of every node on the
+  way. The cursor is then positioned at the nearest entry of the leaf, or
+  past the entries of the leaf if it has none, returning CONTINUE. A cursor
+  without a key takes the separator of the deepest node which has one, since
+  it bounds the keys of the leaf, and a cursor which finds none is in a tree
+  with only one leaf, returning END.
+
+  Returns BLOCKED if a node has a pending split, leaving the frames bound so
+  far, and stores the split key into repairKey.
+
+  pre-conditions:  node is latched by nodeLock, and the frames of the cursor
+                   are bound down to the parent of node
+  post-conditions: no node is latched
+*/
+ops::Move ops::descendToEdge(Cursor& visitor, Node& start,
+                             Latch::scoped_shared_lock nodeLock,
+                             const bool forward, Buffer& repairKey)
+{
+    const bool keyless = visitor.key.empty();
+    Node* node = &start;
+
+    for (;;) {
+        if (isSplit(node)) {
+            repairKey = node->split().key;
+            return Move::BLOCKED;
+        }
+
+        if (node->isLeaf()) { break; }
+
+        const auto in = static_cast<InternalNode*>(node);
+        const size_t childPos = forward ? 0 : in->size();
+
+        if (keyless && !in->empty()) {
+            visitor.key = in->key(forward ? 0 : in->size() - 1);
+        }
+
+        bindFrame(visitor, *in, childPos, Bytes{});
+
+        Node* const child = in->child(childPos);
+        Latch::scoped_shared_lock childLock(*child);
+
+        std::swap(nodeLock, childLock);
+        node = child;
+    }
+
+    const auto leaf = static_cast<LeafNode*>(node);
+    const auto size = static_cast<std::ptrdiff_t>(leaf->size());
+
+    bindFrame(visitor, *leaf, forward ? leaf->size() : 0,
+              Bytes{visitor.key.data(), visitor.key.size()});
+
+    if (seekInLeaf(visitor, visitor.stackFrames.top(), *leaf,
+                   forward ? 0 : size - 1, forward))
+    {
+        return Move::MOVED;
+    }
+
+    return visitor.key.empty() ? Move::END : Move::CONTINUE;
+}
+
+/**
+  Positions the leaf frame at the entry at pos, or the nearest one beyond it
+  in the direction of the move which isn't a ghost, and copies the entry
+  into the cursor. Returns false, leaving the cursor alone, if there's none.
+
+  pre-conditions:  leaf is latched, and is the node of frame
+  post-conditions: leaf is latched
+*/
+bool ops::seekInLeaf(Cursor& visitor, CursorFrame& frame, LeafNode& leaf,
+                     std::ptrdiff_t pos, const bool forward)
+{
+    const auto size = static_cast<std::ptrdiff_t>(leaf.size());
+
+    while (pos >= 0 && pos < size && leaf.isGhost(static_cast<size_t>(pos))) {
+        pos += forward ? 1 : -1;
+    }
+
+    if (pos < 0 || pos >= size) { return false; }
+
+    // Other threads only read the frame while the leaf is latched
+    // exclusively, so the key it referred to can be replaced right away
+    frame.position = static_cast<size_t>(pos);
+    frame.notFoundKey = Bytes{};
+
+    visitor.key = leaf.key(frame.position);
+    visitor.value.clear();
+    leaf.leafValue(frame.position).appendTo(visitor.value);
+    visitor.hasValue = true;
+
+    return true;
+}
+
+/**
+  Returns the position in the leaf of the frame where a move starts looking
+  for an entry. Frames of missing keys are positioned before the entry at
+  their position.
+*/
+std::ptrdiff_t ops::nextPosition(const CursorFrame& frame, const bool forward)
+{
+    const auto pos = static_cast<std::ptrdiff_t>(frame.position);
+
+    if (!forward) { return pos - 1; }
+
+    return isFound(frame.notFoundKey) ? pos + 1 : pos;
+}
+
+/**
+  Finds the values of a batch of keys in a single descent from the root,
+  instead of one descent per key. The keys are sorted first, so that the
+  nodes shared by their paths are only searched once, and all the keys which
+  belong to the same leaf are found while it's latched once. The descent is
+  optimistic, like findOptimistic, and the keys which need latches after all
+  are left to findSorted.
+*/
+void ops::findAll(Tree& t, std::vector<Lookup>& lookups) {
+    std::vector<size_t> order(lookups.size());
+
+    for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+
+    std::sort(order.begin(), order.end(), [&](const size_t l, const size_t r) {
+        return lookups[l].key < lookups[r].key;
+    });
+
+    for (auto& lookup : lookups) {
+        lookup.value.clear();
+        lookup.hasValue = false;
+    }
+
+    // Internal nodes are read without latching them
+    const Epochs::Guard guard(t.mEpochs);
+
+    std::vector<size_t> latched;
+    findAllOptimistic(t, lookups, order, latched);
+
+    if (latched.empty()) { return; }
+
+    findSorted(t, lookups, std::move(latched));
+}
+
+/**
+  Finds the values of the lookups at order, whose keys are sorted, descending
+  optimistically from the root. The descent starts over from the root, for
+  the keys not found yet, when a node it went through changed. The lookups
+  which need latches are added to latched, in order.
+
+  pre-conditions:  an epoch guard is held, and no node is latched
+  post-conditions: no node is latched
+*/
+void ops::findAllOptimistic(Tree& t, std::vector<Lookup>& lookups,
+                            const std::vector<size_t>& order,
+                            std::vector<size_t>& latched)
+{
+    size_t begin = 0;
+
+    for (size_t attempt = 0;
+         begin < order.size() && attempt < MAX_OPTIMISTIC_ATTEMPTS; ++attempt)
+    {
+        // A root collapse holds the root latched, changing its version
+        InternalNode* const root = t.root.load(std::memory_order_acquire);
+        std::uint32_t version;
+
+        if (!root->tryOptimistic(version) ||
+            t.root.load(std::memory_order_acquire) != root)
+        {
+            continue;
+        }
+
+        begin = findAllBelowOptimistic(*root, version, lookups, order, begin,
+                                       order.size(), latched);
+    }
+
+    latched.insert(latched.end(), order.begin() + begin, order.end());
+}
+
+/**
+  Finds the values of the lookups at order[begin, end), whose keys are sorted
+  and belong to in, without latching in. A run of keys which belong to the
+  same child ends at the first key which isn't less than the key following
+  the child, so that each run only searches in once. Returns the position in
+  order up to which the lookups were found or added to latched, which is
+  less than end if in or a node below it changed.
+
+  pre-conditions:  an epoch guard is held, no node is latched, and version
+                   of in was recorded
+  post-conditions: no node is latched
+*/
+size_t ops::findAllBelowOptimistic(InternalNode& in,
+                                   const std::uint32_t version,
+                                   std::vector<Lookup>& lookups,
+                                   const std::vector<size_t>& order,
+                                   size_t begin, const size_t end,
+                                   std::vector<size_t>& latched)
+{
+    while (begin < end) {
+        Bytes highKey;
+        Node* const child =
+            in.optimisticChild(lookups[order[begin]].key, highKey);
+        size_t runEnd = begin + 1;
+
+        if (child) {
+            while (runEnd < end && (!highKey.data() ||
+                                    lookups[order[runEnd]].key < highKey))
+            {
+                ++runEnd;
+            }
+        }
+
+        if (!in.validate(version)) { return begin; }
+
+        // Indirect keys are compared while latched
+        if (!child) {
+            latched.push_back(order[begin]);
+            begin = runEnd;
+            continue;
+        }
+
+        if (child->isLeaf()) {
+            const auto leaf = static_cast<LeafNode*>(child);
+            Latch::scoped_shared_lock leafLock(*leaf);
+
+            // Still the leaf for the run, unless it has a pending split
+            if (!in.validate(version)) { return begin; }
+
+            if (isSplit(leaf)) {
+                latched.insert(latched.end(), order.begin() + begin,
+                               order.begin() + runEnd);
+            } else {
+                findAllInLeaf(*leaf, lookups, order, begin, runEnd);
+            }
+
+            begin = runEnd;
+            continue;
+        }
+
+        const auto childIn = static_cast<InternalNode*>(child);
+        std::uint32_t childVersion;
+
+        if (!childIn->tryOptimistic(childVersion)) { return begin; }
+
+        const bool split = isSplit(childIn);
+
+        if (!childIn->validate(childVersion) || !in.validate(version)) {
+            return begin;
+        }
+
+        // Pending splits are repaired while latched
+        if (split) {
+            latched.insert(latched.end(), order.begin() + begin,
+                           order.begin() + runEnd);
+        } else {
+            const size_t found = findAllBelowOptimistic(
+                *childIn, childVersion, lookups, order, begin, runEnd,
+                latched);
+
+            if (found < runEnd) { return found; }
+        }
+
+        begin = runEnd;
+    }
+
+    return end;
+}
+
+/**
+  Finds the values of the lookups at order, whose keys are sorted, in a
+  single descent which couples shared latches.
+
+  pre-conditions:  no node is latched
+  post-conditions: no node is latched
+*/
+void ops::findSorted(Tree& t, std::vector<Lookup>& lookups,
+                     std::vector<size_t> order)
+{
+    // Nodes are read before they're latched
+    const Epochs::Guard guard(t.mEpochs);
+
+    std::vector<size_t> blocked;
+    std::vector<size_t> repairs;
+
+    while (!order.empty()) {
+        {
+            const auto rootLock = latchRoot<Latch::scoped_shared_lock>(t);
+
+            findAllBelow(*t.root.load(std::memory_order_acquire), lookups,
+                         order, 0, order.size(), blocked, repairs);
+        }
+
+        for (const size_t i : repairs) { repairSplits(t, lookups[i].key); }
+
+        // Blocked keys were added in order
+        order.swap(blocked);
+        blocked.clear();
+        repairs.clear();
+    }
+}
+
+/**
+  Finds the values of the lookups at order[begin, end), whose keys are
+  sorted and belong to node. The keys which belong to the same child are
+  found under one shared latch of the child, which is coupled with the latch
+  of node. A run of them ends at the first key which isn't less than the key
+  following the child. The keys of a child with a pending split are added to
+  blocked instead, and the first one of them to repairs.
+
+  pre-conditions:  node is latched
+  post-conditions: node is latched
+*/
+void ops::findAllBelow(Node& node, std::vector<Lookup>& lookups,
+                       const std::vector<size_t>& order, size_t begin,
+                       const size_t end, std::vector<size_t>& blocked,
+                       std::vector<size_t>& repairs)
+{
+    if (node.isLeaf()) {
+        findAllInLeaf(static_cast<const LeafNode&>(node), lookups, order,
+                      begin, end);
+        return;
+    }
+
+    const auto& in = static_cast<const InternalNode&>(node);
+
+    while (begin < end) {
+        const size_t childPos = findChildNode(in, lookups[order[begin]].key);
+        size_t runEnd = end;
+
+        if (childPos < in.size()) {
+            const Buffer highKey = in.key(childPos);
+            runEnd = begin + 1;
+
+            while (runEnd < end && lookups[order[runEnd]].key < Bytes(highKey))
+            {
+                ++runEnd;
+            }
+        }
+
+        Node* const child = in.child(childPos);
+        Latch::scoped_shared_lock childLock(*child);
+
+        if (isSplit(child)) {
+            repairs.push_back(order[begin]);
+            blocked.insert(blocked.end(), order.begin() + begin,
+                           order.begin() + runEnd);
+        } else {
+            findAllBelow(*child, lookups, order, begin, runEnd, blocked,
+                         repairs);
+        }
+
+        begin = runEnd;
+    }
+}
+
+/**
+  Finds the values of the lookups at order[begin, end), whose keys belong to
+  leaf.
+
+  pre-conditions:  leaf is latched
+  post-conditions: leaf is latched
+*/
+void ops::findAllInLeaf(const LeafNode& leaf, std::vector<Lookup>& lookups,
+                        const std::vector<size_t>& order, size_t begin,
+                        const size_t end)
+{
+    for (; begin < end; ++begin) {
+        auto& lookup = lookups[order[begin]];
+        const auto findResult = leaf.lowerBound(lookup.key);
+
+        if (findResult.second && !leaf.isGhost(findResult.first)) {
+            leaf.leafValue(findResult.first).appendTo(lookup.value);
+            lookup.hasValue = true;
+        }
+    }
+}
+
+/**
+  State of one lookup of findInterleaved, which descends optimistically like
+  findOptimistic, one step at a time
+*/
+struct ops::Probe final {
+    enum class Stage {
+        // Starts over from the root
+        ROOT,
+
+        // The node was prefetched, and its page header is prefetched next
+        HEADER,
+
+        // The search vector of the node is prefetched next
+        SEARCH_VECTOR,
+
+        // The node is searched, prefetching the child for key
+        SEARCH,
+
+        DONE,
+
+        // Left to findSorted, which latches its way down
+        LATCHED,
+    };
+
+    explicit Probe(const size_t index = 0) :
+        index(index), stage(Stage::ROOT), node(nullptr), version(0),
+        parent(nullptr), parentVersion(0), attempts(0) {}
+
+    size_t index; // of the lookup
+    Stage stage;
+
+    Node* node;
+    std::uint32_t version; // of node
+
+    // Internal node which node was found in, null for the root
+    InternalNode* parent;
+    std::uint32_t parentVersion;
+
+    size_t attempts;
+};
+
+/**
+  Finds the values of a batch of keys, running several lookups at once. Each
+  lookup descends optimistically, and prefetches whatever it reads next
+  before switching to the next lookup, so that the cache misses of the
+  lookups in flight overlap instead of being waited for one after the other.
+  Lookups which need latches after all are left to findSorted.
+*/
+void ops::findInterleaved(Tree& t, std::vector<Lookup>& lookups) {
+    for (auto& lookup : lookups) {
+        lookup.value.clear();
+        lookup.hasValue = false;
+    }
+
+    // Internal nodes are read without latching them
+    const Epochs::Guard guard(t.mEpochs);
+
+    Probe probes[INTERLEAVED_LOOKUPS];
+    size_t active = 0;
+    size_t next = 0;
+    std::vector<size_t> latched;
+
+    while (active < INTERLEAVED_LOOKUPS && next < lookups.size()) {
+        probes[active++] = Probe(next++);
+    }
+
+    while (active > 0) {
+        for (size_t i = 0; i < active; ) {
+            auto& probe = probes[i];
+
+            step(t, lookups[probe.index], probe);
+
+            if (probe.stage != Probe::Stage::DONE &&
+                probe.stage != Probe::Stage::LATCHED)
+            {
+                ++i;
+                continue;
+            }
+
+            if (probe.stage == Probe::Stage::LATCHED) {
+                latched.push_back(probe.index);
+            }
+
+            // The slot takes the next lookup, or the last one in flight
+            if (next < lookups.size()) {
+                probe = Probe(next++);
+                ++i;
+            } else {
+                probe = probes[--active];
+            }
+        }
+    }
+
+    if (latched.empty()) { return; }
+
+    std::sort(latched.begin(), latched.end(),
+              [&](const size_t l, const size_t r) {
+        return lookups[l].key < lookups[r].key;
+    });
+
+    findSorted(t, lookups, std::move(latched));
+}
+
+/**
+  Advances the probe by one stage. Each stage only reads what the previous
+  one prefetched, and ends by prefetching what the next one reads.
+
+  pre-conditions:  an epoch guard is held, and no node is latched
+  post-conditions: no node is latched
+*/
+void ops::step(Tree& t, Lookup& lookup, Probe& probe) {
+    typedef Probe::Stage Stage;
+
+    switch (probe.stage) {
+    case Stage::ROOT: {
+        if (++probe.attempts > MAX_OPTIMISTIC_ATTEMPTS) {
+            probe.stage = Stage::LATCHED;
+            return;
+        }
+
+        probe.node = t.root.load(std::memory_order_acquire);
+        probe.parent = nullptr;
+        probe.stage = Stage::HEADER;
+
+        prefetch(probe.node);
+        return;
+    }
+    case Stage::HEADER: {
+        if (probe.node->isLeaf()) {
+            // Leaves are only latched to be searched. A leaf which is being
+            // written isn't worth prefetching, since the search waits for it.
+            const auto leaf = static_cast<LeafNode*>(probe.node);
+
+            if (leaf->tryOptimistic(probe.version)) {
+                leaf->prefetchHeader();
+                probe.stage = Stage::SEARCH_VECTOR;
+            } else {
+                probe.stage = Stage::SEARCH;
+            }
+
+            return;
+        }
+
+        const auto in = static_cast<InternalNode*>(probe.node);
+
+        if (!in->tryOptimistic(probe.version)) {
+            probe.stage = Stage::ROOT;
+            return;
+        }
+
+        if (!probe.parent) {
+            // A root collapse holds the root latched, changing its version
+            if (t.root.load(std::memory_order_acquire) != in) {
+                probe.stage = Stage::ROOT;
+                return;
+            }
+        } else {
+            const bool split = isSplit(in);
+
+            if (!in->validate(probe.version) ||
+                !probe.parent->validate(probe.parentVersion))
+            {
+                probe.stage = Stage::ROOT;
+                return;
+            }
+
+            // Pending splits are repaired while latched
+            if (split) {
+                probe.stage = Stage::LATCHED;
+                return;
+            }
+        }
+
+        in->prefetchHeader();
+        probe.stage = Stage::SEARCH_VECTOR;
+        return;
+    }
+    case Stage::SEARCH_VECTOR: {
+        if (probe.node->isLeaf()) {
+            const auto leaf = static_cast<LeafNode*>(probe.node);
+
+            // The header is only trusted to place the prefetch while no
+            // writer came in since the previous stage
+            if (leaf->validate(probe.version)) {
+                leaf->prefetchSearchVector();
+            }
+        } else {
+            static_cast<InternalNode*>(probe.node)->prefetchSearchVector();
+        }
+
+        probe.stage = Stage::SEARCH;
+        return;
+    }
+    case Stage::SEARCH: {
+        if (probe.node->isLeaf()) {
+            // The only latch of the leaf, and nothing read by the earlier
+            // stages is used
+            const auto leaf = static_cast<LeafNode*>(probe.node);
+            const Latch::scoped_shared_lock leafLock(*leaf);
+
+            // Still the leaf for key, unless it has a pending split
+            if (!probe.parent->validate(probe.parentVersion)) {
+                probe.stage = Stage::ROOT;
+                return;
+            }
+
+            if (isSplit(leaf)) {
+                probe.stage = Stage::LATCHED;
+                return;
+            }
+
+            const auto findResult = leaf->lowerBound(lookup.key);
+
+            if (findResult.second && !leaf->isGhost(findResult.first)) {
+                leaf->leafValue(findResult.first).appendTo(lookup.value);
+                lookup.hasValue = true;
+            }
+
+            probe.stage = Stage::DONE;
+            return;
+        }
+
+        const auto in = static_cast<InternalNode*>(probe.node);
+        Node* const child = in->optimisticChild(lookup.key);
+
+        if (!in->validate(probe.version)) {
+            probe.stage = Stage::ROOT;
+            return;
+        }
+
+        // Indirect keys are compared while latched
+        if (!child) {
+            probe.stage = Stage::LATCHED;
+            return;
+        }
+
+        probe.parent = in;
+        probe.parentVersion = probe.version;
+        probe.node = child;
+        probe.stage = Stage::HEADER;
+
+        prefetch(child);
+        return;
+    }
+    case Stage::DONE:
+    case Stage::LATCHED:
+        return;
+    }
+}
+
+void ops::store(Tree& t, Cursor& visitor, Bytes value) {
+    // TODO: pre-check size
+    if (visitor.stackFrames.empty()) {
+        throw std::runtime_error("unpositioned");
+    }
+
+    // The leaf is read from the frame before it's latched, and merges latch
+    // the root before reading it
+    const Epochs::Guard guard(t.mEpochs);
+
+    // A null value deletes the entry
+    if (isDelete(value)) {
+        remove(t, visitor);
+        return;
+    }
+
+    auto& frame = visitor.stackFrames.top();
+    const auto key = Bytes{visitor.key.data(), visitor.key.size()};
+
+    if (storeInLeaf(t, frame, key, value)) {
+        // The leaf split, which is repaired before anything else splits it
+        // again
+        repairSplits(t, key);
+    }
+
+    visitor.value.assign(value.data(), value.data() + value.size());
+    visitor.hasValue = true;
+}
+
+/**
+  Stores the value of key at the position of the frame, splitting the leaf if
+  it doesn't fit. Returns true if the leaf split.
+
+  pre-conditions:  no node is latched
+  post-conditions: no node is latched
+*/
+bool ops::storeInLeaf(Tree& t, CursorFrame& frame, const Bytes key,
+                      const Bytes value)
+{
+    const auto exclusiveLeafLock = latchUnsplitLeaf(t, frame, key);
+    const auto leafNode = static_cast<LeafNode*>(frame.node());
+
+    const auto leafValue = t.leafValue(*leafNode, key, value);
+    bool split = false;
+
+    if (isFound(frame.notFoundKey)) {
+        // The replaced value is released once nothing refers to it
+        const auto oldValue = leafNode->leafValue(frame.position);
+        auto updateResult = leafNode->update(frame.position, leafValue);
+
+        if (updateResult == InsertResult::FAILED_NO_SPACE &&
+            removeGhosts(t, *leafNode) > 0)
+        {
+            updateResult = leafNode->update(frame.position, leafValue);
+        }
+
+        if (updateResult == InsertResult::FAILED_NO_SPACE) {
+            splitLeaf(t, *leafNode, frame.position, true, key, leafValue);
+            split = true;
+        }
+
+        t.releaseFragments(oldValue.first());
+    } else {
+        const auto nodeKey = t.nodeKey(key);
+        auto insertResult =
+            leafNode->insert(frame.position, nodeKey, leafValue);
+
+        // The frame's position accounts for the ghosts removed before it
+        if (insertResult == InsertResult::FAILED_NO_SPACE &&
+            removeGhosts(t, *leafNode) > 0)
+        {
+            insertResult = leafNode->insert(frame.position, nodeKey, leafValue);
+        }
+
+        if (insertResult == InsertResult::INSERTED) {
+            insertFrames(*leafNode, frame.position, key);
+        } else {
+            splitLeaf(t, *leafNode, frame.position, false, nodeKey, leafValue);
+            split = true;
+        }
+    }
+
+    return split;
+}
+
+/**
+  Applies a batch of writes leaf by leaf, instead of one descent per write.
+  The writes are sorted by key first, and all those which belong to the same
+  leaf are applied under one exclusive latch of it. Where several writes have
+  the same key, the last one of them wins. A leaf which splits while taking
+  the writes is repaired once, and the remaining writes are applied by
+  latching the leaf where the next one belongs.
+
+  pre-conditions:  no node is latched
+  post-conditions: no node is latched
+*/
+void ops::storeAll(Tree& t, const std::vector<Write>& writes) {
+    std::vector<size_t> order(writes.size());
+
+    for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+
+    const auto byKey = [&](const size_t l, const size_t r) {
+        return writes[l].key < writes[r].key;
+    };
+
+    std::stable_sort(order.begin(), order.end(), byKey);
+
+    // Writes of the same key are adjacent, in the order they were given
+    size_t unique = 0;
+
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (unique > 0 && !byKey(order[unique - 1], order[i])) {
+            order[unique - 1] = order[i];
+        } else {
+            order[unique++] = order[i];
+        }
+    }
+
+    order.resize(unique);
+
+    // Leaves are latched without latching the root first, and merges latch
+    // the root before reading it
+    const Epochs::Guard guard(t.mEpochs);
+
+    Buffer upperKey;
+
+    for (size_t begin = 0; begin < order.size(); ) {
+        size_t end = begin;
+        bool split = false;
+        bool underflow = false;
+
+        {
+            LeafNode* leaf;
+            const auto leafLock = latchLeaf(t, writes[order[begin]].key, leaf,
+                                            &upperKey);
+
+            do {
+                const auto& write = writes[order[end++]];
+
+                split = writeInLeaf(t, *leaf, write.key, write.value);
+            } while (!split && end < order.size() &&
+                     (upperKey.empty() ||
+                      writes[order[end]].key < Bytes(upperKey)));
+
+            // Ghosts are removed once per leaf, like the deletes of ops::remove
+            // do once they make up half of it
+            if (!split && leaf->ghosts() * 2 >= leaf->size() &&
+                removeGhosts(t, *leaf) > 0)
+            {
+                underflow = isUnderflow(*leaf);
+            }
+        }
+
+        const auto lastKey = writes[order[end - 1]].key;
+
+        if (split) {
+            // The writes which are left can belong to the sibling, which the
+            // parent refers to once the split is repaired
+            repairSplits(t, lastKey);
+        } else if (underflow) {
+            mergeUnderflow(t, lastKey);
+        }
+
+        begin = end;
+    }
+}
+
+/**
+  Latches the leaf where key belongs exclusively, coupling shared latches of
+  the internal nodes from the root down. Pending splits found on the way are
+  repaired first. Unless upperKey is null, the lowest separator above key
+  along the path is copied into it, which bounds the keys belonging to the
+  leaf. It's left empty if the leaf is the last one, since separators are
+  greater than some key, and are never empty.
+
+  pre-conditions:  no node is latched
+  post-conditions: leaf is latched exclusively, and has no pending split
+*/
+Latch::scoped_exclusive_lock ops::latchLeaf(Tree& t, const Bytes key,
+                                            LeafNode*& leaf,
+                                            Buffer* const upperKey)
+{
+    for (;;) {
+        auto parentLock = latchRoot<Latch::scoped_shared_lock>(t);
+        auto parent = t.root.load(std::memory_order_acquire);
+
+        if (upperKey) { upperKey->clear(); }
+
+        for (;;) {
+            const size_t childPos = findChildNode(*parent, key);
+
+            if (upperKey && childPos < parent->size()) {
+                *upperKey = parent->key(childPos);
+            }
+
+            Node* const child = parent->child(childPos);
+
+            if (child->isLeaf()) {
+                Latch::scoped_exclusive_lock leafLock(*child);
+
+                if (!isSplit(child)) {
+                    leaf = static_cast<LeafNode*>(child);
+                    return leafLock;
+                }
+
+                break;
+            }
+
+            Latch::scoped_shared_lock childLock(*child);
+
+            if (isSplit(child)) { break; }
+
+            parentLock.swap(childLock);
+            parent = static_cast<InternalNode*>(child);
+        }
+
+        parentLock.unlock();
+        repairSplits(t, key);
+    }
+}
+
+/**
+  Stores value with key in leaf, or deletes the entry of key if value is
+  null, without binding any frame. The leaf is split if the value doesn't
+  fit, after which no other write is applied to it. Returns true if the leaf
+  split.
+
+  pre-conditions:  leaf is latched exclusively, and has no pending split
+  post-conditions: leaf is latched exclusively
+*/
+bool ops::writeInLeaf(Tree& t, LeafNode& leaf, const Bytes key,
+                      const Bytes value)
+{
+    auto findResult = leaf.lowerBound(key);
+
+    if (isDelete(value)) {
+        if (findResult.second && !leaf.isGhost(findResult.first)) {
+            const auto oldValue = leaf.leafValue(findResult.first);
+
+            leaf.ghost(findResult.first);
+            t.releaseFragments(oldValue.first());
+        }
+
+        return false;
+    }
+
+    const auto leafValue = t.leafValue(leaf, key, value);
+    bool compacted = false;
+
+    if (findResult.second) {
+        // The replaced value is released once nothing refers to it
+        const auto oldValue = leaf.leafValue(findResult.first);
+        auto updateResult = leaf.update(findResult.first, leafValue);
+
+        if (updateResult == InsertResult::FAILED_NO_SPACE &&
+            removeGhosts(t, leaf) > 0)
+        {
+            // A ghost being replaced is removed too unless a frame is bound
+            // to it, and then the value is inserted instead
+            compacted = true;
+            findResult = leaf.lowerBound(key);
+
+            if (findResult.second) {
+                updateResult = leaf.update(findResult.first, leafValue);
+            }
+        }
+
+        if (findResult.second) {
+            const bool split = updateResult == InsertResult::FAILED_NO_SPACE;
+
+            if (split) {
+                splitLeaf(t, leaf, findResult.first, true, key, leafValue);
+            }
+
+            t.releaseFragments(oldValue.first());
+            return split;
+        }
+    }
+
+    const auto nodeKey = t.nodeKey(key);
+    size_t pos = findResult.first;
+    auto insertResult = leaf.insert(pos, nodeKey, leafValue);
+
+    if (insertResult == InsertResult::FAILED_NO_SPACE && !compacted &&
+        removeGhosts(t, leaf) > 0)
+    {
+        pos = leaf.lowerBound(key).first;
+        insertResult = leaf.insert(pos, nodeKey, leafValue);
+    }
+
+    if (insertResult == InsertResult::INSERTED) {
+        insertFrames(leaf, pos, key);
+        return false;
+    }
+
+    splitLeaf(t, leaf, pos, false, nodeKey, leafValue);
+    return true;
+}
+
+/**
+  Stores value with key only if no entry exists for it. Returns false,
+  leaving the tree alone, if one does.
+*/
+bool ops::insert(Tree& t, const Bytes key, const Bytes value) {
+    return storeIf(t, key, value, Expect::ABSENT, Bytes{}, nullptr);
+}
+
+/**
+  Stores value with key only if an entry exists for it. Returns false,
+  leaving the tree alone, if none does.
+*/
+bool ops::replace(Tree& t, const Bytes key, const Bytes value) {
+    return storeIf(t, key, value, Expect::PRESENT, Bytes{}, nullptr);
+}
+
+/**
+  Stores newValue with key only if the value of key is oldValue. A null
+  oldValue expects no entry to exist. Returns false, leaving the tree alone,
+  if the value differs.
+*/
+bool ops::update(Tree& t, const Bytes key, const Bytes oldValue,
+                 const Bytes newValue)
+{
+    return storeIf(t, key, newValue, Expect::VALUE, oldValue, nullptr);
+}
+
+/**
+  Stores value with key unconditionally, and copies the value it replaced
+  into oldValue. Returns false if no entry existed for key.
+*/
+bool ops::exchange(Tree& t, const Bytes key, const Bytes value,
+                   Buffer& oldValue)
+{
+    return storeIf(t, key, value, Expect::ANY, Bytes{}, &oldValue);
+}
+
+/**
+  Stores value with key, or deletes the entry of key if value is null, if
+  the entry of key meets the expectation. The entry is checked and written
+  under the same exclusive latch of the leaf, which is found in a single
+  descent. Unless oldValue is null, the value found is copied into it,
+  whether the expectation is met or not. Returns true if the expectation is
+  met, except for Expect::ANY, for which it returns true if the entry
+  existed.
+
+  pre-conditions:  no node is latched
+  post-conditions: no node is latched
+*/
+bool ops::storeIf(Tree& t, const Bytes key, const Bytes value,
+                  const Expect expect, const Bytes expected,
+                  Buffer* const oldValue)
+{
+    // Leaves are latched without latching the root first, and merges latch
+    // the root before reading it
+    const Epochs::Guard guard(t.mEpochs);
+
+    bool present;
+    bool split = false;
+    bool underflow = false;
+
+    {
+        LeafNode* leaf;
+        const auto leafLock = latchLeaf(t, key, leaf);
+
+        const auto findResult = leaf->lowerBound(key);
+        present = findResult.second && !leaf->isGhost(findResult.first);
+
+        if (oldValue) {
+            oldValue->clear();
+
+            if (present) {
+                leaf->leafValue(findResult.first).appendTo(*oldValue);
+            }
+        }
+
+        bool met = false;
+
+        switch (expect) {
+        case Expect::ABSENT:
+            met = !present;
+            break;
+        case Expect::PRESENT:
+            met = present;
+            break;
+        case Expect::ANY:
+            met = true;
+            break;
+        case Expect::VALUE:
+            met = isDelete(expected) ? !present :
+                present && equals(leaf->leafValue(findResult.first), expected);
+            break;
+        }
+
+        if (!met) { return false; }
+
+        split = writeInLeaf(t, *leaf, key, value);
+
+        if (isDelete(value) && present && leaf->ghosts() * 2 >= leaf->size() &&
+            removeGhosts(t, *leaf) > 0)
+        {
+            underflow = isUnderflow(*leaf);
+        }
+    }
+
+    if (split) {
+        repairSplits(t, key);
+    } else if (underflow) {
+        mergeUnderflow(t, key);
+    }
+
+    return expect != Expect::ANY || present;
+}
+
+void ops::remove(Tree& t, Cursor& visitor) {
+    auto& frame = visitor.stackFrames.top();
+    bool underflow = false;
+
+    {
+        const auto exclusiveLeafLock = latchFrameNode(frame);
+        const auto leafNode = static_cast<LeafNode*>(frame.node());
+
+        if (isFound(frame.notFoundKey)) {
+            const auto oldValue = leafNode->leafValue(frame.position);
+
+            // The entry stays in place as a ghost, which keeps the frames
+            // bound to it positioned
+            leafNode->ghost(frame.position);
+            t.releaseFragments(oldValue.first());
+
+            // Removing the ghosts once they make up half of the node spreads
+            // the cost of compacting it over many deletes
+            if (leafNode->ghosts() * 2 >= leafNode->size() &&
+                removeGhosts(t, *leafNode) > 0)
+            {
+                underflow = isUnderflow(*leafNode);
+            }
+        }
+    }
+
+    visitor.value.clear();
+    visitor.hasValue = false;
+
+    if (underflow) {
+        mergeUnderflow(t, Bytes{visitor.key.data(), visitor.key.size()});
+    }
+}
+
+/**
+  Physically removes the ghosts of node which no frame is bound to, and
+  adjusts the positions of the remaining frames. Frames of missing keys stay
+  positioned before the entry which followed them. Returns the number of
+  ghosts removed.
+
+  pre-conditions:  node is latched
+  post-conditions: node is latched
+*/
+size_t ops::removeGhosts(Tree& t, LeafNode& node) {
+    std::vector<size_t> boundPositions;
+
+    for (const auto& frame : node.visitorFrames) {
+        if (isFound(frame.notFoundKey)) {
+            boundPositions.push_back(frame.position);
+        }
+    }
+
+    std::sort(boundPositions.begin(), boundPositions.end());
+
+    std::vector<size_t> removed;
+    std::vector<FragmentNode*> keyFragments;
+
+    for (size_t pos = 0; pos < node.size(); ++pos) {
+        if (node.isGhost(pos) &&
+            !std::binary_search(boundPositions.begin(), boundPositions.end(),
+                                pos))
+        {
+            removed.push_back(pos);
+            keyFragments.push_back(node.keyFragments(pos));
+        }
+    }
+
+    node.removeGhosts(removed);
+
+    for (auto& frame : node.visitorFrames) {
+        frame.position -= std::lower_bound(removed.begin(), removed.end(),
+                                           frame.position) - removed.begin();
+    }
+
+    for (const auto fragments : keyFragments) {
+        t.releaseFragments(fragments);
+    }
+
+    return removed.size();
+}
+
+/**
+  Merges the underfull nodes along the path to key with a sibling, or moves
+  entries over from the sibling if they don't fit together, from the leaf
+  upwards. The root is replaced by its child if it's left with a single
+  internal child.
+
+  The whole path is latched from the root down while merging, which keeps
+  other threads away from the nodes which change. Merges are rare enough for
+  this not to matter. Nodes taken out of the tree are only retired once the
+  path is released, so that no node latch is held while waiting for the
+  nodes of the tree.
+*/
+void ops::mergeUnderflow(Tree& t, const Bytes key) {
+    std::vector<Latch::scoped_exclusive_lock> locks;
+    std::vector<InternalNode*> path;
+    std::vector<size_t> childPositions;
+    std::vector<Node*> retired;
+
+    locks.push_back(latchRoot(t));
+
+    for (Node* node = t.root.load(std::memory_order_acquire);
+         !node->isLeaf(); )
+    {
+        const auto in = static_cast<InternalNode*>(node);
+        const auto childPos = findChildNode(*in, key);
+
+        node = in->child(childPos);
+        locks.emplace_back(*node);
+
+        // Nodes are left alone until their pending split is repaired
+        if (isSplit(node)) { return; }
+
+        path.push_back(in);
+        childPositions.push_back(childPos);
+    }
+
+    for (size_t level = path.size(); level-- > 0; ) {
+        auto& parent = *path[level];
+        const size_t childPos = childPositions[level];
+        Node* const child = parent.child(childPos);
+
+        if (!isUnderflow(*child) || parent.empty()) { break; }
+
+        // The child is already latched as part of the path, so its left
+        // sibling is latched after it. This is safe only because the parent
+        // is held exclusively, which keeps every other thread from reaching
+        // the siblings through it. The child merges with the sibling holding
+        // fewer bytes, which is the most likely to fit.
+        Node* const leftSibling =
+            childPos > 0 ? parent.child(childPos - 1) : nullptr;
+        Node* const rightSibling =
+            childPos < parent.size() ? parent.child(childPos + 1) : nullptr;
+
+        Latch::scoped_exclusive_lock leftLock;
+        Latch::scoped_exclusive_lock rightLock;
+
+        if (leftSibling) {
+            leftLock = Latch::scoped_exclusive_lock(*leftSibling);
+            if (isSplit(leftSibling)) { break; }
+        }
+
+        if (rightSibling) {
+            rightLock = Latch::scoped_exclusive_lock(*rightSibling);
+            if (isSplit(rightSibling)) { break; }
+        }
+
+        const bool withLeft = !rightSibling || (leftSibling &&
+            nodeBytes(*leftSibling) <= nodeBytes(*rightSibling));
+        const size_t leftPos = withLeft ? childPos - 1 : childPos;
+        Node* const right = parent.child(leftPos + 1);
+
+        const bool merged = child->isLeaf() ?
+            mergeLeaves(t, parent, leftPos) :
+            mergeInternals(t, parent, leftPos);
+
+        // Only a merge removes a key from the parent
+        if (!merged) { break; }
+
+        retired.push_back(right);
+    }
+
+    // The only child of the root is latched, as part of the path
+    const auto root = t.root.load(std::memory_order_acquire);
+
+    if (root->empty() && !root->child(0)->isLeaf()) {
+        // Frames of the old root are left bound to no node, and the frames
+        // bound to its child become the bottom frames of their cursors
+        for (auto& frame : root->visitorFrames) {
+            frame.mNode.store(nullptr, std::memory_order_release);
+        }
+
+        root->visitorFrames.clear();
+
+        t.root.store(static_cast<InternalNode*>(root->child(0)),
+                     std::memory_order_release);
+        retired.push_back(root);
+    }
+
+    locks.clear();
+
+    for (const auto node : retired) {
+        if (node->isLeaf()) {
+            t.retire(static_cast<LeafNode*>(node));
+        } else {
+            t.retire(static_cast<InternalNode*>(node));
+        }
+    }
+}
+
+/**
+  Merges the leaf at leftPos of parent with the one following it, or moves
+  entries between them. Returns true if they merged, which removed the right
+  leaf from parent. The caller retires it once it's unlatched.
+
+  pre-conditions:  parent and both leaves are latched
+  post-conditions: parent and both leaves are latched
+*/
+bool ops::mergeLeaves(Tree& t, InternalNode& parent, const size_t leftPos) {
+    auto& left = *static_cast<LeafNode*>(parent.child(leftPos));
+    auto& right = *static_cast<LeafNode*>(parent.child(leftPos + 1));
+
+    removeGhosts(t, left);
+    removeGhosts(t, right);
+
+    const size_t leftSize = left.size();
+
+    if (left.bytes() + right.bytes() <= left.capacity() && left.merge(right)) {
+        const auto endIt = right.visitorFrames.end();
+
+        for (auto it = right.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+            rebindFrame(frame, left, leftSize + frame.position);
+        }
+
+        t.releaseFragments(parent.keyFragments(leftPos));
+        parent.remove(leftPos);
+        removeChildFrames(parent, leftPos + 1);
+
+        return true;
+    }
+
+    // The new separator replaces the old one, and might be the longest key
+    if (parent.availableBytes() < maxKeyEntrySize(t.mPageSize)) {
+        return false;
+    }
+
+    const auto moved = left.rebalance(right);
+
+    if (moved == 0) { return false; }
+
+    const Buffer separator =
+        shortestSeparator(left.key(left.size() - 1), right.key(0));
+    const auto oldFragments = parent.keyFragments(leftPos);
+
+    if (parent.replaceKey(leftPos, t.nodeKey(separator)) !=
+        InsertResult::INSERTED)
+    {
+        throw std::logic_error("separator doesn't fit");
+    }
+
+    t.releaseFragments(oldFragments);
+
+    // Frames of missing keys at the boundary go to the side of the separator
+    // that their key is on
+    if (moved > 0) {
+        const size_t count = moved;
+        const auto endIt = right.visitorFrames.end();
+
+        for (auto it = right.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+
+            if (frame.position < count ||
+                (frame.position == count && !isFound(frame.notFoundKey) &&
+                 frame.notFoundKey < Bytes(separator)))
+            {
+                rebindFrame(frame, left, leftSize + frame.position);
+                rebindParentFrame(frame, parent, leftPos);
+            } else {
+                frame.position -= count;
+            }
+        }
+    } else {
+        const size_t count = -moved;
+        const size_t boundary = leftSize - count;
+
+        for (auto& frame : right.visitorFrames) { frame.position += count; }
+
+        const auto endIt = left.visitorFrames.end();
+
+        for (auto it = left.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+
+            if (frame.position > boundary ||
+                (frame.position == boundary &&
+                 (isFound(frame.notFoundKey) ||
+                  !(frame.notFoundKey < Bytes(separator)))))
+            {
+                rebindFrame(frame, right, frame.position - boundary);
+                rebindParentFrame(frame, parent, leftPos + 1);
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+  Merges the internal node at leftPos of parent with the one following it, or
+  moves children between them. Returns true if they merged, which removed the
+  right node from parent. The caller retires it once it's unlatched.
+
+  pre-conditions:  parent and both nodes are latched
+  post-conditions: parent and both nodes are latched
+*/
+bool ops::mergeInternals(Tree& t, InternalNode& parent, const size_t leftPos)
+{
+    auto& left = *static_cast<InternalNode*>(parent.child(leftPos));
+    auto& right = *static_cast<InternalNode*>(parent.child(leftPos + 1));
+
+    // The separator moves down along with its fragments
+    const Buffer separatorKey = parent.key(leftPos);
+    const auto fragments = parent.keyFragments(leftPos);
+    const NodeKey separator = fragments ?
+        NodeKey(separatorKey, *fragments) : NodeKey(separatorKey);
+
+    const size_t leftChildren = left.size() + 1;
+
+    if (left.merge(separator, right)) {
+        const auto endIt = right.visitorFrames.end();
+
+        for (auto it = right.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+            rebindFrame(frame, left, leftChildren + frame.position);
+        }
+
+        parent.remove(leftPos);
+        removeChildFrames(parent, leftPos + 1);
+
+        return true;
+    }
+
+    if (parent.availableBytes() < maxKeyEntrySize(t.mPageSize)) {
+        return false;
+    }
+
+    Buffer newSeparator;
+    FragmentNode* newFragments = nullptr;
+
+    const auto moved =
+        left.rebalance(separator, right, newSeparator, newFragments);
+
+    if (moved == 0) { return false; }
+
+    if (parent.replaceKey(leftPos, newFragments ?
+                          NodeKey(newSeparator, *newFragments) :
+                          NodeKey(newSeparator)) != InsertResult::INSERTED)
+    {
+        throw std::logic_error("separator doesn't fit");
+    }
+
+    if (moved > 0) {
+        const size_t count = moved;
+        const auto endIt = right.visitorFrames.end();
+
+        for (auto it = right.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+
+            if (frame.position < count) {
+                rebindFrame(frame, left, leftChildren + frame.position);
+                rebindParentFrame(frame, parent, leftPos);
+            } else {
+                frame.position -= count;
+            }
+        }
+    } else {
+        const size_t count = -moved;
+        const size_t boundary = leftChildren - count;
+
+        for (auto& frame : right.visitorFrames) { frame.position += count; }
+
+        const auto endIt = left.visitorFrames.end();
+
+        for (auto it = left.visitorFrames.begin(); it != endIt; ) {
+            auto& frame = *it++;
+
+            if (frame.position >= boundary) {
+                rebindFrame(frame, right, frame.position - boundary);
+                rebindParentFrame(frame, parent, leftPos + 1);
+            }
+        }
+    }
+
+    return false;
+}
+
+/**
+  Splits source while storing the entry, and records the split for the parent
+  to be repaired. The sibling is latched while frames are moved to it, since
+  their cursors can reach it through them.
+
+  pre-conditions:  Source is latched, and has no pending split
+  post-conditions: Source is latched
+*/
+LeafNode* ops::splitLeaf(Tree& t, LeafNode& source, const size_t pos,
+                         const bool replace, const NodeKey& key,
+                         const LeafValue& value)
+{
+    assert(!source.hasSibling());
+
+    const auto sibling = t.allocateLeaf();
+    const Latch::scoped_exclusive_lock siblingLock(*sibling);
+
+    if (replace) {
+        source.splitAndUpdate(pos, value, *sibling);
+    } else {
+        source.splitAndInsert(pos, key, value, *sibling, t.mSplitPolicy);
+    }
+
+    moveFrames(source, *sibling, pos, !replace, key.bytes());
+
+    return sibling;
+}
+
+/**
+  Adjusts the positions of the frames bound to node after the entry for key
+  was inserted at insertPos. Frames positioned at the missing key become
+  bound to the new entry.
+
+  pre-conditions:  node is latched
+  post-conditions: node is latched
+*/
+void ops::insertFrames(LeafNode& node, const size_t insertPos, const Bytes key)
+{
+    for (auto& frame : node.visitorFrames) {
+        const auto originalPos = frame.position;
+
+        if (originalPos > insertPos) {
+            frame.position = originalPos + 1;
+        } else if (originalPos == insertPos) {
+            if (isFound(frame.notFoundKey)) {
+                frame.position = originalPos + 1;
+            } else if (equalKeys(frame.notFoundKey, key)) {
+                frame.notFoundKey = Bytes{};
+            } else if (key < frame.notFoundKey) {
+                frame.position = originalPos + 1;
+            }
+        }
+    }
+}
+
+/**
+  Moves the frames which now belong to the sibling, produced by splitting
+  source while storing the entry for key at insertPos.
+
+  pre-conditions:  Both source and sibling are latched
+  post-conditions: Both source and sibling are latched
+*/
+void ops::moveFrames(LeafNode& source, LeafNode& sibling,
+                     const size_t insertPos, const bool inserted,
+                     const Bytes key)
+{
+    if (inserted) { insertFrames(source, insertPos, key); }
+
+    const bool siblingIsRight =
+        source.split().direction == SiblingDirection::RIGHT;
+
+    const size_t splitPos = siblingIsRight ?
+        source.size() : sibling.size();
+
+    const Bytes splitKey(source.split().key);
+
+    const auto srcEndIt = source.visitorFrames.end();
+    const auto dstEndIt = sibling.visitorFrames.end();
+
+    for (auto srcIt = source.visitorFrames.begin(); srcIt != srcEndIt;) {
+        auto thisIt = srcIt;
+        ++srcIt;
+
+        const auto originalPos = thisIt->position;
+
+        // Frames for missing keys are positioned before the entry at their
+        // position. At the boundary they go to the side of the separator,
+        // which can be less than the first key of the right node.
+        const bool isRightHalf = originalPos > splitPos ||
+            (originalPos == splitPos &&
+             (isFound(thisIt->notFoundKey) ||
+              !(thisIt->notFoundKey < splitKey)));
+
+        if (isRightHalf) {
+            thisIt->position = originalPos - splitPos;
+        }
+
+        if (isRightHalf == siblingIsRight) {
+            thisIt->mNode.store(&sibling, std::memory_order_release);
+            sibling.visitorFrames.splice(
+                dstEndIt, source.visitorFrames, thisIt);
+        }
+    }
+}
+
+} }
@@ -17,8 +17,12 @@
 #ifndef _TUPL_PVT_OPS_HPP
 #define _TUPL_PVT_OPS_HPP
 
+#include "Buffer.hpp"
 #include "Latch.hpp"
-#include "slow/Node.hpp"
+#include "Node.hpp"
+
+#include <cstddef>
+#include <vector>
 
 namespace tupl {
 
@@ -30,7 +34,9 @@ namespace tupl { namespace pvt {
 
 class Cursor;
 class CursorFrame;
+struct Lookup;
 class Tree;
+struct Write;
 
 /**
    Class that encapsulates all the operations that need to work in conjunction
@@ -43,28 +49,208 @@ class ops final {
 public:    
     static void find(Tree& t, Cursor& visitor, Bytes key);
     
+    static void store(Tree& t, Cursor& visitor, Bytes value);
+    
+    static void first(Tree& t, Cursor& visitor);
+    
+    static void last(Tree& t, Cursor& visitor);
+    
+    static void next(Tree& t, Cursor& visitor);
+    
+    static void previous(Tree& t, Cursor& visitor);
+    
+    static void skip(Tree& t, Cursor& visitor, std::ptrdiff_t amount);
+    
+    static void findAll(Tree& t, std::vector<Lookup>& lookups);
+    
+    static void findInterleaved(Tree& t, std::vector<Lookup>& lookups);
+    
+    static void storeAll(Tree& t, const std::vector<Write>& writes);
+    
+    static bool insert(Tree& t, Bytes key, Bytes value);
+    
+    static bool replace(Tree& t, Bytes key, Bytes value);
+    
+    static bool update(Tree& t, Bytes key, Bytes oldValue, Bytes newValue);
+    
+    static bool exchange(Tree& t, Bytes key, Bytes value, Buffer& oldValue);
+    
+    static void reset(Cursor& visitor);
+    
+    static bool hasValue(const Cursor& visitor);
+    
+    static Bytes key(const Cursor& visitor);
+    
+    static Bytes value(const Cursor& visitor);
+    
 private:
     ops() = delete;
     
-    typedef slow::Node Node;
-    typedef slow::LeafNode LeafNode;
+    typedef pvt::Node Node;
+    typedef pvt::LeafNode LeafNode;
+    typedef pvt::InternalNode InternalNode;
     
-    static Latch::scoped_exclusive_lock unwindAndLockRoot(
-        Tree& tree, Cursor& visitor);
+    template<typename Lock = Latch::scoped_exclusive_lock>
+    static Lock unwindAndLockRoot(Tree& tree, Cursor& visitor);
     
-    static void bubbleSplitUpOneLevel(
-        Tree& t, Node& splitNodeParent, Node& splitNode);
+    template<typename Lock = Latch::scoped_exclusive_lock>
+    static Lock latchRoot(Tree& tree);
     
-    static void store(Tree& t, Cursor& visitor, Bytes value);
+    template<typename Lock = Latch::scoped_exclusive_lock>
+    static Lock latchFrameNode(CursorFrame& frame);
+    
+    static bool findOptimistic(Tree& tree, Cursor& visitor, Bytes key);
+    
+    static bool descend(Cursor& visitor, Bytes key, Node& start,
+                        Latch::scoped_shared_lock parentLock);
+    
+    static void findInLeaf(Cursor& visitor, LeafNode& leaf, Bytes key);
+    
+    static void bindPath(Tree& t, Cursor& visitor, Bytes key);
+    
+    static void findSorted(Tree& t, std::vector<Lookup>& lookups,
+                           std::vector<std::size_t> order);
+    
+    static void findAllBelow(Node& node, std::vector<Lookup>& lookups,
+                             const std::vector<std::size_t>& order,
+                             std::size_t begin, std::size_t end,
+                             std::vector<std::size_t>& blocked,
+                             std::vector<std::size_t>& repairs);
+    
+    static void findAllOptimistic(Tree& t, std::vector<Lookup>& lookups,
+                                  const std::vector<std::size_t>& order,
+                                  std::vector<std::size_t>& latched);
+    
+    static std::size_t findAllBelowOptimistic(
+        InternalNode& in, std::uint32_t version, std::vector<Lookup>& lookups,
+        const std::vector<std::size_t>& order, std::size_t begin,
+        std::size_t end, std::vector<std::size_t>& latched);
+    
+    static void findAllInLeaf(const LeafNode& leaf,
+                              std::vector<Lookup>& lookups,
+                              const std::vector<std::size_t>& order,
+                              std::size_t begin, std::size_t end);
+    
+    /**
+       Outcome of moving the cursor across leaves
+     */
+    enum class Move {
+        // Positioned at an entry
+        MOVED,
+        
+        // Positioned past the entries of a leaf which has none left in the
+        // direction of the move
+        CONTINUE,
+        
+        // No entry is left in the direction of the move
+        END,
+        
+        // The frames can't be followed, and are bound again by key
+        BLOCKED,
+    };
+    
+    static void toEdge(Tree& t, Cursor& visitor, bool forward);
+    
+    static void move(Tree& t, Cursor& visitor, bool forward);
+    
+    static void advance(Tree& t, Cursor& visitor, bool forward);
+    
+    static void rebind(Tree& t, Cursor& visitor);
+    
+    static Move climb(Tree& t, Cursor& visitor, bool forward,
+                      Buffer& repairKey);
+    
+    static Move turn(Cursor& visitor, CursorFrame& frame, InternalNode& node,
+                     Latch::scoped_shared_lock nodeLock, bool forward,
+                     Buffer& repairKey);
+    
+    static Move descendToEdge(Cursor& visitor, Node& start,
+                              Latch::scoped_shared_lock nodeLock,
+                              bool forward, Buffer& repairKey);
+    
+    struct Probe;
+    
+    static void step(Tree& t, Lookup& lookup, Probe& probe);
+    
+    static bool seekInLeaf(Cursor& visitor, CursorFrame& frame,
+                           LeafNode& leaf, std::ptrdiff_t pos, bool forward);
+    
+    static std::ptrdiff_t nextPosition(const CursorFrame& frame, bool forward);
+    
+    static void bindFrame(Cursor& visitor, Node& node,
+                          std::size_t position, Bytes notFoundKey);
+    
+    static void unbindFrame(CursorFrame& frame);
+    
+    static void unbindFrames(Cursor& visitor);
+    
+    static void unwindFrames(Cursor& visitor);
+    
+    static Latch::scoped_shared_lock unwindToCover(Cursor& visitor, Bytes key,
+                                                   Node*& node);
+    
+    static void rebindFrame(CursorFrame& frame, Node& node,
+                            std::size_t position);
+    
+    static void rebindParentFrame(CursorFrame& frame, InternalNode& parent,
+                                  std::size_t childPos);
+    
+    static void removeChildFrames(InternalNode& node, std::size_t childPos);
+    
+    static bool bubbleSplitUpOneLevel(
+        Tree& t, InternalNode& parent, Node& node);
+    
+    static void repairSplits(Tree& t, Bytes key);
+    
+    static Latch::scoped_exclusive_lock latchUnsplitLeaf(
+        Tree& t, CursorFrame& frame, Bytes key);
+    
+    static bool storeInLeaf(Tree& t, CursorFrame& frame, Bytes key,
+                            Bytes value);
+    
+    static Latch::scoped_exclusive_lock latchLeaf(Tree& t, Bytes key,
+                                                  LeafNode*& leaf,
+                                                  Buffer* upperKey = nullptr);
+    
+    static bool writeInLeaf(Tree& t, LeafNode& leaf, Bytes key, Bytes value);
+    
+    /**
+       Entry which a conditional store expects for its key
+     */
+    enum class Expect {
+        ABSENT,
+        PRESENT,
+        
+        // Any entry or none
+        ANY,
+        
+        // An entry with the expected value, or none if it's null
+        VALUE,
+    };
+    
+    static bool storeIf(Tree& t, Bytes key, Bytes value, Expect expect,
+                        Bytes expected, Buffer* oldValue);
+    
+    static LeafNode* splitLeaf(Tree& t, LeafNode& source, std::size_t pos,
+                               bool replace, const NodeKey& key,
+                               const LeafValue& value);
+    
+    static void remove(Tree& t, Cursor& visitor);
+    
+    static std::size_t removeGhosts(Tree& t, LeafNode& node);
+    
+    static void mergeUnderflow(Tree& t, Bytes key);
+    
+    static bool mergeLeaves(Tree& t, InternalNode& parent,
+                            std::size_t leftPos);
     
-    static LeafNode* splitLeaf(LeafNode& source, LeafNode::Iterator insertPos,
-                               Bytes key, Bytes value);
+    static bool mergeInternals(Tree& t, InternalNode& parent,
+                               std::size_t leftPos);
     
-    static void moveFrames(Node& source, Node& sibling,
-                           std::size_t insertPos, std::size_t splitPos);
+    static void insertFrames(LeafNode& node, std::size_t insertPos, Bytes key);
     
-    template<typename Node>
-    static void split(Node& source, Node& sibling);
+    static void moveFrames(LeafNode& source, LeafNode& sibling,
+                           std::size_t insertPos, bool inserted, Bytes key);
 };
 
 } }
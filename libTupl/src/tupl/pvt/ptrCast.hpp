@@ -34,7 +34,7 @@ D* ptrCast(void* src) {
  */ 
 template<typename D>
 const D* ptrCast(const void* src) {
-    return static_cast<D*>(src);
+    return static_cast<const D*>(src);
 }
 
 } }
@@ -16,50 +16,35 @@
 
 #include "Node.hpp"
 
+#include "../KeyComparator.hpp"
+
 #include <iterator>
 
 namespace tupl { namespace pvt { namespace slow {
 
 namespace {
 
-struct KeyLesser {
-    template<typename K, typename V>
-    bool operator()(const std::pair<K, V>& k1, const std::pair<K, V>& k2) const
-    {
-        return k1.first < k2.first;
-    }
-
-    template<typename K, typename V>
-    bool operator()(const std::pair<K, V>& k1, Bytes k2) const {
-        return std::lexicographical_compare(k1.first.begin(), k1.first.end(),
-                                            k2.data(), k2.data() + k2.size());
-    }
+/*
+  Returns the first entry in [begin, end) whose key is not less than key, and
+  true if it's an exact match
+ */
+template<typename It>
+std::pair<It, bool> lowerBound(const It begin, const It end, const Bytes key) {
+    KeyComparator comparator(key);
     
-    template<typename K, typename V>
-    bool operator()(Bytes k1, const std::pair<K, V>& k2) const {
-        return std::lexicographical_compare(k1.data(), k1.data() + k1.size(),
-                                            k2.first.begin(), k2.first.end());
-    }
-};
-
-struct KeyEquals {
-    template<typename K, typename V>
-    bool operator()(Bytes k1, const std::pair<K, V>& k2) const {
-        return k1.size() == k2.first.size() &&
-            std::equal(k2.first.begin(), k2.first.end(), k1.data());
-    }
+    const auto result = comparator.lowerBound(
+        end - begin, [&](const size_t pos) {
+            return comparator.compare(begin[pos].first);
+        });
     
-    template<typename K, typename V>
-    bool operator()(const std::pair<K, V>& k1, Bytes k2) const {
-        return operator()(k2, k1);
-    }
-};
+    return std::make_pair(begin + result.first, result.second);
+}
 
 size_t valueSize(Bytes value) {
     return value.size();
 }
 
-size_t valueSize(const Node& node) {
+size_t valueSize(const pvt::Node& node) {
     return sizeof(&node);
 }
 
@@ -82,7 +67,7 @@ Buffer transformToNodeValue(Bytes value) {
     return Buffer{value.data(), value.size()};
 }
 
-Node* transformToNodeValue(Node& childNode) {
+pvt::Node* transformToNodeValue(pvt::Node& childNode) {
     return &childNode;
 }
 
@@ -94,27 +79,42 @@ public:
         // TODO: fold back into caller
         auto& children = node.mChildren;
         
-        const auto insertPos = std::lower_bound(
-            children.begin(), children.end(), key, KeyLesser());
+        const auto result = lowerBound(children.begin(), children.end(), key);
         
-        if (insertPos != children.end() && KeyEquals()(key, *insertPos)) {
+        if (result.second) {
             throw std::invalid_argument("duplicate key not allowed");
         }
         
-        return insert(insertPos, key, value, node);
+        return insert(result.first, key, value, node);
+    }
+    
+    static InternalNode::ChildMap::iterator find(Bytes key, InternalNode& node)
+    {
+        auto& children = node.mChildren;
+        
+        // The first child has no key and holds everything lower than the
+        // key of the second child
+        const auto result =
+            lowerBound(children.begin() + 1, children.end(), key);
+        
+        // An exact match is the first key of its child
+        return result.second ? result.first : result.first - 1;
     }
     
-    static InsertResult insert(Bytes key, Node& value, InternalNode& node) {
+    static InsertResult insert(Bytes key, pvt::Node& value, InternalNode& node)
+    {
         // TODO: fold back into caller
         auto& children = node.mChildren;
         
-        auto insertPos = std::lower_bound(
-            children.begin() + 1, children.end(), key, KeyLesser());
+        const auto result =
+            lowerBound(children.begin() + 1, children.end(), key);
         
-        if (insertPos != children.end() && KeyEquals()(key, *insertPos)) {
+        if (result.second) {
             throw std::invalid_argument("duplicate key not allowed");
         }
         
+        auto insertPos = result.first;
+        
         // This position has a pointer to children who's value is greater
         // than or equal to key. Move backwards for lower keys.
         --insertPos;
@@ -174,11 +174,10 @@ public:
         const auto beginIt = original.mChildren.begin();
         const auto endIt   = original.mChildren.end();
     
-        // TODO: Use custom lower_bound that checks for duplicates
-        const auto origInsertIt = std::lower_bound(
-            beginIt, endIt, key, KeyLesser());
+        const auto result = lowerBound(beginIt, endIt, key);
+        const auto origInsertIt = result.first;
         
-        if (origInsertIt != endIt && KeyEquals()(key, *origInsertIt)) {
+        if (result.second) {
             throw std::invalid_argument("duplicate key not allowed");
         }
 
@@ -197,8 +196,12 @@ public:
         
         Buffer splitKey;
         
-        if (original.type() == NodeType::LEAF) {
-            splitKey = splitBeginIt->first;
+        if (original.isLeaf()) {
+            // The new key starts the right half if inserted at the split
+            const Bytes high = origInsertIt == splitBeginIt ?
+                key : Bytes{splitBeginIt->first};
+            
+            splitKey = shortestSeparator((splitBeginIt - 1)->first, high);
         } else {
             // Saves split key for migration up to the parent
             splitKey.swap(splitBeginIt->first);
@@ -223,8 +226,9 @@ public:
     template<typename NodeT>
     static void recalculateBytesUsed(NodeT& node) {
         struct {
-            size_t operator()(const std::pair<Bytes, Node*>& kvPair) const {
-                return kvPair.first.size() + sizeof(Node*);
+            size_t operator()(const std::pair<Bytes, pvt::Node*>& kvPair) const
+            {
+                return kvPair.first.size() + sizeof(pvt::Node*);
             }
             
             size_t operator()(const std::pair<Bytes, Bytes>& kvPair) const {
@@ -243,25 +247,31 @@ public:
 /*---------------------------------------------------------------------------*/
 // InternalNode implementation 
 /*---------------------------------------------------------------------------*/
-InternalNode::InternalNode(Node& leftestChild) :
-    Node(NodeType::INTERNAL)
+InternalNode::InternalNode(pvt::Node& leftestChild) :
+    Node(Type::TN_IN)
 {
     mChildren.emplace_back(std::make_pair(Buffer{}, &leftestChild));
     // mChildren.emplace_back(std::make_pair(Buffer{key.data(), key.size()},
     //                                       &right));
 }
 
-InsertResult InternalNode::insert(Bytes key, Node& value)
+InternalNode::Iterator InternalNode::find(Bytes key) {
+    return { Ops::find(key, *this), BufferKeyToBytesKeyPair() };
+}
+
+InsertResult InternalNode::insert(Bytes key, pvt::Node& value)
 {
     return Ops::insert(key, value, *this);
 }
 
-InsertResult InternalNode::insert(Iterator position, Bytes key, Node& value)
+InsertResult InternalNode::insert(
+    Iterator position, Bytes key, pvt::Node& value)
 {
     return Ops::insert(position.base(), key, value, *this);
 }
 
-void InternalNode::splitAndInsert(Bytes key, Node& value, InternalNode& sibling)
+void InternalNode::splitAndInsert(
+    Bytes key, pvt::Node& value, InternalNode& sibling)
 {
     Ops::splitAndInsert(key, value, *this, sibling);
 }
@@ -31,106 +31,42 @@
  */
 
 #include "../../types.hpp"
-#include "../Latch.hpp"
-#include "../CursorFrame.hpp"
 #include "../Buffer.hpp"
+#include "../Node.hpp"
 #include "../ptrCast.hpp"
 
 #include <cassert>
 #include <vector>
 
 #include <boost/operators.hpp>
-#include <boost/intrusive/list.hpp>
 #include <boost/container/string.hpp>
 #include <boost/iterator/transform_iterator.hpp>
 
 namespace tupl { namespace pvt { namespace slow {
 
-enum class NodeType {
-    LEAF,
-    INTERNAL,
-    FRAGMENT,
-    ROOT,
-    UNDO_LOG
-};
-
-enum class SiblingDirection : bool {
-    LEFT  = 0x0,
-    RIGHT = 0x1,    
-};
-
-enum class InsertResult {
-    FAILED_NO_SPACE,
-    INSERTED,
-};
-
-class Node;
-
-template<typename NodeT>
-struct Split final {
-    NodeT* sibling;
-    SiblingDirection direction;
-    Buffer key;
-};
+using pvt::InsertResult;
+using pvt::SiblingDirection;
+using pvt::Split;
 
-class Node: public pvt::Latch {
+class Node: public pvt::Node {
 public:    
     // void bindCursorFrame(Iterator, pvt::CursorFrame);
-    NodeType type() const { return mNodeType; }
-    
-    void recordSplit(
-        Node& sibling, const SiblingDirection direction, Buffer&& splitKey)
-    {
-        assert(mSplit.sibling == nullptr);
-        mSplit.sibling = &sibling;
-        mSplit.direction = direction;
-        mSplit.key = splitKey;
-    }
     
     std::size_t bytes() { return mBytes; }
     
     size_t capacity() const { return mCapacity; }
     
-    
-    bool hasSibling() const { return mSplit.sibling != nullptr; }
-    
 protected:
     class Ops;
     
-    Node(NodeType nodeType) :
-        mNodeType(nodeType), mCapacity(4096), mBytes(0), mSplit() {}
+    Node(Type nodeType) :
+        pvt::Node(nodeType), mCapacity(4096), mBytes(0) {}
     
 private:
-    typedef boost::intrusive::list_member_hook<
-        boost::intrusive::link_mode<
-            boost::intrusive::safe_link>> ListMemberHook;
-
-    const NodeType mNodeType;
     const std::uint_fast16_t mCapacity;
     
 protected:
     std::uint_fast16_t mBytes;    
-    Split<Node> mSplit;
-    
-public:
-    // CursorFrame's bound to this Node
-    boost::intrusive::list<
-        CursorFrame,
-        boost::intrusive::constant_time_size<false>,
-        boost::intrusive::member_hook<
-            CursorFrame,
-            CursorFrame::ListMemberHook,
-            &CursorFrame::visitors_>
-        > visitorFrames;
-    
-    // Do nothing right now with the next two hooks.
-    // Needed for when we support eviction
-    // 
-    // Do not use directly, for manipluation by boost::intrusive container
-    ListMemberHook mDirtyListHook_; // guarded by the DB's usage latch
-    
-    // Do not use directly, for manipluation by boost::intrusive container
-    ListMemberHook mUsageListHook_; // guarded by the page allocator
     
     friend class ::tupl::pvt::slow::Node::Ops;
 };
@@ -160,7 +96,7 @@ public:
                                       ValuesMap::iterator
                                       > Iterator;
     
-    LeafNode() : Node(NodeType::LEAF) {}
+    LeafNode() : Node(Type::TN_LEAF) {}
     
     Iterator find(Bytes key);
 
@@ -188,10 +124,11 @@ private:
 };
 
 class InternalNode final: public Node {
-    typedef std::vector<std::pair<Buffer, Node*>> ChildMap;
+    typedef std::vector<std::pair<Buffer, pvt::Node*>> ChildMap;
 
     struct BufferKeyToBytesKeyPair {
-        std::pair<Bytes, Node*> operator()(const ChildMap::value_type& t) const
+        std::pair<Bytes, pvt::Node*> operator()(
+            const ChildMap::value_type& t) const
         {
             return std::make_pair(Bytes{t.first.data(),  t.first.size()},
                                   t.second);
@@ -203,16 +140,17 @@ public:
                                       ChildMap::iterator
                                       > Iterator;
     
-    InternalNode(Node& leftestChild);
+    InternalNode(pvt::Node& leftestChild);
     
     // InternalNode(LeafNode& leafChild);
     
     // InternalNode(InternalNode& internalChild)
     //     : Node(NodeType::INTERNAL), mLastChild(&internalChild), mBytes(0) {}
 
-    Iterator find(Bytes key) { throw std::logic_error("unimplemeted"); }
-    
-    Iterator lowerBound(Bytes key) { assert(0); }
+    /**
+       Returns an iterator to the child whose range of keys includes key
+     */
+    Iterator find(Bytes key);
     
     Iterator begin() { return { mChildren.begin(), BufferKeyToBytesKeyPair() };}
     Iterator end()   { return { mChildren.end(), BufferKeyToBytesKeyPair() }; }
@@ -249,11 +187,11 @@ public:
     
     bool empty() const { return mChildren.empty(); }
     
-    InsertResult insert(Iterator position, Bytes key, Node& value);
+    InsertResult insert(Iterator position, Bytes key, pvt::Node& value);
     
-    InsertResult insert(Bytes key, Node& value);
+    InsertResult insert(Bytes key, pvt::Node& value);
     
-    void splitAndInsert(Bytes key, Node& value, InternalNode& sibling);
+    void splitAndInsert(Bytes key, pvt::Node& value, InternalNode& sibling);
 private:
     
     ChildMap mChildren;
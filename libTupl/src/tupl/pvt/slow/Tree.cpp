@@ -47,7 +47,7 @@ void Tree::insert(Bytes key, Bytes value) {
 }
 
 void Tree::insertRecursive(Node& node, InsertContext& ctx) {
-    if (node.type() == NodeType::LEAF) {
+    if (node.isLeaf()) {
         auto& cur = *ptrCast<LeafNode>(&node);
         const auto insertResult = cur.insert(ctx.key, ctx.value);
         
@@ -56,11 +56,11 @@ void Tree::insertRecursive(Node& node, InsertContext& ctx) {
             cur.splitAndInsert(ctx.key, ctx.value, *ctx.tree.allocateLeaf());
         }
     } else {
-        assert(node.type() == NodeType::INTERNAL);
+        assert(!node.isLeaf());
         
         auto& cur = *ptrCast<InternalNode>(&node);
         auto nextIt = cur.find(ctx.key);
-        auto& next = *nextIt->second;
+        auto& next = *ptrCast<Node>(nextIt->second);
         
         insertRecursive(next, ctx);
         
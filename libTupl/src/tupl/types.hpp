@@ -66,7 +66,6 @@ Bytes::Bytes(const void* data, const std::size_t size)
     : mData(static_cast<const byte*>(data)), mSize(size)
 {
     assert(size > 0 ? data != nullptr : true);
-    assert(data == nullptr ? size > 0 : true);
 }
 
 inline
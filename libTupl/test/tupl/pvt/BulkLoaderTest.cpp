@@ -0,0 +1,155 @@
+#define BOOST_TEST_MODULE BulkLoaderTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/BulkLoader.hpp"
+#include "tupl/pvt/Cursor.hpp"
+#include "tupl/pvt/Tree.hpp"
+#include "tupl/pvt/ops.hpp"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+using std::string;
+using tupl::Bytes;
+using tupl::pvt::BulkLoader;
+using tupl::pvt::Cursor;
+using tupl::pvt::Tree;
+using tupl::pvt::ops;
+
+namespace {
+
+/*
+  Copies what a cursor found, for comparing it in checks
+ */
+string valueOf(const Cursor& cursor) {
+    const Bytes value = ops::value(cursor);
+    return string(value.data(), value.data() + value.size());
+}
+
+string makeKey(const size_t i) {
+    char key[64];
+    std::snprintf(key, sizeof(key), "tenant-0042|events|%010zu", i * 2);
+    return key;
+}
+
+string makeValue(const size_t i) {
+    return "value-" + std::to_string(i);
+}
+
+Tree::Stats load(Tree& tree, const size_t count, const double fillFactor) {
+    BulkLoader loader(tree, fillFactor);
+    
+    for (size_t i = 0; i < count; ++i) {
+        loader.add(makeKey(i), makeValue(i));
+    }
+    
+    loader.finish();
+    
+    return tree.stats();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(BulkLoaderLoadTest) {
+    const size_t count = 100000;
+    
+    Tree tree;
+    const auto stats = load(tree, count, 1.0);
+    
+    BOOST_CHECK_EQUAL(count, stats.entries);
+    BOOST_CHECK_GT(stats.height, 2);
+    BOOST_CHECK_GT(stats.leafFillFactor, 0.9);
+    BOOST_CHECK_GT(stats.keyPrefixSavings, 0);
+    
+    Cursor cursor;
+    
+    for (size_t i = 0; i < count; i += 7) {
+        ops::find(tree, cursor, makeKey(i));
+        BOOST_REQUIRE(ops::hasValue(cursor));
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(cursor));
+        
+        // Keys between the loaded ones are missing
+        ops::find(tree, cursor, makeKey(i) + '\0');
+        BOOST_CHECK(!ops::hasValue(cursor));
+    }
+    
+    ops::find(tree, cursor, makeKey(count - 1));
+    BOOST_CHECK_EQUAL(makeValue(count - 1), valueOf(cursor));
+    
+    ops::reset(cursor);
+}
+
+BOOST_AUTO_TEST_CASE(BulkLoaderFillFactorTest) {
+    Tree full, partial;
+    
+    const auto fullStats = load(full, 20000, 1.0);
+    const auto partialStats = load(partial, 20000, 0.5);
+    
+    BOOST_CHECK_EQUAL(fullStats.entries, partialStats.entries);
+    BOOST_CHECK_GT(partialStats.leafNodes, fullStats.leafNodes * 3 / 2);
+    BOOST_CHECK_LT(partialStats.leafFillFactor, 0.6);
+}
+
+BOOST_AUTO_TEST_CASE(BulkLoaderInvalidTest) {
+    Tree tree;
+    
+    BOOST_CHECK_THROW(BulkLoader(tree, 0.0), std::invalid_argument);
+    BOOST_CHECK_THROW(BulkLoader(tree, 1.5), std::invalid_argument);
+    
+    BulkLoader loader(tree);
+    loader.add(makeKey(2), makeValue(2));
+    
+    BOOST_CHECK_THROW(loader.add(makeKey(2), makeValue(2)),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(loader.add(makeKey(1), makeValue(1)),
+                      std::invalid_argument);
+    
+    loader.finish();
+    
+    BOOST_CHECK_THROW(loader.add(makeKey(3), makeValue(3)), std::logic_error);
+    
+    // Only empty trees can be loaded
+    BOOST_CHECK_THROW(BulkLoader{tree}, std::logic_error);
+}
+
+BOOST_AUTO_TEST_CASE(BulkLoaderLargeKeyTest) {
+    // Keys which only differ past the bytes kept inline by indirect keys,
+    // so the separators of the internal nodes are indirect too
+    const string path = "https://example.com/" + string(1500, 'p');
+    
+    auto makeLargeKey = [&](const size_t i) { return path + makeKey(i); };
+    
+    const size_t count = 3000;
+    
+    Tree tree;
+    BulkLoader loader(tree);
+    
+    for (size_t i = 0; i < count; ++i) {
+        loader.add(makeLargeKey(i), makeValue(i));
+    }
+    
+    loader.finish();
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(count, stats.entries);
+    BOOST_CHECK_GT(stats.height, 2);
+    BOOST_CHECK_GE(stats.fragmentNodes, count);
+    
+    Cursor cursor;
+    
+    for (size_t i = 0; i < count; i += 3) {
+        ops::find(tree, cursor, makeLargeKey(i));
+        BOOST_REQUIRE(ops::hasValue(cursor));
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(cursor));
+        
+        ops::find(tree, cursor, makeLargeKey(i) + '\0');
+        BOOST_CHECK(!ops::hasValue(cursor));
+    }
+    
+    ops::find(tree, cursor, path);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    
+    ops::reset(cursor);
+}
@@ -0,0 +1,114 @@
+#define BOOST_TEST_MODULE EpochsTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/Epochs.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using std::unique_ptr;
+using tupl::pvt::Epochs;
+
+namespace {
+
+/*
+  Counts the instances which were deleted
+ */
+class Tracked {
+public:
+    explicit Tracked(std::atomic<size_t>& deleted) : mDeleted(deleted) {}
+    
+    ~Tracked() { ++mDeleted; }
+
+private:
+    std::atomic<size_t>& mDeleted;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(EpochsGuardTest) {
+    std::atomic<size_t> deleted(0);
+    Epochs epochs;
+    
+    {
+        const Epochs::Guard guard(epochs);
+        
+        epochs.retire(unique_ptr<Tracked>(new Tracked(deleted)));
+        
+        // Nothing retired while a guard exists is deleted
+        for (size_t i = 0; i < 10; ++i) { epochs.reclaim(); }
+        
+        BOOST_CHECK_EQUAL(0, deleted.load());
+        BOOST_CHECK_EQUAL(1, epochs.retired());
+        
+        // Guards can be nested
+        const Epochs::Guard nested(epochs);
+        epochs.reclaim();
+        
+        BOOST_CHECK_EQUAL(0, deleted.load());
+    }
+    
+    epochs.reclaim();
+    epochs.reclaim();
+    
+    BOOST_CHECK_EQUAL(1, deleted.load());
+    BOOST_CHECK_EQUAL(0, epochs.retired());
+    
+    // Objects which are still retired are deleted along with the epochs
+    {
+        Epochs other;
+        other.retire(unique_ptr<Tracked>(new Tracked(deleted)));
+        
+        const Epochs::Guard guard(other);
+        other.retire(unique_ptr<Tracked>(new Tracked(deleted)));
+    }
+    
+    BOOST_CHECK_EQUAL(3, deleted.load());
+}
+
+BOOST_AUTO_TEST_CASE(EpochsConcurrentTest) {
+    std::atomic<size_t> retired(0);
+    Epochs epochs;
+    
+    // Readers keep following a shared pointer, which writers replace and
+    // retire. Address sanitized builds report reading a deleted object.
+    std::atomic<size_t*> shared(new size_t(0));
+    std::atomic<size_t> readSum(0);
+    std::atomic<bool> running(true);
+    std::vector<std::thread> threads;
+    
+    for (size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            while (running) {
+                const Epochs::Guard guard(epochs);
+                readSum += *shared.load();
+            }
+        });
+    }
+    
+    for (size_t t = 0; t < 2; ++t) {
+        threads.emplace_back([&] {
+            for (size_t i = 1; i <= 5000; ++i) {
+                const Epochs::Guard guard(epochs);
+                size_t* const previous = shared.exchange(new size_t(i));
+                
+                epochs.retire(unique_ptr<size_t>(previous));
+                ++retired;
+            }
+        });
+    }
+    
+    for (size_t t = 4; t < threads.size(); ++t) { threads[t].join(); }
+    
+    running = false;
+    
+    for (size_t t = 0; t < 4; ++t) { threads[t].join(); }
+    
+    BOOST_CHECK_EQUAL(10000, retired.load());
+    BOOST_CHECK_LT(epochs.retired(), retired.load());
+    
+    delete shared.load();
+}
@@ -0,0 +1,353 @@
+#define BOOST_TEST_MODULE InternalNodeTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/Node.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::ostringstream;
+using std::string;
+using std::unique_ptr;
+using std::uintptr_t;
+using std::vector;
+using tupl::Bytes;
+using tupl::pvt::Buffer;
+using tupl::pvt::FragmentNode;
+using tupl::pvt::InsertResult;
+using tupl::pvt::InternalNode;
+using tupl::pvt::LeafNode;
+using tupl::pvt::Node;
+using tupl::pvt::NodeKey;
+using tupl::pvt::SiblingDirection;
+
+namespace {
+
+string toString(const Bytes bytes) {
+    return string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+bool isOrdered(const InternalNode& node) {
+    for (size_t i = 1; i < node.size(); ++i) {
+        if (!(node.key(i - 1) < node.key(i))) { return false; }
+    }
+
+    return true;
+}
+
+string makeKey(const size_t i) {
+    ostringstream keyStr;
+    keyStr << "key-" << 100000 + i;
+    return keyStr.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeBasicTest) {
+    LeafNode left, middle, right;
+    InternalNode node(left);
+
+    BOOST_CHECK(node.type() == Node::Type::TN_BIN);
+    BOOST_CHECK_EQUAL(0, node.size());
+    BOOST_CHECK_EQUAL(&left, node.child(0));
+    BOOST_CHECK_EQUAL(0, node.childPos(string("any")));
+
+    BOOST_CHECK(InsertResult::INSERTED == node.insert(string("m"), right));
+    BOOST_CHECK(InsertResult::INSERTED == node.insert(string("g"), middle));
+
+    BOOST_CHECK_THROW(node.insert(string("g"), middle), std::invalid_argument);
+
+    BOOST_CHECK_EQUAL(2, node.size());
+    BOOST_CHECK_EQUAL("g", toString(node.key(0)));
+    BOOST_CHECK_EQUAL("m", toString(node.key(1)));
+
+    BOOST_CHECK_EQUAL(&left, node.child(0));
+    BOOST_CHECK_EQUAL(&middle, node.child(1));
+    BOOST_CHECK_EQUAL(&right, node.child(2));
+
+    // Each child covers the keys from its left key up to its right key
+    BOOST_CHECK_EQUAL(0, node.childPos(string("a")));
+    BOOST_CHECK_EQUAL(1, node.childPos(string("g")));
+    BOOST_CHECK_EQUAL(1, node.childPos(string("h")));
+    BOOST_CHECK_EQUAL(2, node.childPos(string("m")));
+    BOOST_CHECK_EQUAL(2, node.childPos(string("z")));
+    
+    // Optimistic reads find the same children
+    for (const string key : {"a", "g", "h", "m", "z"}) {
+        BOOST_CHECK_EQUAL(node.child(node.childPos(key)),
+                          node.optimisticChild(key));
+    }
+
+    // header bytes + key bytes + search vector slots + narrow child
+    // identifiers
+    BOOST_CHECK_EQUAL((1 + 1) * 2 + 2 * 2 + 6 * 3, node.bytes());
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeLeftInsertTest) {
+    LeafNode first, second;
+    InternalNode node(second);
+
+    // A sibling produced on the left of the first child
+    BOOST_CHECK(InsertResult::INSERTED ==
+                node.insert(0, string("k"), first, SiblingDirection::LEFT));
+
+    BOOST_CHECK_EQUAL(&first, node.child(0));
+    BOOST_CHECK_EQUAL(&second, node.child(1));
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeFillAndSplitTest) {
+    vector<unique_ptr<LeafNode>> children;
+    children.emplace_back(new LeafNode);
+
+    InternalNode node(*children.back());
+
+    // Insert in an order which exercises both sides of the search vector
+    size_t count = 0;
+
+    for (;; ++count) {
+        const size_t i = (count & 1) ? 5000 - count : 5000 + count;
+        children.emplace_back(new LeafNode);
+
+        if (node.insert(makeKey(i), *children.back()) ==
+            InsertResult::FAILED_NO_SPACE)
+        {
+            children.pop_back();
+            break;
+        }
+    }
+
+    BOOST_CHECK(count > 100);
+    BOOST_CHECK_EQUAL(count, node.size());
+    BOOST_CHECK(isOrdered(node));
+    BOOST_CHECK(node.availableBytes() < 2 + 8 + 12);
+
+    // Every child must still be reachable through its key
+    for (size_t pos = 0; pos < node.size(); ++pos) {
+        BOOST_CHECK_EQUAL(pos + 1, node.childPos(node.key(pos)));
+    }
+
+    vector<Node*> expected;
+
+    for (size_t pos = 0; pos <= node.size(); ++pos) {
+        expected.push_back(node.child(pos));
+    }
+
+    const string newKey = makeKey(10);
+    const size_t keyPos = node.lowerBound(newKey).first;
+    LeafNode newChild;
+    InternalNode sibling;
+
+    node.splitAndInsert(keyPos, newKey, newChild, SiblingDirection::RIGHT,
+                        sibling);
+    expected.insert(expected.begin() + keyPos + 1, &newChild);
+
+    BOOST_REQUIRE(node.hasSibling());
+
+    const auto& split = node.split();
+
+    BOOST_CHECK_EQUAL(&sibling, split.sibling);
+    BOOST_CHECK(sibling.type() == node.type());
+    BOOST_CHECK(isOrdered(node));
+    BOOST_CHECK(isOrdered(sibling));
+
+    // The split key is removed from both halves
+    const bool siblingIsLeft = split.direction == SiblingDirection::LEFT;
+    const InternalNode& leftNode = siblingIsLeft ? sibling : node;
+    const InternalNode& rightNode = siblingIsLeft ? node : sibling;
+
+    BOOST_CHECK_EQUAL(count, leftNode.size() + rightNode.size());
+    BOOST_CHECK(leftNode.key(leftNode.size() - 1) < split.key);
+    BOOST_CHECK(split.key < rightNode.key(0));
+
+    vector<Node*> actual;
+
+    for (size_t pos = 0; pos <= leftNode.size(); ++pos) {
+        actual.push_back(leftNode.child(pos));
+    }
+
+    for (size_t pos = 0; pos <= rightNode.size(); ++pos) {
+        actual.push_back(rightNode.child(pos));
+    }
+
+    BOOST_CHECK(expected == actual);
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeWideChildIdTest) {
+    vector<unique_ptr<LeafNode>> children;
+    children.emplace_back(new LeafNode);
+    
+    InternalNode node(*children.back());
+    
+    for (size_t i = 0; i < 10; ++i) {
+        children.emplace_back(new LeafNode);
+        node.insert(makeKey(i * 2), *children.back());
+    }
+    
+    const size_t narrowBytes = node.bytes();
+    
+    // A child which needs all 8 bytes, only stored and never dereferenced
+    Node& far = *reinterpret_cast<Node*>(uintptr_t(0x12345678) << 32);
+    
+    BOOST_CHECK(InsertResult::INSERTED == node.insert(makeKey(7), far));
+    // Every identifier widens by 2 bytes, plus the new key, slot and child
+    BOOST_CHECK_EQUAL(narrowBytes + 11 * 2 + (1 + 10) + 2 + 8, node.bytes());
+    
+    BOOST_CHECK_EQUAL(&far, node.child(node.childPos(makeKey(7))));
+    
+    for (size_t i = 0; i < 10; ++i) {
+        BOOST_CHECK_EQUAL(children[i + 1].get(),
+                          node.child(node.childPos(makeKey(i * 2))));
+    }
+    
+    BOOST_CHECK_EQUAL(children[0].get(), node.child(0));
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeIndirectKeyTest) {
+    vector<unique_ptr<LeafNode>> children;
+    vector<unique_ptr<FragmentNode>> fragments;
+    children.emplace_back(new LeafNode);
+    
+    InternalNode node(*children.back());
+    
+    const string path = "/srv/" + string(3000, 's') + '/';
+    
+    // Each key fits a single fragment
+    auto indirectKey = [&](const string& key) {
+        fragments.emplace_back(new FragmentNode);
+        fragments.back()->assign(key, nullptr);
+        return NodeKey(key, *fragments.back());
+    };
+    
+    vector<string> keys;
+    
+    for (size_t i = 0; ; ++i) {
+        keys.push_back(path + makeKey(i * 2));
+        children.emplace_back(new LeafNode);
+        
+        if (node.insert(indirectKey(keys.back()), *children.back()) ==
+            InsertResult::FAILED_NO_SPACE)
+        {
+            keys.pop_back();
+            children.pop_back();
+            break;
+        }
+    }
+    
+    BOOST_CHECK_GT(keys.size(), 5);
+    BOOST_CHECK(isOrdered(node));
+    BOOST_CHECK_EQUAL(0, node.childPos(path));
+    
+    for (size_t i = 0; i < keys.size(); ++i) {
+        BOOST_CHECK(keys[i] == toString(node.key(i)));
+        BOOST_CHECK_EQUAL(children[i + 1].get(),
+                          node.child(node.childPos(keys[i])));
+        BOOST_CHECK_EQUAL(children[i + 1].get(),
+                          node.child(node.childPos(keys[i] + '\0')));
+    }
+    
+    // The split key moves up along with its fragments
+    const string newKey = path + makeKey(1);
+    LeafNode newChild;
+    InternalNode sibling;
+    
+    node.splitAndInsert(node.lowerBound(newKey).first, indirectKey(newKey),
+                        newChild, SiblingDirection::RIGHT, sibling);
+    
+    const auto& split = node.split();
+    
+    BOOST_CHECK_GT(split.key.size(), path.size());
+    BOOST_REQUIRE(split.keyFragments != nullptr);
+    BOOST_CHECK(toString(split.key) == toString(split.keyFragments->data()));
+    
+    const bool siblingIsLeft = split.direction == SiblingDirection::LEFT;
+    const InternalNode& leftNode = siblingIsLeft ? sibling : node;
+    const InternalNode& rightNode = siblingIsLeft ? node : sibling;
+    
+    BOOST_CHECK(leftNode.key(leftNode.size() - 1) < split.key);
+    BOOST_CHECK(split.key < rightNode.key(0));
+    BOOST_CHECK_EQUAL(&newChild, leftNode.child(leftNode.childPos(newKey)));
+}
+
+BOOST_AUTO_TEST_CASE(InternalNodeMergeTest) {
+    vector<unique_ptr<LeafNode>> children;
+    children.emplace_back(new LeafNode);
+    
+    InternalNode left(*children.back());
+    
+    for (size_t i = 0; i < 10; ++i) {
+        children.emplace_back(new LeafNode);
+        left.insert(makeKey(i), *children.back());
+    }
+    
+    children.emplace_back(new LeafNode);
+    
+    InternalNode right(*children.back());
+    
+    for (size_t i = 11; i < 50; ++i) {
+        children.emplace_back(new LeafNode);
+        right.insert(makeKey(i), *children.back());
+    }
+    
+    // The separator passes down into the fuller node's sibling and the key
+    // nearest to it moves up in its place
+    Buffer newSeparator;
+    FragmentNode* newSeparatorFragments = nullptr;
+    
+    const auto moved = left.rebalance(makeKey(10), right, newSeparator,
+                                      newSeparatorFragments);
+    
+    BOOST_CHECK_GT(moved, 0);
+    BOOST_CHECK(newSeparatorFragments == nullptr);
+    BOOST_CHECK_EQUAL(10 + moved, left.size());
+    BOOST_CHECK_EQUAL(49, left.size() + right.size());
+    BOOST_CHECK(isOrdered(left));
+    BOOST_CHECK(isOrdered(right));
+    BOOST_CHECK(makeKey(10 + moved) == toString(newSeparator));
+    BOOST_CHECK(left.key(left.size() - 1) < Bytes(newSeparator));
+    BOOST_CHECK(Bytes(newSeparator) < right.key(0));
+    
+    // Removing a key also removes the child following it
+    Node* const next = right.child(2);
+    right.remove(0);
+    
+    BOOST_CHECK_EQUAL(next, right.child(1));
+    
+    // Merging keeps every child in order
+    vector<Node*> expected;
+    
+    for (size_t pos = 0; pos <= left.size(); ++pos) {
+        expected.push_back(left.child(pos));
+    }
+    
+    for (size_t pos = 0; pos <= right.size(); ++pos) {
+        expected.push_back(right.child(pos));
+    }
+    
+    const size_t rightSize = right.size();
+    const size_t leftSize = left.size();
+    
+    BOOST_CHECK(left.merge(string(newSeparator.begin(), newSeparator.end()),
+                           right));
+    BOOST_CHECK_EQUAL(leftSize + 1 + rightSize, left.size());
+    BOOST_CHECK(isOrdered(left));
+    
+    vector<Node*> actual;
+    
+    for (size_t pos = 0; pos <= left.size(); ++pos) {
+        actual.push_back(left.child(pos));
+    }
+    
+    BOOST_CHECK(expected == actual);
+    
+    // Replacing a key keeps its child
+    Node* const child = left.child(3);
+    
+    BOOST_CHECK(InsertResult::INSERTED ==
+                left.replaceKey(2, makeKey(2) + "-replaced"));
+    BOOST_CHECK(makeKey(2) + "-replaced" == toString(left.key(2)));
+    BOOST_CHECK_EQUAL(child, left.child(3));
+}
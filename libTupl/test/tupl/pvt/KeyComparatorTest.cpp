@@ -0,0 +1,113 @@
+#define BOOST_TEST_MODULE KeyComparatorTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/KeyComparator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using tupl::Bytes;
+using tupl::pvt::KeyComparator;
+
+namespace {
+
+int sign(const int value) { return (value > 0) - (value < 0); }
+
+// Reference comparison, as unsigned bytes
+int compare(const string& l, const string& r) {
+    const size_t size = std::min(l.size(), r.size());
+    const int result = size ? std::memcmp(l.data(), r.data(), size) : 0;
+    
+    return result ? sign(result) : sign(int(l.size()) - int(r.size()));
+}
+
+/*
+  Compares with a comparator which hasn't seen any other keys
+ */
+int compareOnce(const string& key, const string& nodeKey, size_t offset = 0) {
+    KeyComparator comparator(key);
+    return sign(comparator.compare(nodeKey, offset));
+}
+
+/*
+  Sorted keys which share long prefixes, and only differ in a few bytes
+ */
+vector<string> makeKeys(std::mt19937& random, const size_t count) {
+    std::uniform_int_distribution<int> lengths(0, 40);
+    std::uniform_int_distribution<int> bytes(0, 3);
+    
+    std::set<string, bool(*)(const string&, const string&)> keys(
+        [](const string& l, const string& r) { return compare(l, r) < 0; });
+    
+    while (keys.size() < count) {
+        string key(lengths(random), '\0');
+        
+        for (auto& b : key) { b = static_cast<char>(bytes(random) * 0x55); }
+        
+        keys.insert(key);
+    }
+    
+    return vector<string>(keys.begin(), keys.end());
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(KeyComparatorCompareTest) {
+    const string key = "abcdefghijklmnop";
+    
+    BOOST_CHECK_EQUAL(0, compareOnce(key, key));
+    BOOST_CHECK_EQUAL(-1, compareOnce(key, "abc"));
+    BOOST_CHECK_EQUAL(1, compareOnce(key, "b"));
+    BOOST_CHECK_EQUAL(-1, compareOnce(key, ""));
+    BOOST_CHECK_EQUAL(1, compareOnce(key, key + '\0'));
+    
+    // High bytes compare as unsigned
+    BOOST_CHECK_EQUAL(1, compareOnce(key, "abcdefghijk\xff"));
+    
+    // Keys which exclude a known prefix
+    BOOST_CHECK_EQUAL(0, compareOnce(key, "defghijklmnop", 3));
+    BOOST_CHECK_EQUAL(-1, compareOnce(key, "defghijklmno", 3));
+    BOOST_CHECK_EQUAL(1, compareOnce(key, "z", 3));
+    
+    // Bytes known to match aren't compared again
+    KeyComparator comparator(key);
+    BOOST_CHECK_EQUAL(-1, sign(comparator.compare(string("abcdefgh"))));
+    BOOST_CHECK_EQUAL(1, sign(comparator.compare(string("abcdefghz"))));
+    BOOST_CHECK_EQUAL(0, sign(comparator.compare(string("abcdefghijklmnop"))));
+}
+
+BOOST_AUTO_TEST_CASE(KeyComparatorLowerBoundTest) {
+    std::mt19937 random(42);
+    
+    for (size_t round = 0; round < 20; ++round) {
+        const auto keys = makeKeys(random, 200);
+        const auto searches = makeKeys(random, 400);
+        
+        for (const auto& search : searches) {
+            KeyComparator comparator(search);
+            
+            const auto result = comparator.lowerBound(
+                keys.size(), [&](const size_t pos) {
+                    return comparator.compare(keys[pos]);
+                });
+            
+            const size_t expected = std::lower_bound(
+                keys.begin(), keys.end(), search,
+                [](const string& l, const string& r) {
+                    return compare(l, r) < 0;
+                }) - keys.begin();
+            
+            BOOST_REQUIRE_EQUAL(expected, result.first);
+            BOOST_REQUIRE_EQUAL(
+                expected < keys.size() && keys[expected] == search,
+                result.second);
+        }
+    }
+}
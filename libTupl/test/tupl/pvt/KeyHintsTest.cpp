@@ -0,0 +1,113 @@
+#define BOOST_TEST_MODULE KeyHintsTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/KeyHints.hpp"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+using tupl::Bytes;
+using tupl::pvt::KeyHints;
+
+namespace {
+
+/*
+  Sorted keys sharing a prefix, whose next bytes often repeat so that many
+  keys have the same hint
+ */
+vector<string> makeSortedKeys(const size_t count, const unsigned seed) {
+    std::mt19937 random(seed);
+    std::set<string> keys;
+    
+    while (keys.size() < count) {
+        string key = "shared-";
+        const size_t suffixSize = random() % 8;
+        
+        for (size_t i = 0; i < suffixSize; ++i) {
+            key += static_cast<char>("\x00\x01\x7f\x80\xff"[random() % 5]);
+        }
+        
+        keys.insert(key);
+    }
+    
+    // Keys which are lower and higher than the prefix
+    keys.insert("shar");
+    keys.insert("alpha");
+    keys.insert("zulu");
+    
+    return vector<string>(keys.begin(), keys.end());
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(KeyHintsHintTest) {
+    KeyHints hints;
+    
+    BOOST_CHECK_EQUAL(0x61620000u, hints.hint(string("ab")));
+    BOOST_CHECK_EQUAL(0x61626364u, hints.hint(string("abcdef")));
+    BOOST_CHECK_EQUAL(0u, hints.hint(string()));
+    
+    hints.reset(string("key-"));
+    
+    BOOST_CHECK_EQUAL(0x31000000u, hints.hint(string("key-1")));
+    BOOST_CHECK_EQUAL(0u, hints.hint(string("key-")));
+    BOOST_CHECK_EQUAL(0u, hints.hint(string("key")));
+    BOOST_CHECK_EQUAL(0u, hints.hint(string("aaaaa")));
+    BOOST_CHECK_EQUAL(0xffffffffu, hints.hint(string("kez")));
+    
+    // Hints are compared as unsigned
+    BOOST_CHECK_EQUAL(0xff000000u, hints.hint(string("key-\xff")));
+}
+
+BOOST_AUTO_TEST_CASE(KeyHintsRangeTest) {
+    KeyHints hints;
+    
+    for (const unsigned hint : {0u, 5u, 5u, 5u, 0x80000000u, 0xffffffffu}) {
+        hints.append(hint);
+    }
+    
+    BOOST_CHECK_EQUAL(6, hints.size());
+    BOOST_CHECK_EQUAL(0x80000000u, hints.at(4));
+    
+    BOOST_CHECK(std::make_pair(size_t(0), size_t(1)) == hints.range(0));
+    BOOST_CHECK(std::make_pair(size_t(1), size_t(1)) == hints.range(1));
+    BOOST_CHECK(std::make_pair(size_t(1), size_t(4)) == hints.range(5));
+    BOOST_CHECK(std::make_pair(size_t(4), size_t(5)) ==
+                hints.range(0x80000000u));
+    BOOST_CHECK(std::make_pair(size_t(5), size_t(6)) ==
+                hints.range(0xffffffffu));
+    
+    hints.insert(0, 0u);
+    BOOST_CHECK(std::make_pair(size_t(0), size_t(2)) == hints.range(0));
+}
+
+BOOST_AUTO_TEST_CASE(KeyHintsRandomizedRangeTest) {
+    for (unsigned seed = 1; seed <= 20; ++seed) {
+        const auto keys = makeSortedKeys(3 + seed * 7, seed);
+        
+        KeyHints hints;
+        hints.reset(string("shared-"));
+        
+        for (const auto& key : keys) { hints.append(hints.hint(key)); }
+        
+        for (size_t i = 1; i < hints.size(); ++i) {
+            BOOST_CHECK(hints.at(i - 1) <= hints.at(i));
+        }
+        
+        // The lower bound of every search key must be within its range
+        for (const auto& search : makeSortedKeys(50, seed + 100)) {
+            const auto range = hints.range(hints.hint(search));
+            const size_t expected =
+                std::lower_bound(keys.begin(), keys.end(), search) -
+                keys.begin();
+            
+            BOOST_CHECK(range.first <= expected && expected <= range.second);
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#define BOOST_TEST_MODULE LatchTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/Latch.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using std::thread;
+using std::vector;
+using tupl::pvt::Latch;
+
+BOOST_AUTO_TEST_CASE(LatchBasicTest) {
+    Latch latch;
+    
+    {
+        Latch::scoped_shared_lock first(latch);
+        Latch::scoped_shared_lock second(latch);
+        
+        // Shared holders exclude exclusive ones, but not each other
+        BOOST_CHECK(!latch.try_lock());
+        BOOST_CHECK(latch.try_lock_shared());
+        latch.unlock_shared();
+    }
+    
+    {
+        Latch::scoped_exclusive_lock exclusive(latch);
+        
+        BOOST_CHECK(!latch.try_lock());
+        BOOST_CHECK(!latch.try_lock_shared());
+    }
+    
+    BOOST_CHECK(latch.try_lock());
+    latch.unlock();
+}
+
+BOOST_AUTO_TEST_CASE(LatchContentionTest) {
+    Latch latch;
+    
+    // Guarded by latch; written non-atomically so that races show up as
+    // torn pairs
+    size_t first = 0;
+    size_t second = 0;
+    std::atomic<size_t> tornReads(0);
+    
+    const size_t threadCount = 8;
+    const size_t iterations = 20000;
+    vector<thread> threads;
+    
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            for (size_t i = 0; i < iterations; ++i) {
+                if ((i + t) % 4 == 0) {
+                    Latch::scoped_exclusive_lock exclusive(latch);
+                    ++first;
+                    ++second;
+                } else {
+                    Latch::scoped_shared_lock shared(latch);
+                    
+                    if (first != second) { ++tornReads; }
+                }
+            }
+        });
+    }
+    
+    for (auto& t : threads) { t.join(); }
+    
+    BOOST_CHECK_EQUAL(0, tornReads.load());
+    BOOST_CHECK_EQUAL(threadCount * iterations / 4, first);
+    BOOST_CHECK_EQUAL(first, second);
+}
+
+BOOST_AUTO_TEST_CASE(LatchOptimisticTest) {
+    Latch latch;
+    std::uint32_t version;
+    
+    BOOST_REQUIRE(latch.tryOptimistic(version));
+    
+    // Shared holders don't invalidate optimistic reads
+    latch.lock_shared();
+    latch.unlock_shared();
+    
+    BOOST_CHECK(latch.validate(version));
+    
+    latch.lock();
+    
+    std::uint32_t lockedVersion;
+    
+    BOOST_CHECK(!latch.tryOptimistic(lockedVersion));
+    BOOST_CHECK(!latch.validate(version));
+    
+    latch.unlock();
+    
+    BOOST_CHECK(!latch.validate(version));
+    BOOST_CHECK(latch.tryOptimistic(version));
+    BOOST_CHECK(latch.validate(version));
+}
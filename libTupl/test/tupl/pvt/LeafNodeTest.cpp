@@ -0,0 +1,708 @@
+#define BOOST_TEST_MODULE LeafNodeTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/Node.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using std::ostringstream;
+using std::string;
+using tupl::Bytes;
+using tupl::pvt::Buffer;
+using tupl::pvt::FragmentNode;
+using tupl::pvt::InsertResult;
+using tupl::pvt::LeafNode;
+using tupl::pvt::LeafValue;
+using tupl::pvt::NodeKey;
+using tupl::pvt::SiblingDirection;
+using tupl::pvt::SplitPolicy;
+
+namespace {
+
+string toString(const Bytes bytes) {
+    return string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+bool isOrdered(const LeafNode& node) {
+    for (size_t i = 1; i < node.size(); ++i) {
+        if (!(node.key(i - 1) < node.key(i))) { return false; }
+    }
+    
+    return true;
+}
+
+bool contains(const LeafNode& node, const string& key, const string& value) {
+    const auto it = node.find(key);
+    return it != node.end() && toString(it->second) == value;
+}
+
+string makeKey(const size_t i) {
+    ostringstream keyStr;
+    keyStr << "key-" << i;
+    return keyStr.str();
+}
+
+string makeValue(const size_t i, const size_t length) {
+    ostringstream valueStr;
+    valueStr << "value-" << i << '-' << string(length, 'v');
+    return valueStr.str();
+}
+
+/*
+  Copies data into a chain of fragment nodes owned by fragments, and returns
+  the first one
+ */
+FragmentNode& makeFragments(
+    std::vector<std::unique_ptr<FragmentNode>>& fragments, const string& data)
+{
+    FragmentNode* next = nullptr;
+    size_t end = data.size();
+    
+    for (;;) {
+        fragments.emplace_back(new FragmentNode);
+        
+        const size_t begin = end - std::min(end, fragments.back()->capacity());
+        fragments.back()->assign(Bytes{data.data() + begin, end - begin},
+                                 next);
+        next = fragments.back().get();
+        
+        if ((end = begin) == 0) { return *next; }
+    }
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeBasicTest) {
+    LeafNode node;
+    
+    const string key = "key-0";
+    const string value = "value-0";
+    
+    BOOST_CHECK_EQUAL(0, node.size());
+    BOOST_CHECK(node.find(key) == node.end());
+    
+    BOOST_CHECK(InsertResult::INSERTED == node.insert(key, value));
+    
+    BOOST_CHECK_EQUAL(1, node.size());
+    BOOST_CHECK(contains(node, key, value));
+    
+    // header bytes + key bytes + value bytes + search vector slot
+    BOOST_CHECK_EQUAL(1 + key.size() + 1 + value.size() + 2, node.bytes());
+    
+    BOOST_CHECK_THROW(node.insert(key, value), std::invalid_argument);
+    
+    // Empty keys and values are distinct from missing ones
+    BOOST_CHECK(InsertResult::INSERTED == node.insert(string(), string()));
+    BOOST_CHECK(contains(node, string(), string()));
+    BOOST_CHECK(isOrdered(node));
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeFillTest) {
+    LeafNode node;
+    std::map<string, string> expected;
+    
+    // Insert in an order which exercises both sides of the search vector
+    for (size_t i = 0; ; ++i) {
+        const size_t n = (i * 7919) % 1000;
+        const string key = makeKey(n);
+        const string value = makeValue(n, n % 150);
+        
+        if (expected.count(key)) { continue; }
+        
+        if (node.insert(key, value) != InsertResult::INSERTED) {
+            break;
+        }
+        
+        expected[key] = value;
+    }
+    
+    BOOST_CHECK_EQUAL(expected.size(), node.size());
+    BOOST_CHECK(isOrdered(node));
+    BOOST_CHECK_LT(node.availableBytes(), node.capacity() / 4);
+    
+    for (const auto& kv : expected) {
+        BOOST_CHECK(contains(node, kv.first, kv.second));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeUpdateTest) {
+    LeafNode node;
+    
+    for (size_t i = 0; i < 20; ++i) {
+        BOOST_CHECK(InsertResult::INSERTED ==
+                    node.insert(makeKey(i), makeValue(i, 10)));
+    }
+    
+    const size_t bytes = node.bytes();
+    
+    // Shrinking and growing values leaves garbage behind
+    const auto pos = node.lowerBound(makeKey(5));
+    BOOST_REQUIRE(pos.second);
+    
+    BOOST_CHECK(InsertResult::INSERTED == node.update(pos.first, string("tiny")));
+    BOOST_CHECK(contains(node, makeKey(5), "tiny"));
+    BOOST_CHECK_LT(node.bytes(), bytes);
+    
+    const string large = makeValue(5, 200);
+    BOOST_CHECK(InsertResult::INSERTED == node.update(pos.first, large));
+    BOOST_CHECK(contains(node, makeKey(5), large));
+    
+    for (size_t i = 0; i < 20; ++i) {
+        if (i != 5) { BOOST_CHECK(contains(node, makeKey(i), makeValue(i, 10))); }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeGhostTest) {
+    LeafNode node;
+    
+    for (size_t i = 0; i < 20; ++i) {
+        BOOST_CHECK(InsertResult::INSERTED ==
+                    node.insert(makeKey(i), makeValue(i, 10)));
+    }
+    
+    const size_t bytes = node.bytes();
+    
+    // Ghosting leaves every entry where it was
+    std::vector<size_t> ghostPositions;
+    
+    for (size_t i = 0; i < 20; i += 3) {
+        const auto pos = node.lowerBound(makeKey(i));
+        BOOST_REQUIRE(pos.second);
+        
+        node.ghost(pos.first);
+        ghostPositions.push_back(pos.first);
+    }
+    
+    std::sort(ghostPositions.begin(), ghostPositions.end());
+    
+    BOOST_CHECK_EQUAL(20, node.size());
+    BOOST_CHECK_EQUAL(ghostPositions.size(), node.ghosts());
+    BOOST_CHECK_LT(node.bytes(), bytes);
+    BOOST_CHECK(isOrdered(node));
+    
+    for (size_t i = 0; i < 20; ++i) {
+        const auto pos = node.lowerBound(makeKey(i));
+        BOOST_REQUIRE(pos.second);
+        
+        BOOST_CHECK_EQUAL(i % 3 == 0, node.isGhost(pos.first));
+        
+        if (i % 3 == 0) {
+            BOOST_CHECK(node.value(pos.first).data() == nullptr);
+        } else {
+            BOOST_CHECK(contains(node, makeKey(i), makeValue(i, 10)));
+        }
+    }
+    
+    // Storing a value revives a ghost
+    const auto revived = node.lowerBound(makeKey(3));
+    BOOST_CHECK(InsertResult::INSERTED ==
+                node.update(revived.first, string("revived")));
+    BOOST_CHECK(!node.isGhost(revived.first));
+    BOOST_CHECK(contains(node, makeKey(3), "revived"));
+    
+    ghostPositions.erase(std::find(ghostPositions.begin(),
+                                   ghostPositions.end(), revived.first));
+    
+    node.removeGhosts(ghostPositions);
+    
+    BOOST_CHECK_EQUAL(20 - ghostPositions.size(), node.size());
+    BOOST_CHECK_EQUAL(0, node.ghosts());
+    BOOST_CHECK(isOrdered(node));
+    
+    for (size_t i = 0; i < 20; ++i) {
+        if (i == 3) {
+            BOOST_CHECK(contains(node, makeKey(i), "revived"));
+        } else if (i % 3 == 0) {
+            BOOST_CHECK(!node.lowerBound(makeKey(i)).second);
+        } else {
+            BOOST_CHECK(contains(node, makeKey(i), makeValue(i, 10)));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeMergeTest) {
+    LeafNode left, right;
+    
+    for (size_t i = 100; i < 200; ++i) {
+        LeafNode& node = i < 130 ? left : right;
+        BOOST_CHECK(InsertResult::INSERTED ==
+                    node.insert(makeKey(i), makeValue(i, 10)));
+    }
+    
+    // Ghosts move along with the other entries
+    right.ghost(right.lowerBound(makeKey(140)).first);
+    
+    const auto moved = left.rebalance(right);
+    
+    BOOST_CHECK_GT(moved, 0);
+    BOOST_CHECK_EQUAL(30 + moved, left.size());
+    BOOST_CHECK_EQUAL(100, left.size() + right.size());
+    BOOST_CHECK_EQUAL(1, left.ghosts() + right.ghosts());
+    BOOST_CHECK(left.key(left.size() - 1) < right.key(0));
+    BOOST_CHECK_LT(std::max(left.bytes(), right.bytes()) -
+                   std::min(left.bytes(), right.bytes()), 2 * 40);
+    
+    // Moving entries back from a fuller left node
+    for (size_t i = 200; i < 220; ++i) {
+        BOOST_CHECK(InsertResult::INSERTED ==
+                    left.insert(makeKey(i - 200 + 100) + '+',
+                                makeValue(i, 10)));
+    }
+    
+    BOOST_CHECK_LT(left.rebalance(right), 0);
+    BOOST_CHECK(left.key(left.size() - 1) < right.key(0));
+    
+    BOOST_CHECK(left.merge(right));
+    BOOST_CHECK_EQUAL(120, left.size());
+    BOOST_CHECK(right.empty());
+    BOOST_CHECK(isOrdered(left));
+    BOOST_CHECK_EQUAL(1, left.ghosts());
+    
+    for (size_t i = 100; i < 200; ++i) {
+        if (i != 140) { BOOST_CHECK(contains(left, makeKey(i), makeValue(i, 10))); }
+    }
+    
+    // Nodes which don't fit together are left unchanged
+    LeafNode full;
+    
+    for (size_t i = 300; ; ++i) {
+        if (full.insert(makeKey(i), makeValue(i, 10)) != InsertResult::INSERTED)
+        {
+            break;
+        }
+    }
+    
+    const size_t size = left.size();
+    const size_t fullSize = full.size();
+    
+    BOOST_CHECK(!left.merge(full));
+    BOOST_CHECK_EQUAL(size, left.size());
+    BOOST_CHECK_EQUAL(fullSize, full.size());
+    BOOST_CHECK(isOrdered(left));
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeFragmentedValueTest) {
+    LeafNode node;
+    
+    BOOST_CHECK(node.fitsInline(10, 500));
+    BOOST_CHECK(!node.fitsInline(10, 2000));
+    
+    // A value in two parts, chained from first to last
+    const string value = makeValue(1, 6000);
+    const size_t firstLen = 4000;
+    
+    FragmentNode first, last;
+    BOOST_CHECK(FragmentNode::Type::FRAGMENT == first.type());
+    BOOST_CHECK_GE(first.capacity(), firstLen);
+    
+    last.assign(Bytes{value.data() + firstLen, value.size() - firstLen},
+                nullptr);
+    first.assign(Bytes{value.data(), firstLen}, &last);
+    
+    BOOST_CHECK_EQUAL(&last, first.next());
+    BOOST_CHECK(last.next() == nullptr);
+    
+    for (size_t i = 0; i < 20; ++i) {
+        node.insert(makeKey(i), makeValue(i, 10));
+    }
+    
+    const size_t bytes = node.bytes();
+    
+    BOOST_CHECK(InsertResult::INSERTED ==
+                node.insert(makeKey(100), LeafValue(value.size(), first)));
+    
+    // The entry only refers to the fragments
+    BOOST_CHECK_LT(node.bytes() - bytes, 2 + makeKey(100).size() + 20);
+    
+    const auto pos = node.lowerBound(makeKey(100));
+    BOOST_REQUIRE(pos.second);
+    
+    const LeafValue stored = node.leafValue(pos.first);
+    BOOST_CHECK(stored.isFragmented());
+    BOOST_CHECK_EQUAL(value.size(), stored.length());
+    BOOST_CHECK_EQUAL(&first, stored.first());
+    
+    Buffer copy;
+    stored.appendTo(copy);
+    BOOST_CHECK(value == string(copy.begin(), copy.end()));
+    
+    BOOST_CHECK(!node.leafValue(0).isFragmented());
+    BOOST_CHECK_EQUAL(makeValue(0, 10), toString(node.leafValue(0).bytes()));
+    
+    // Splits move the reference along with the rest of the entry
+    LeafNode sibling;
+    node.splitAndInsert(makeKey(99), makeValue(99, 10), sibling);
+    
+    LeafNode& holder = node.lowerBound(makeKey(100)).second ? node : sibling;
+    const auto movedPos = holder.lowerBound(makeKey(100));
+    BOOST_REQUIRE(movedPos.second);
+    BOOST_CHECK_EQUAL(&first, holder.leafValue(movedPos.first).first());
+    
+    // Replaced by a value which is stored inline again
+    BOOST_CHECK(InsertResult::INSERTED ==
+                holder.update(movedPos.first, string("inline")));
+    BOOST_CHECK(contains(holder, makeKey(100), "inline"));
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeIndirectKeyTest) {
+    std::vector<std::unique_ptr<FragmentNode>> fragments;
+    
+    // Long keys which only differ past the bytes kept in their entries
+    const string path = "/home/" + string(5000, 'd') + '/';
+    
+    BOOST_CHECK(tupl::pvt::keyFitsInline(100));
+    BOOST_CHECK(!tupl::pvt::keyFitsInline(path.size()));
+    
+    LeafNode node;
+    std::map<string, string> expected;
+    
+    for (size_t i = 0; i < 8; ++i) {
+        const string key = path + makeKey(i * 2);
+        
+        BOOST_CHECK(InsertResult::INSERTED ==
+                    node.insert(NodeKey(key, makeFragments(fragments, key)),
+                                makeValue(i, 10)));
+        expected[key] = makeValue(i, 10);
+        
+        node.insert(makeKey(i), makeValue(i, 10));
+        expected[makeKey(i)] = makeValue(i, 10);
+    }
+    
+    // Each indirect key keeps a few hundred bytes in the node
+    BOOST_CHECK(isOrdered(node));
+    BOOST_CHECK_LT(node.bytes(), 16 * 400);
+    
+    for (const auto& kv : expected) {
+        BOOST_CHECK(contains(node, kv.first, kv.second));
+    }
+    
+    // Missing keys sharing the leading bytes of the indirect keys
+    BOOST_CHECK(!node.lowerBound(path).second);
+    BOOST_CHECK(!node.lowerBound(path + makeKey(3)).second);
+    BOOST_CHECK_EQUAL(7, node.lowerBound(path + makeKey(7)).first);
+    
+    // Both halves keep the keys indirect, and the split key in full
+    LeafNode sibling;
+    const string newKey = path + makeKey(5);
+    
+    node.splitAndInsert(NodeKey(newKey, makeFragments(fragments, newKey)),
+                        string("new"), sibling);
+    expected[newKey] = "new";
+    
+    const auto& split = node.split();
+    const LeafNode& left =
+        split.direction == SiblingDirection::LEFT ? sibling : node;
+    const LeafNode& right =
+        split.direction == SiblingDirection::LEFT ? node : sibling;
+    
+    BOOST_CHECK(left.key(left.size() - 1) < split.key);
+    BOOST_CHECK(split.key <= right.key(0));
+    BOOST_CHECK_GT(split.key.size(), path.size());
+    
+    for (const auto& kv : expected) {
+        BOOST_CHECK(contains(kv.first < toString(split.key) ? left : right,
+                             kv.first, kv.second));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeCompactionTest) {
+    LeafNode node;
+    std::map<string, string> expected;
+    
+    size_t count = 0;
+    
+    for (;; ++count) {
+        const string value = makeValue(count, 20);
+        
+        if (node.insert(makeKey(count), value) != InsertResult::INSERTED) {
+            break;
+        }
+        
+        expected[makeKey(count)] = value;
+    }
+    
+    // Alternately growing and shrinking values only fits by reclaiming the
+    // garbage left by the previous round
+    for (size_t round = 0; round < 20; ++round) {
+        const size_t length = (round & 1) ? 20 : 4;
+        
+        for (size_t i = 0; i < count; ++i) {
+            const auto pos = node.lowerBound(makeKey(i));
+            BOOST_REQUIRE(pos.second);
+            
+            const string value = makeValue(i, length);
+            
+            BOOST_REQUIRE(InsertResult::INSERTED ==
+                          node.update(pos.first, value));
+            expected[makeKey(i)] = value;
+        }
+    }
+    
+    // Shrunken values leave room for new entries
+    for (size_t i = count; node.availableBytes() > 100; ++i) {
+        const string value = makeValue(i, 4);
+        
+        BOOST_REQUIRE(InsertResult::INSERTED ==
+                      node.insert(makeKey(i), value));
+        expected[makeKey(i)] = value;
+    }
+    
+    BOOST_CHECK_EQUAL(expected.size(), node.size());
+    BOOST_CHECK(isOrdered(node));
+    
+    for (const auto& kv : expected) {
+        BOOST_CHECK(contains(node, kv.first, kv.second));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeSequentialSplitTest) {
+    // Inserts keys in ascending or descending order, always into the leaf
+    // holding the previous key, and returns the fill factor of the leaves
+    auto fill = [](const bool ascending, const SplitPolicy policy) {
+        std::vector<std::unique_ptr<LeafNode>> leaves;
+        leaves.emplace_back(new LeafNode);
+        
+        LeafNode* leaf = leaves.back().get();
+        
+        for (size_t i = 0; i < 5000; ++i) {
+            const string key = makeKey(ascending ? 10000 + i : 20000 - i);
+            const string value = makeValue(i, 10);
+            
+            if (leaf->insert(key, value) == InsertResult::INSERTED) {
+                continue;
+            }
+            
+            leaves.emplace_back(new LeafNode);
+            leaf->splitAndInsert(key, value, *leaves.back(), policy);
+            
+            // The sibling always holds the new entry
+            leaf = leaves.back().get();
+            BOOST_CHECK(leaf->find(key) != leaf->end());
+        }
+        
+        size_t bytes = 0;
+        
+        for (const auto& each : leaves) { bytes += each->bytes(); }
+        
+        return double(bytes) / (leaves.size() * leaves[0]->capacity());
+    };
+    
+    for (const bool ascending : {true, false}) {
+        const double even = fill(ascending, SplitPolicy::EVEN);
+        const double adaptive = fill(ascending, SplitPolicy::ADAPTIVE);
+        
+        BOOST_CHECK_LT(even, 0.6);
+        BOOST_CHECK_GT(adaptive, 0.9);
+    }
+    
+    // Inserts in the middle still split evenly
+    LeafNode node;
+    
+    for (size_t i = 0;; i += 2) {
+        if (node.insert(makeKey(1000 + i), string("v")) !=
+            InsertResult::INSERTED)
+        {
+            break;
+        }
+    }
+    
+    node.insert(makeKey(1001), string("v"));
+    
+    const size_t size = node.size();
+    LeafNode sibling;
+    
+    node.splitAndInsert(makeKey(1003), string("v"), sibling,
+                        SplitPolicy::ADAPTIVE);
+    
+    BOOST_CHECK_GT(node.size(), size / 3);
+    BOOST_CHECK_GT(sibling.size(), size / 3);
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeSplitTest) {
+    auto fillAndSplit = [](const bool ascending) {
+        LeafNode node;
+        std::map<string, string> expected;
+        
+        for (size_t j = 0; j < 1000; ++j) {
+            const size_t i = ascending ? 1000 + j : 2000 - j;
+            const string key = makeKey(i);
+            const string value = makeValue(i, 20);
+            
+            if (node.insert(key, value) == InsertResult::INSERTED) {
+                expected[key] = value;
+                continue;
+            }
+            
+            const size_t origSize = node.size();
+            
+            LeafNode sibling;
+            node.splitAndInsert(key, value, sibling);
+            expected[key] = value;
+            
+            BOOST_CHECK(isOrdered(node));
+            BOOST_CHECK(isOrdered(sibling));
+            BOOST_CHECK_EQUAL(origSize + 1, node.size() + sibling.size());
+            
+            BOOST_CHECK_LE(origSize / 3, node.size());
+            BOOST_CHECK_LE(origSize / 3, sibling.size());
+            
+            BOOST_REQUIRE(node.hasSibling());
+            const auto& split = node.split();
+            BOOST_CHECK_EQUAL(&sibling, split.sibling);
+            
+            const LeafNode& left =
+                split.direction == SiblingDirection::LEFT ? sibling : node;
+            const LeafNode& right =
+                split.direction == SiblingDirection::LEFT ? node : sibling;
+            
+            const Bytes splitKey{split.key.data(), split.key.size()};
+            
+            BOOST_CHECK(left.key(left.size() - 1) < splitKey);
+            BOOST_CHECK_EQUAL(toString(right.key(0)), toString(splitKey));
+            
+            for (const auto& kv : expected) {
+                BOOST_CHECK(contains(left, kv.first, kv.second) !=
+                            contains(right, kv.first, kv.second));
+            }
+            
+            break;
+        }
+    };
+    
+    fillAndSplit(true);
+    fillAndSplit(false);
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeKeyPrefixTest) {
+    auto compositeKey = [](const size_t i) {
+        ostringstream keyStr;
+        keyStr << "tenant-0042|orders-by-customer|" << 100000 + i;
+        return keyStr.str();
+    };
+    
+    LeafNode node;
+    std::map<string, string> expected;
+    
+    size_t i = 0;
+    
+    for (;; i += 2) {
+        const string value = makeValue(i, 4);
+        
+        if (node.insert(compositeKey(i), value) == InsertResult::FAILED_NO_SPACE)
+        {
+            break;
+        }
+        
+        expected[compositeKey(i)] = value;
+    }
+    
+    const size_t unprefixedCount = node.size();
+    
+    BOOST_CHECK_EQUAL(0, node.keyPrefix().size());
+    BOOST_CHECK_EQUAL(0, node.keyPrefixSavings());
+    
+    LeafNode sibling;
+    node.splitAndInsert(compositeKey(i), makeValue(i, 4), sibling);
+    expected[compositeKey(i)] = makeValue(i, 4);
+    
+    // Both halves share more than the composite key components
+    const string common = "tenant-0042|orders-by-customer|100";
+    
+    for (const LeafNode* half : {&node, &sibling}) {
+        BOOST_CHECK(common.size() <= half->keyPrefix().size());
+        BOOST_CHECK_EQUAL(
+            common, toString(half->keyPrefix()).substr(0, common.size()));
+        BOOST_CHECK_GT(half->keyPrefixSavings(), 0);
+        BOOST_CHECK(isOrdered(*half));
+    }
+    
+    for (const auto& kv : expected) {
+        BOOST_CHECK(contains(node, kv.first, kv.second) !=
+                    contains(sibling, kv.first, kv.second));
+    }
+    
+    // Keys which order before, within and after the prefixed keys
+    LeafNode& right = node.split().direction == SiblingDirection::LEFT ?
+        node : sibling;
+    
+    const string prefix = toString(right.keyPrefix());
+    const string outside[] = {
+        string(), prefix.substr(0, 10),
+        prefix.substr(0, prefix.size() - 1) + '\xff'
+    };
+    
+    for (const auto& key : outside) {
+        BOOST_CHECK(InsertResult::INSERTED == right.insert(key, string("outside")));
+    }
+    
+    BOOST_CHECK(InsertResult::INSERTED == right.insert(prefix, string("exact")));
+    BOOST_CHECK(isOrdered(right));
+    
+    for (const auto& key : outside) {
+        BOOST_CHECK(contains(right, key, "outside"));
+    }
+    
+    BOOST_CHECK(contains(right, prefix, "exact"));
+    
+    // Entries sharing the prefix take less space, so more of them fit
+    for (;; i += 2) {
+        if (right.insert(compositeKey(i + 1), makeValue(i + 1, 4)) ==
+            InsertResult::FAILED_NO_SPACE)
+        {
+            break;
+        }
+    }
+    
+    BOOST_CHECK(isOrdered(right));
+    BOOST_CHECK_GT(right.size(), unprefixedCount + unprefixedCount / 4);
+}
+
+BOOST_AUTO_TEST_CASE(LeafNodeSeparatorTest) {
+    using tupl::pvt::shortestSeparator;
+    
+    auto separator = [](const string& low, const string& high) {
+        const auto key = shortestSeparator(low, high);
+        return string(key.begin(), key.end());
+    };
+    
+    BOOST_CHECK_EQUAL("b", separator("apple", "banana"));
+    BOOST_CHECK_EQUAL("key-2", separator("key-1999", "key-2000"));
+    BOOST_CHECK_EQUAL("key-1", separator("key-", "key-1000"));
+    BOOST_CHECK_EQUAL("a", separator("", "a"));
+    BOOST_CHECK_EQUAL("key-1", separator("key-0999", "key-1000"));
+    BOOST_CHECK_EQUAL("key-1001", separator("key-1000", "key-1001"));
+    
+    // Long keys which differ early produce short separators
+    LeafNode node;
+    
+    for (size_t i = 0; ; ++i) {
+        ostringstream keyStr;
+        keyStr << "group-" << 1000 + i << '-' << string(100, 'x');
+        
+        const string key = keyStr.str();
+        
+        if (node.insert(key, string("v")) == InsertResult::FAILED_NO_SPACE) {
+            LeafNode sibling;
+            node.splitAndInsert(key, string("v"), sibling);
+            
+            const auto& split = node.split();
+            const LeafNode& left =
+                split.direction == SiblingDirection::LEFT ? sibling : node;
+            const LeafNode& right =
+                split.direction == SiblingDirection::LEFT ? node : sibling;
+            
+            const Bytes splitKey{split.key.data(), split.key.size()};
+            
+            BOOST_CHECK(left.key(left.size() - 1) < splitKey);
+            BOOST_CHECK(splitKey <= right.key(0));
+            BOOST_CHECK_LE(splitKey.size(), 10);
+            break;
+        }
+    }
+}
@@ -0,0 +1,1409 @@
+#define BOOST_TEST_MODULE TreeTest
+
+#include <boost/test/unit_test.hpp>
+
+#include "tupl/pvt/BulkLoader.hpp"
+#include "tupl/pvt/Cursor.hpp"
+#include "tupl/pvt/Lookup.hpp"
+#include "tupl/pvt/Tree.hpp"
+#include "tupl/pvt/Write.hpp"
+#include "tupl/pvt/ops.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::ostringstream;
+using std::string;
+using tupl::Bytes;
+using tupl::pvt::BulkLoader;
+using tupl::pvt::Cursor;
+using tupl::pvt::Lookup;
+using tupl::pvt::Tree;
+using tupl::pvt::Write;
+using tupl::pvt::ops;
+
+namespace {
+
+/*
+  Copies what a cursor found, for comparing it in checks
+ */
+string keyOf(const Cursor& cursor) {
+    const Bytes key = ops::key(cursor);
+    return string(key.data(), key.data() + key.size());
+}
+
+string valueOf(const Cursor& cursor) {
+    const Bytes value = ops::value(cursor);
+    return string(value.data(), value.data() + value.size());
+}
+
+string makeKey(const size_t i) {
+    ostringstream keyStr;
+    keyStr << "key-" << i;
+    return keyStr.str();
+}
+
+string makeOrderedKey(const size_t i) {
+    char key[32];
+    std::snprintf(key, sizeof(key), "key-%08zu", i);
+    return key;
+}
+
+string makeValue(const size_t i) {
+    ostringstream valueStr;
+    valueStr << "value-" << i;
+    return valueStr.str();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(TreeFindStoreTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    ops::find(tree, cursor, string("missing"));
+    BOOST_CHECK(!ops::hasValue(cursor));
+    
+    ops::store(tree, cursor, string("present"));
+    BOOST_CHECK(ops::hasValue(cursor));
+    
+    ops::find(tree, cursor, string("missing"));
+    BOOST_CHECK(ops::hasValue(cursor));
+    BOOST_CHECK_EQUAL("present", valueOf(cursor));
+    
+    // Replace the existing value
+    ops::store(tree, cursor, string("replaced"));
+    ops::reset(cursor);
+    ops::find(tree, cursor, string("missing"));
+    BOOST_CHECK_EQUAL("replaced", valueOf(cursor));
+}
+
+BOOST_AUTO_TEST_CASE(TreeCursorFramesTest) {
+    Tree tree;
+    Cursor writer;
+    Cursor reader;
+    
+    // Position the reader before keys are inserted around it
+    ops::find(tree, reader, makeKey(50));
+    
+    for (size_t i = 0; i < 100; i += 2) {
+        ops::find(tree, writer, makeKey(i));
+        BOOST_CHECK(!ops::hasValue(writer));
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    ops::store(tree, reader, makeValue(50));
+    
+    for (size_t i = 0; i < 100; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        
+        if (i % 2 == 0) {
+            BOOST_CHECK(ops::hasValue(writer));
+            BOOST_CHECK_EQUAL(makeValue(i), valueOf(writer));
+        } else {
+            BOOST_CHECK(!ops::hasValue(writer));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TreeDeleteTest) {
+    Tree tree;
+    Cursor writer;
+    Cursor reader;
+    
+    for (size_t i = 0; i < 40; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    // A reader positioned on an entry stays there after it's deleted
+    ops::find(tree, reader, makeKey(21));
+    
+    for (size_t i = 0; i < 40; i += 3) {
+        ops::find(tree, writer, makeKey(i));
+        ops::store(tree, writer, Bytes{});
+        BOOST_CHECK(!ops::hasValue(writer));
+    }
+    
+    // Deleting a missing key has no effect
+    ops::find(tree, writer, makeKey(1000));
+    ops::store(tree, writer, Bytes{});
+    
+    // Fewer than half of the entries are ghosts, so they are all kept
+    auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(26, stats.entries);
+    BOOST_CHECK_EQUAL(14, stats.ghostEntries);
+    
+    for (size_t i = 0; i < 40; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        BOOST_CHECK_EQUAL(i % 3 != 0, ops::hasValue(writer));
+    }
+    
+    ops::reset(writer);
+    
+    // Ghosts are removed once their space is needed, except the one which
+    // the reader is bound to
+    for (size_t i = 100; tree.stats().ghostEntries > 1; ++i) {
+        BOOST_REQUIRE_EQUAL(1, tree.stats().leafNodes);
+        
+        ops::find(tree, writer, makeKey(i));
+        ops::store(tree, writer, string(40, 'v'));
+    }
+    
+    ops::reset(writer);
+    
+    ops::store(tree, reader, string("revived"));
+    BOOST_CHECK_EQUAL(0, tree.stats().ghostEntries);
+    
+    ops::find(tree, reader, makeKey(21));
+    BOOST_CHECK_EQUAL("revived", valueOf(reader));
+    
+    for (size_t i = 0; i < 40; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        
+        if (i % 3 != 0) {
+            BOOST_CHECK_EQUAL(makeValue(i), valueOf(writer));
+        } else {
+            BOOST_CHECK_EQUAL(i == 21, ops::hasValue(writer));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TreeStatsTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(2, stats.height);
+    BOOST_CHECK_EQUAL(1, stats.leafNodes);
+    BOOST_CHECK_EQUAL(1, stats.internalNodes);
+    BOOST_CHECK_EQUAL(0, stats.entries);
+    BOOST_CHECK_EQUAL(0, stats.leafBytes);
+    BOOST_CHECK_EQUAL(6, stats.internalBytes); // one narrow child identifier
+    BOOST_CHECK_EQUAL(0, stats.keyPrefixSavings);
+    BOOST_CHECK(tupl::pvt::SplitPolicy::ADAPTIVE == stats.splitPolicy);
+    BOOST_CHECK_EQUAL(0, stats.leafFillFactor);
+    
+    for (size_t i = 0; i < 10; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    stats = tree.stats();
+    BOOST_CHECK_EQUAL(10, stats.entries);
+    BOOST_CHECK_GT(stats.leafBytes, 10 * (makeKey(0).size() + 2));
+    
+    // A single leaf, whose capacity excludes the page header
+    BOOST_CHECK_CLOSE(stats.leafBytes / (4096.0 - 12), stats.leafFillFactor,
+                      0.001);
+}
+
+BOOST_AUTO_TEST_CASE(TreeFragmentedValueTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    for (size_t i = 0; i < 50; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    // Blobs are stored out of line, and leave the small entries together
+    const size_t blobSizes[] = {10000, 100000, 1000000};
+    
+    for (const size_t size : blobSizes) {
+        string blob(size, 'x');
+        for (size_t i = 0; i < size; i += 997) { blob[i] = char('a' + i % 26); }
+        
+        ops::find(tree, cursor, makeKey(size));
+        ops::store(tree, cursor, blob);
+        
+        ops::reset(cursor);
+        ops::find(tree, cursor, makeKey(size));
+        BOOST_CHECK(blob == valueOf(cursor));
+    }
+    
+    auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(1, stats.leafNodes);
+    BOOST_CHECK_EQUAL(53, stats.entries);
+    
+    const size_t fragmentNodes = stats.fragmentNodes;
+    BOOST_CHECK_GE(fragmentNodes, (10000 + 100000 + 1000000) / 4096);
+    
+    for (size_t i = 0; i < 50; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(cursor));
+    }
+    
+    // Replacing a blob releases its fragments
+    ops::find(tree, cursor, makeKey(1000000));
+    ops::store(tree, cursor, string("small"));
+    
+    stats = tree.stats();
+    BOOST_CHECK_LT(stats.fragmentNodes, fragmentNodes - 200);
+    
+    ops::reset(cursor);
+    ops::find(tree, cursor, makeKey(1000000));
+    BOOST_CHECK_EQUAL("small", valueOf(cursor));
+    
+    ops::find(tree, cursor, makeKey(100000));
+    ops::store(tree, cursor, string(20000, 'y'));
+    
+    ops::reset(cursor);
+    ops::find(tree, cursor, makeKey(100000));
+    BOOST_CHECK(string(20000, 'y') == valueOf(cursor));
+}
+
+BOOST_AUTO_TEST_CASE(TreeLargeKeyTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    const string path = "https://example.com/" + string(20000, 'u') + '/';
+    
+    for (size_t i = 0; i < 8; ++i) {
+        ops::find(tree, cursor, path + makeKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    // Replacing the value leaves the indirect key in place
+    ops::find(tree, cursor, path + makeKey(3));
+    ops::store(tree, cursor, string("replaced"));
+    
+    for (size_t i = 0; i < 8; ++i) {
+        ops::reset(cursor);
+        ops::find(tree, cursor, path + makeKey(i));
+        BOOST_CHECK_EQUAL(i == 3 ? string("replaced") : makeValue(i),
+                          valueOf(cursor));
+    }
+    
+    ops::find(tree, cursor, path + makeKey(8));
+    BOOST_CHECK(!ops::hasValue(cursor));
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(1, stats.leafNodes);
+    BOOST_CHECK_GE(stats.fragmentNodes, 8 * (path.size() / 4096));
+}
+
+BOOST_AUTO_TEST_CASE(TreeMergeTest) {
+    Tree tree;
+    BulkLoader loader(tree);
+    
+    for (size_t i = 0; i < 100000; ++i) {
+        loader.add(makeOrderedKey(i), makeValue(i));
+    }
+    
+    loader.finish();
+    
+    const auto loaded = tree.stats();
+    BOOST_REQUIRE_GE(loaded.height, 3);
+    
+    // Readers positioned on entries which are kept, and on missing keys
+    // between them
+    const size_t readerKeys[] = {0, 4200, 50000, 99900};
+    Cursor keptReaders[4];
+    Cursor missingReaders[4];
+    
+    for (size_t i = 0; i < 4; ++i) {
+        ops::find(tree, keptReaders[i], makeOrderedKey(readerKeys[i]));
+        ops::find(tree, missingReaders[i],
+                  makeOrderedKey(readerKeys[i] + 50) + '+');
+    }
+    
+    // Deleting most entries merges the leaves, then the internal nodes
+    Cursor writer;
+    
+    for (size_t i = 0; i < 100000; ++i) {
+        if (i % 100 != 0) {
+            ops::find(tree, writer, makeOrderedKey(i));
+            ops::store(tree, writer, Bytes{});
+        }
+    }
+    
+    ops::reset(writer);
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(1000, stats.entries);
+    BOOST_CHECK_LT(stats.leafNodes, loaded.leafNodes / 10);
+    BOOST_CHECK_LT(stats.internalNodes, loaded.internalNodes);
+    BOOST_CHECK_LT(stats.height, loaded.height);
+    
+    for (size_t i = 0; i < 4; ++i) {
+        ops::store(tree, keptReaders[i], string("kept"));
+        ops::store(tree, missingReaders[i], string("inserted"));
+    }
+    
+    for (size_t i = 0; i < 100000; i += 50) {
+        ops::find(tree, writer, makeOrderedKey(i));
+        
+        const bool isReaderKey = std::find(
+            readerKeys, readerKeys + 4, i) != readerKeys + 4;
+        
+        if (i % 100 != 0) {
+            BOOST_CHECK(!ops::hasValue(writer));
+        } else {
+            BOOST_CHECK_EQUAL(isReaderKey ? string("kept") : makeValue(i),
+                              valueOf(writer));
+        }
+    }
+    
+    for (size_t i = 0; i < 4; ++i) {
+        ops::find(tree, writer, makeOrderedKey(readerKeys[i] + 50) + '+');
+        BOOST_CHECK_EQUAL("inserted", valueOf(writer));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TreeConcurrentFindTest) {
+    Tree tree;
+    BulkLoader loader(tree);
+    
+    const size_t count = 20000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        loader.add(makeOrderedKey(i * 2), makeValue(i));
+    }
+    
+    loader.finish();
+    
+    // Readers only latch shared, and bind their frames alongside each other
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> readers;
+    
+    for (size_t t = 0; t < 8; ++t) {
+        readers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t i = t; i < count; i += 3) {
+                ops::find(tree, cursor, makeOrderedKey(i * 2));
+                
+                if (valueOf(cursor) != makeValue(i)) {
+                    ++mismatches;
+                }
+                
+                ops::find(tree, cursor, makeOrderedKey(i * 2 + 1));
+                
+                if (ops::hasValue(cursor)) { ++mismatches; }
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    for (auto& reader : readers) { reader.join(); }
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+    
+    // No latch is left held by the readers
+    Cursor writer;
+    
+    ops::find(tree, writer, makeOrderedKey(0));
+    ops::store(tree, writer, Bytes{});
+    ops::reset(writer);
+    
+    BOOST_CHECK_EQUAL(count - 1, tree.stats().entries);
+}
+
+BOOST_AUTO_TEST_CASE(TreeFindDuringMergeTest) {
+    Tree tree;
+    BulkLoader loader(tree);
+    
+    const size_t count = 50000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        loader.add(makeOrderedKey(i), makeValue(i));
+    }
+    
+    loader.finish();
+    
+    // Readers descend optimistically while the internal nodes they read are
+    // merged and rebalanced
+    std::atomic<bool> deleting(true);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> readers;
+    
+    for (size_t t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t i = t * 100; deleting; i = (i + 400) % count) {
+                ops::find(tree, cursor, makeOrderedKey(i));
+                
+                if (valueOf(cursor) != makeValue(i)) {
+                    ++mismatches;
+                }
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    Cursor writer;
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 100 != 0) {
+            ops::find(tree, writer, makeOrderedKey(i));
+            ops::store(tree, writer, Bytes{});
+        }
+    }
+    
+    ops::reset(writer);
+    deleting = false;
+    
+    for (auto& reader : readers) { reader.join(); }
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+    BOOST_CHECK_EQUAL(count / 100, tree.stats().entries);
+}
+
+BOOST_AUTO_TEST_CASE(TreeSplitTest) {
+    Tree tree;
+    
+    // Readers positioned before the keys around them are inserted follow
+    // the splits of their leaf, and of the internal nodes above it
+    const size_t readerKeys[] = {7, 20000, 39999};
+    Cursor readers[3];
+    
+    for (size_t i = 0; i < 3; ++i) {
+        ops::find(tree, readers[i], makeKey(readerKeys[i]));
+    }
+    
+    Cursor writer;
+    const size_t count = 40000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    for (size_t i = 0; i < 3; ++i) {
+        ops::store(tree, readers[i], string("replaced"));
+    }
+    
+    ops::reset(writer);
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_GE(stats.height, 3);
+    BOOST_CHECK_EQUAL(count, stats.entries);
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, writer, makeKey(i));
+        
+        const bool isReaderKey = std::find(
+            readerKeys, readerKeys + 3, i) != readerKeys + 3;
+        
+        BOOST_CHECK_EQUAL(isReaderKey ? string("replaced") : makeValue(i),
+                          valueOf(writer));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TreeSplitSeparatorFramesTest) {
+    Tree tree;
+    Cursor writer;
+    
+    // Leaf splits promote the shortest separator, which sorts before the
+    // first key of the right leaf. The keys between them are missing keys
+    // which belong to the right leaf.
+    const size_t count = 400;
+    const string suffix(20, 's');
+    
+    for (size_t i = 0; i < count; i += 2) {
+        ops::find(tree, writer, makeOrderedKey(i) + suffix);
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    // Readers are positioned at the keys which prefix the stored keys,
+    // ahead of every separator that a split between two entries can pick
+    std::vector<Cursor> readers(count / 2);
+    
+    for (size_t i = 0; i < readers.size(); ++i) {
+        ops::find(tree, readers[i], makeOrderedKey(i * 2 + 2));
+        BOOST_CHECK(!ops::hasValue(readers[i]));
+    }
+    
+    // Inserting between the entries out of order splits the leaves in the
+    // middle, some of them at readers
+    for (size_t j = 0; j < count / 2; ++j) {
+        const size_t i = j * 7919 % (count / 2) * 2 + 1;
+        
+        ops::find(tree, writer, makeOrderedKey(i) + suffix);
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    BOOST_REQUIRE_GT(tree.stats().leafNodes, 2);
+    
+    for (auto& reader : readers) { ops::store(tree, reader, string("reader")); }
+    
+    // Fresh cursors descend from the root, which finds keys by separators
+    for (size_t i = 0; i < readers.size(); ++i) {
+        Cursor cursor;
+        ops::find(tree, cursor, makeOrderedKey(i * 2 + 2));
+        BOOST_CHECK_EQUAL("reader", valueOf(cursor));
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, writer, makeOrderedKey(i) + suffix);
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(writer));
+    }
+    
+    ops::reset(writer);
+    
+    BOOST_CHECK_EQUAL(count + readers.size(), tree.stats().entries);
+}
+
+BOOST_AUTO_TEST_CASE(TreeConcurrentInsertTest) {
+    Tree tree;
+    
+    const size_t threadCount = 4;
+    const size_t count = 80000;
+    
+    // Writers interleave their keys, so that they split the same leaves and
+    // repair each other's splits, while readers look up what's inserted
+    std::atomic<bool> inserting(true);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> writers;
+    std::vector<std::thread> readers;
+    
+    for (size_t t = 0; t < threadCount; ++t) {
+        writers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t i = t; i < count; i += threadCount) {
+                ops::find(tree, cursor, makeKey(i));
+                ops::store(tree, cursor, makeValue(i));
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    for (size_t t = 0; t < 2; ++t) {
+        readers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t i = t; inserting; i = (i + 7) % count) {
+                ops::find(tree, cursor, makeKey(i));
+                
+                if (ops::hasValue(cursor) &&
+                    valueOf(cursor) != makeValue(i))
+                {
+                    ++mismatches;
+                }
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    inserting = false;
+    
+    for (auto& reader : readers) { reader.join(); }
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_GE(stats.height, 3);
+    BOOST_CHECK_EQUAL(count, stats.entries);
+    
+    Cursor cursor;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        
+        if (valueOf(cursor) != makeValue(i)) { ++mismatches; }
+    }
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+}
+
+BOOST_AUTO_TEST_CASE(TreeConcurrentStatsTest) {
+    Tree tree;
+    
+    const size_t threadCount = 4;
+    const size_t count = 40000;
+    
+    // Writers split and merge nodes, and allocate and release fragments,
+    // while stats visits the nodes
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> statsCalls(0);
+    std::vector<std::thread> writers;
+    
+    for (size_t t = 0; t < threadCount; ++t) {
+        writers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t i = t; i < count; i += threadCount) {
+                ops::find(tree, cursor, makeKey(i));
+                
+                if (i % 64 == 0) {
+                    ops::store(tree, cursor, string(5000, char('a' + t)));
+                } else {
+                    ops::store(tree, cursor, makeValue(i));
+                }
+            }
+            
+            for (size_t i = t; i < count; i += threadCount) {
+                if (i % 2 == 0) { continue; }
+                
+                ops::find(tree, cursor, makeKey(i));
+                ops::store(tree, cursor, Bytes{});
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    std::thread statsReader([&] {
+        while (writing) {
+            const auto stats = tree.stats();
+            BOOST_CHECK_LE(stats.entries, count);
+            ++statsCalls;
+        }
+    });
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    writing = false;
+    statsReader.join();
+    
+    BOOST_CHECK_GT(statsCalls.load(), 0);
+    
+    const auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(count / 2, stats.entries);
+    BOOST_CHECK_GT(stats.fragmentNodes, 0);
+}
+
+BOOST_AUTO_TEST_CASE(TreeFingerFindTest) {
+    Tree tree;
+    Cursor writer;
+    
+    // Separators sharing the long prefix are stored indirectly, so finds
+    // latch their way down and bind a frame to every node
+    const string prefix(600, 'p');
+    const size_t count = 4000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, writer, prefix + makeOrderedKey(i * 2));
+        ops::store(tree, writer, makeValue(i));
+    }
+    
+    const auto loaded = tree.stats();
+    BOOST_REQUIRE_GE(loaded.height, 3);
+    
+    // Keys found in order resume from the leaf, or from the lowest node
+    // whose keys include them, and keys far away start over from the root
+    Cursor finger;
+    const size_t starts[] = {0, 3000, 100, count - 1, 1900};
+    
+    for (const size_t start : starts) {
+        for (size_t i = start; i < start + 100 && i < count; ++i) {
+            ops::find(tree, finger, prefix + makeOrderedKey(i * 2));
+            BOOST_CHECK_EQUAL(makeValue(i), valueOf(finger));
+            
+            ops::find(tree, finger, prefix + makeOrderedKey(i * 2 + 1));
+            BOOST_CHECK(!ops::hasValue(finger));
+        }
+    }
+    
+    // Keys which sort before or after every key are bound at the edges
+    ops::find(tree, finger, string("a"));
+    BOOST_CHECK(!ops::hasValue(finger));
+    
+    ops::find(tree, finger, string("z"));
+    BOOST_CHECK(!ops::hasValue(finger));
+    
+    ops::find(tree, finger, prefix + makeOrderedKey(2000));
+    
+    // The root collapses while the finger is still bound to it
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 100 != 0) {
+            ops::find(tree, writer, prefix + makeOrderedKey(i * 2));
+            ops::store(tree, writer, Bytes{});
+        }
+    }
+    
+    ops::reset(writer);
+    
+    BOOST_CHECK_LT(tree.stats().height, loaded.height);
+    
+    for (size_t i = 0; i < count; i += 50) {
+        ops::find(tree, finger, prefix + makeOrderedKey(i * 2));
+        
+        if (i % 100 == 0) {
+            BOOST_CHECK_EQUAL(makeValue(i), valueOf(finger));
+        } else {
+            BOOST_CHECK(!ops::hasValue(finger));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TreeCursorScanTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    // An empty tree leaves the cursor unpositioned
+    ops::first(tree, cursor);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    BOOST_CHECK_THROW(ops::next(tree, cursor), std::runtime_error);
+    
+    ops::last(tree, cursor);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    BOOST_CHECK_THROW(ops::previous(tree, cursor), std::runtime_error);
+    
+    // Long keys keep the leaves small, so that scans cross many of them and
+    // climb through several levels
+    const string prefix(600, 'p');
+    const size_t count = 4000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, prefix + makeOrderedKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    BOOST_REQUIRE_GE(tree.stats().height, 3);
+    
+    // Deleted entries are skipped, whether they're still ghosts or not
+    for (size_t i = 0; i < count; i += 3) {
+        ops::find(tree, cursor, prefix + makeOrderedKey(i));
+        ops::store(tree, cursor, Bytes{});
+    }
+    
+    size_t i = 1;
+    
+    for (ops::first(tree, cursor); ops::hasValue(cursor);
+         ops::next(tree, cursor))
+    {
+        BOOST_REQUIRE_EQUAL(prefix + makeOrderedKey(i),
+                            keyOf(cursor));
+        BOOST_REQUIRE_EQUAL(makeValue(i), valueOf(cursor));
+        
+        i += i % 3 == 1 ? 1 : 2;
+    }
+    
+    BOOST_CHECK_EQUAL(count, i);
+    BOOST_CHECK_EQUAL("", keyOf(cursor));
+    
+    i = count - 2;
+    
+    for (ops::last(tree, cursor); ops::hasValue(cursor);
+         ops::previous(tree, cursor))
+    {
+        BOOST_REQUIRE_EQUAL(prefix + makeOrderedKey(i),
+                            keyOf(cursor));
+        
+        i -= i % 3 == 2 ? 1 : 2;
+    }
+    
+    BOOST_CHECK_EQUAL(size_t(-1), i);
+    
+    // Moves start from missing keys too, which are between entries
+    ops::find(tree, cursor, prefix + makeOrderedKey(1500));
+    BOOST_CHECK(!ops::hasValue(cursor));
+    
+    ops::next(tree, cursor);
+    BOOST_CHECK_EQUAL(prefix + makeOrderedKey(1501),
+                      keyOf(cursor));
+    
+    ops::find(tree, cursor, prefix + makeOrderedKey(1500));
+    ops::previous(tree, cursor);
+    BOOST_CHECK_EQUAL(prefix + makeOrderedKey(1499),
+                      keyOf(cursor));
+    
+    ops::skip(tree, cursor, 10);
+    BOOST_CHECK_EQUAL(prefix + makeOrderedKey(1514),
+                      keyOf(cursor));
+    
+    ops::skip(tree, cursor, -1000);
+    BOOST_CHECK_EQUAL(prefix + makeOrderedKey(14),
+                      keyOf(cursor));
+    
+    ops::skip(tree, cursor, -100);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    BOOST_CHECK_THROW(ops::skip(tree, cursor, 1), std::runtime_error);
+    
+    // Short keys are found optimistically, binding only the leaf, and the
+    // other frames are bound once a move leaves it
+    Tree small;
+    
+    for (i = 0; i < 5000; ++i) {
+        ops::find(small, cursor, makeOrderedKey(i));
+        ops::store(small, cursor, makeValue(i));
+    }
+    
+    ops::find(small, cursor, makeOrderedKey(0));
+    
+    for (i = 1; i < 5000; ++i) {
+        ops::next(small, cursor);
+        BOOST_REQUIRE_EQUAL(makeOrderedKey(i), keyOf(cursor));
+    }
+    
+    ops::find(small, cursor, makeOrderedKey(4999));
+    ops::skip(small, cursor, -4999);
+    BOOST_CHECK_EQUAL(makeOrderedKey(0), keyOf(cursor));
+    
+    ops::reset(cursor);
+}
+
+BOOST_AUTO_TEST_CASE(TreeConcurrentScanTest) {
+    Tree tree;
+    
+    const string prefix(300, 'p');
+    const size_t count = 6000;
+    
+    {
+        Cursor cursor;
+        
+        for (size_t i = 0; i < count; i += 2) {
+            ops::find(tree, cursor, prefix + makeOrderedKey(i));
+            ops::store(tree, cursor, makeValue(i));
+        }
+    }
+    
+    // Writers insert and delete the odd keys, splitting and merging the
+    // leaves under the scanners, which must still see every even key once
+    // and in order
+    std::atomic<bool> writing(true);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> writers;
+    std::vector<std::thread> scanners;
+    
+    for (size_t t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] {
+            Cursor cursor;
+            
+            for (size_t round = 0; round < 4; ++round) {
+                for (size_t i = 1 + t * 2; i < count; i += 4) {
+                    ops::find(tree, cursor, prefix + makeOrderedKey(i));
+                    ops::store(tree, cursor, round % 2 == 0 ?
+                               Bytes(makeValue(i)) : Bytes{});
+                }
+            }
+            
+            ops::reset(cursor);
+        });
+    }
+    
+    for (size_t t = 0; t < 2; ++t) {
+        scanners.emplace_back([&, t] {
+            Cursor cursor;
+            const bool forward = t == 0;
+            
+            while (writing) {
+                size_t expected = forward ? 0 : count - 2;
+                string previous;
+                
+                for (forward ? ops::first(tree, cursor) : ops::last(tree, cursor);
+                     ops::hasValue(cursor);
+                     forward ? ops::next(tree, cursor) :
+                               ops::previous(tree, cursor))
+                {
+                    const string key = keyOf(cursor);
+                    
+                    if (!previous.empty() &&
+                        (forward ? key <= previous : key >= previous))
+                    {
+                        ++mismatches;
+                    }
+                    
+                    if (key == prefix + makeOrderedKey(expected)) {
+                        expected = forward ? expected + 2 : expected - 2;
+                    }
+                    
+                    previous = key;
+                }
+                
+                if (expected != (forward ? count : size_t(-2))) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    writing = false;
+    
+    for (auto& scanner : scanners) { scanner.join(); }
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+}
+
+BOOST_AUTO_TEST_CASE(TreeFindAllTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    const size_t count = 20000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    for (size_t i = 0; i < count; i += 5) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, Bytes{});
+    }
+    
+    ops::reset(cursor);
+    
+    std::vector<Lookup> lookups;
+    ops::findAll(tree, lookups);
+    BOOST_CHECK(lookups.empty());
+    
+    // Keys are given out of order, some of them twice, and some are missing
+    // or deleted
+    std::vector<string> keys;
+    
+    for (size_t i = 0; i < 500; ++i) {
+        keys.push_back(makeKey(i * 7919 % count));
+    }
+    
+    for (size_t i = 0; i < 50; ++i) {
+        keys.push_back(makeKey(i * 31));
+        keys.push_back(makeKey(count + i));
+    }
+    
+    for (const auto& key : keys) { lookups.emplace_back(key); }
+    
+    ops::findAll(tree, lookups);
+    
+    for (size_t i = 0; i < lookups.size(); ++i) {
+        ops::find(tree, cursor, keys[i]);
+        
+        BOOST_CHECK_EQUAL(ops::hasValue(cursor),
+                          lookups[i].hasValue);
+        BOOST_CHECK_EQUAL(valueOf(cursor),
+                          string(lookups[i].value.begin(),
+                                 lookups[i].value.end()));
+    }
+    
+    ops::reset(cursor);
+    
+    // Batches are found while writers split the nodes they descend through
+    std::atomic<bool> inserting(true);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> writers;
+    
+    for (size_t t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] {
+            Cursor writer;
+            
+            for (size_t i = count + t; i < count * 3; i += 2) {
+                ops::find(tree, writer, makeKey(i));
+                ops::store(tree, writer, makeValue(i));
+            }
+            
+            ops::reset(writer);
+        });
+    }
+    
+    std::thread reader([&] {
+        std::vector<Lookup> batch(lookups.begin(), lookups.begin() + 500);
+        
+        while (inserting) {
+            ops::findAll(tree, batch);
+            
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const size_t k = i * 7919 % count;
+                const string value(batch[i].value.begin(),
+                                   batch[i].value.end());
+                
+                if (batch[i].hasValue != (k % 5 != 0) ||
+                    (batch[i].hasValue && value != makeValue(k)))
+                {
+                    ++mismatches;
+                }
+            }
+        }
+    });
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    inserting = false;
+    reader.join();
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+}
+
+BOOST_AUTO_TEST_CASE(TreeFindInterleavedTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    const size_t count = 20000;
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, makeValue(i));
+    }
+    
+    for (size_t i = 0; i < count; i += 5) {
+        ops::find(tree, cursor, makeKey(i));
+        ops::store(tree, cursor, Bytes{});
+    }
+    
+    // More keys than lookups in flight, some of them missing, deleted or
+    // given twice
+    std::vector<string> keys;
+    
+    for (size_t i = 0; i < 1000; ++i) {
+        keys.push_back(makeKey(i * 7919 % (count + 100)));
+    }
+    
+    keys.push_back(keys.front());
+    
+    std::vector<Lookup> lookups(keys.begin(), keys.end());
+    ops::findInterleaved(tree, lookups);
+    
+    for (size_t i = 0; i < lookups.size(); ++i) {
+        ops::find(tree, cursor, keys[i]);
+        
+        BOOST_CHECK_EQUAL(ops::hasValue(cursor),
+                          lookups[i].hasValue);
+        BOOST_CHECK_EQUAL(valueOf(cursor),
+                          string(lookups[i].value.begin(),
+                                 lookups[i].value.end()));
+    }
+    
+    // Separators sharing a long prefix are stored indirectly, which leaves
+    // the lookups to latch their way down instead
+    Tree longKeys;
+    const string prefix(600, 'p');
+    
+    for (size_t i = 0; i < 2000; ++i) {
+        ops::find(longKeys, cursor, prefix + makeKey(i));
+        ops::store(longKeys, cursor, makeValue(i));
+    }
+    
+    ops::reset(cursor);
+    
+    std::vector<string> longKeyStrings;
+    
+    for (size_t i = 0; i < 2100; i += 7) {
+        longKeyStrings.push_back(prefix + makeKey(i));
+    }
+    
+    std::vector<Lookup> longLookups(longKeyStrings.begin(),
+                                    longKeyStrings.end());
+    ops::findInterleaved(longKeys, longLookups);
+    
+    for (size_t i = 0; i < longLookups.size(); ++i) {
+        const size_t k = i * 7;
+        
+        BOOST_CHECK_EQUAL(k < 2000, longLookups[i].hasValue);
+        
+        if (k < 2000) {
+            BOOST_CHECK_EQUAL(makeValue(k),
+                              string(longLookups[i].value.begin(),
+                                     longLookups[i].value.end()));
+        }
+    }
+    
+    // Lookups restart or latch when writers change the nodes they read
+    std::atomic<bool> inserting(true);
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> writers;
+    
+    for (size_t t = 0; t < 2; ++t) {
+        writers.emplace_back([&, t] {
+            Cursor writer;
+            
+            for (size_t i = count + 100 + t; i < count * 3; i += 2) {
+                ops::find(tree, writer, makeKey(i));
+                ops::store(tree, writer, makeValue(i));
+            }
+            
+            ops::reset(writer);
+        });
+    }
+    
+    std::thread reader([&] {
+        std::vector<Lookup> batch(lookups.begin(), lookups.begin() + 1000);
+        
+        while (inserting) {
+            ops::findInterleaved(tree, batch);
+            
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const size_t k = i * 7919 % (count + 100);
+                const bool present = k < count && k % 5 != 0;
+                const string value(batch[i].value.begin(),
+                                   batch[i].value.end());
+                
+                if (batch[i].hasValue != present ||
+                    (present && value != makeValue(k)))
+                {
+                    ++mismatches;
+                }
+            }
+        }
+    });
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    inserting = false;
+    reader.join();
+    
+    BOOST_CHECK_EQUAL(0, mismatches.load());
+}
+
+BOOST_AUTO_TEST_CASE(TreeStoreAllTest) {
+    Tree tree;
+    Cursor cursor;
+    
+    std::vector<Write> writes;
+    ops::storeAll(tree, writes);
+    BOOST_CHECK_EQUAL(0, tree.stats().entries);
+    
+    // Writes are given out of order, and split the leaves many times over
+    const size_t count = 20000;
+    std::vector<string> keys;
+    std::vector<string> values;
+    
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(makeKey(i * 7919 % count));
+        values.push_back(makeValue(i * 7919 % count));
+    }
+    
+    for (size_t i = 0; i < count; ++i) {
+        writes.emplace_back(keys[i], values[i]);
+    }
+    
+    ops::storeAll(tree, writes);
+    
+    auto stats = tree.stats();
+    BOOST_CHECK_EQUAL(count, stats.entries);
+    BOOST_CHECK_GT(stats.leafNodes, 50);
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(cursor));
+    }
+    
+    // A reader stays positioned at an entry which the batch deletes and
+    // stores again, while other entries are replaced by longer values,
+    // deleted, or stored and deleted again. The last write of a key wins,
+    // and deleting missing keys does nothing.
+    const string readerKey = makeKey(42);
+    const string longValue(300, 'v');
+    const string removed = makeKey(count + 1);
+    const string missing = makeKey(count + 2);
+    
+    Cursor reader;
+    ops::find(tree, reader, readerKey);
+    
+    writes.clear();
+    writes.emplace_back(readerKey, Bytes{});
+    
+    for (size_t i = 0; i < count; i += 3) {
+        writes.emplace_back(keys[i], longValue);
+    }
+    
+    for (size_t i = 0; i < count; i += 5) {
+        writes.emplace_back(keys[i], Bytes{});
+    }
+    
+    writes.emplace_back(removed, longValue);
+    writes.emplace_back(removed, Bytes{});
+    writes.emplace_back(missing, Bytes{});
+    writes.emplace_back(readerKey, longValue);
+    
+    ops::storeAll(tree, writes);
+    
+    ops::store(tree, reader, string("kept"));
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, keys[i]);
+        
+        if (i % 5 == 0) {
+            BOOST_CHECK(!ops::hasValue(cursor));
+        } else if (keys[i] == readerKey) {
+            BOOST_CHECK_EQUAL("kept", valueOf(cursor));
+        } else if (i % 3 == 0) {
+            BOOST_CHECK_EQUAL(longValue, valueOf(cursor));
+        } else {
+            BOOST_CHECK_EQUAL(values[i], valueOf(cursor));
+        }
+    }
+    
+    ops::find(tree, cursor, removed);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    ops::find(tree, cursor, missing);
+    BOOST_CHECK(!ops::hasValue(cursor));
+    
+    ops::reset(reader);
+    
+    // Deleting almost everything merges the leaves
+    const auto stored = tree.stats();
+    
+    writes.clear();
+    
+    for (size_t i = 0; i < count; ++i) {
+        if (i * 7919 % count % 100 != 1) {
+            writes.emplace_back(keys[i], Bytes{});
+        }
+    }
+    
+    ops::storeAll(tree, writes);
+    
+    stats = tree.stats();
+    BOOST_CHECK_EQUAL(count / 100, stats.entries);
+    BOOST_CHECK_LT(stats.leafNodes, stored.leafNodes / 10);
+    
+    // Batches of writers apply while other writers split the same leaves
+    std::vector<std::thread> writers;
+    
+    for (size_t t = 0; t < 4; ++t) {
+        writers.emplace_back([&, t] {
+            std::vector<string> batchKeys;
+            std::vector<string> batchValues;
+            std::vector<Write> batch;
+            
+            for (size_t i = count + t; i < count * 3; i += 4) {
+                batchKeys.push_back(makeKey(i));
+                batchValues.push_back(makeValue(i));
+                
+                if (batchKeys.size() == 1000) {
+                    for (size_t j = 0; j < batchKeys.size(); ++j) {
+                        batch.emplace_back(batchKeys[j], batchValues[j]);
+                    }
+                    
+                    ops::storeAll(tree, batch);
+                    
+                    batch.clear();
+                    batchKeys.clear();
+                    batchValues.clear();
+                }
+            }
+        });
+    }
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    BOOST_CHECK_EQUAL(count / 100 + count * 2, tree.stats().entries);
+    
+    for (size_t i = count; i < count * 3; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        BOOST_CHECK_EQUAL(makeValue(i), valueOf(cursor));
+    }
+    
+    ops::reset(cursor);
+}
+
+BOOST_AUTO_TEST_CASE(TreeConditionalStoreTest) {
+    Tree tree;
+    Cursor cursor;
+    tupl::pvt::Buffer oldValue;
+    
+    const string key = makeKey(0);
+    const string value = makeValue(0);
+    
+    BOOST_CHECK(!ops::replace(tree, key, value));
+    BOOST_CHECK(!ops::update(tree, key, value, value));
+    BOOST_CHECK(ops::update(tree, key, Bytes{}, value));
+    BOOST_CHECK(!ops::insert(tree, key, string("other")));
+    
+    ops::find(tree, cursor, key);
+    BOOST_CHECK_EQUAL(value, valueOf(cursor));
+    
+    // Inserts split the leaves, and leave existing entries alone
+    const size_t count = 10000;
+    
+    for (size_t i = 1; i < count; ++i) {
+        BOOST_CHECK(ops::insert(tree, makeKey(i), makeValue(i)));
+    }
+    
+    for (size_t i = 0; i < count; i += 7) {
+        BOOST_CHECK(!ops::insert(tree, makeKey(i), string("other")));
+    }
+    
+    BOOST_CHECK_EQUAL(count, tree.stats().entries);
+    
+    // Values are replaced by fragmented ones, which updates compare
+    const string longValue(5000, 'v');
+    
+    for (size_t i = 0; i < count; i += 2) {
+        BOOST_CHECK(ops::replace(tree, makeKey(i), longValue));
+    }
+    
+    BOOST_CHECK(!ops::replace(tree, makeKey(count), longValue));
+    
+    for (size_t i = 0; i < count; i += 3) {
+        const string expected = i % 2 == 0 ? longValue : makeValue(i);
+        
+        BOOST_CHECK(!ops::update(tree, makeKey(i), Bytes{}, value));
+        BOOST_CHECK(!ops::update(tree, makeKey(i), string(5000, 'w'), value));
+        BOOST_CHECK(!ops::update(tree, makeKey(i), makeValue(i + 1), value));
+        BOOST_CHECK(ops::update(tree, makeKey(i), expected, makeValue(i + 1)));
+    }
+    
+    // Exchanges hand back the values they replace, and null values delete
+    BOOST_CHECK(ops::exchange(tree, makeKey(2), string("exchanged"), oldValue));
+    BOOST_CHECK_EQUAL(longValue, string(oldValue.begin(), oldValue.end()));
+    
+    BOOST_CHECK(!ops::exchange(tree, makeKey(count), value, oldValue));
+    BOOST_CHECK(oldValue.empty());
+    
+    BOOST_CHECK(ops::exchange(tree, makeKey(count), Bytes{}, oldValue));
+    BOOST_CHECK_EQUAL(value, string(oldValue.begin(), oldValue.end()));
+    
+    for (size_t i = 1; i < count; i += 2) {
+        BOOST_CHECK(ops::replace(tree, makeKey(i), Bytes{}));
+    }
+    
+    BOOST_CHECK(!ops::replace(tree, makeKey(1), Bytes{}));
+    BOOST_CHECK(ops::insert(tree, makeKey(1), value));
+    
+    BOOST_CHECK_EQUAL(count / 2 + 1, tree.stats().entries);
+    
+    for (size_t i = 0; i < count; ++i) {
+        ops::find(tree, cursor, makeKey(i));
+        
+        if (i == 1) {
+            BOOST_CHECK_EQUAL(value, valueOf(cursor));
+        } else if (i % 2 != 0) {
+            BOOST_CHECK(!ops::hasValue(cursor));
+        } else if (i == 2) {
+            BOOST_CHECK_EQUAL("exchanged", valueOf(cursor));
+        } else if (i % 3 == 0) {
+            BOOST_CHECK_EQUAL(makeValue(i + 1),
+                              valueOf(cursor));
+        } else {
+            BOOST_CHECK_EQUAL(longValue, valueOf(cursor));
+        }
+    }
+    
+    ops::reset(cursor);
+    
+    // Updates of the same counter by several threads are never lost
+    const string counterKey = makeKey(count * 2);
+    ops::insert(tree, counterKey, std::to_string(0));
+    
+    std::vector<std::thread> writers;
+    
+    for (size_t t = 0; t < 4; ++t) {
+        writers.emplace_back([&] {
+            Cursor reader;
+            
+            for (size_t i = 0; i < 2000; ++i) {
+                string expected;
+                string next;
+                
+                do {
+                    ops::find(tree, reader, counterKey);
+                    expected = valueOf(reader);
+                    next = std::to_string(std::stoul(expected) + 1);
+                } while (!ops::update(tree, counterKey, expected, next));
+            }
+            
+            ops::reset(reader);
+        });
+    }
+    
+    for (auto& writer : writers) { writer.join(); }
+    
+    ops::exchange(tree, counterKey, Bytes{}, oldValue);
+    BOOST_CHECK_EQUAL("8000", string(oldValue.begin(), oldValue.end()));
+}